@@ -0,0 +1,73 @@
+// entity churn and iteration rate of the sparse set registry, plus heap allocations once warmed up
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "ecs/Components.h"
+#include "ecs/Registry.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static unsigned long allocations = 0;
+
+void* operator new(std::size_t size) {
+    allocations++;
+    if (void* p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+static double Seconds(Clock::time_point begin) { return std::chrono::duration<double>(Clock::now() - begin).count(); }
+
+static void Churn(Registry& registry, std::vector<Entity>& entities, unsigned int count) {
+    entities.clear();
+    for (unsigned int i = 0; i < count; i++) {
+        Entity e = registry.Create();
+        registry.Add<TransformComponent>(e, TransformHandle{i, 0});
+        registry.Add<MeshRenderer>(e, 1u, 36, true, nullptr, i);
+        if (i % 4 == 0) registry.Add<MaterialComponent>(e, nullptr);
+        entities.push_back(e);
+    }
+    for (Entity e : entities) {
+        registry.Destroy(e);
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned int count = argc > 1 ? (unsigned int)std::atoi(argv[1]) : 100000;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    Registry registry;
+    std::vector<Entity> entities;
+    entities.reserve(count);
+    // first round grows every pool to its high water mark
+    Churn(registry, entities, count);
+
+    unsigned long allocationsBefore = allocations;
+    Clock::time_point begin = Clock::now();
+    for (int r = 0; r < rounds; r++) {
+        Churn(registry, entities, count);
+    }
+    double churnTime = Seconds(begin);
+    unsigned long churnAllocations = allocations - allocationsBefore;
+
+    for (unsigned int i = 0; i < count; i++) {
+        Entity e = registry.Create();
+        registry.Add<TransformComponent>(e, TransformHandle{i, 0});
+        registry.Add<MeshRenderer>(e, 1u, 36, true, nullptr, i);
+    }
+    unsigned long sum = 0;
+    begin = Clock::now();
+    for (int r = 0; r < rounds; r++) {
+        registry.Each<MeshRenderer, TransformComponent>([&sum](Entity, MeshRenderer& mesh, TransformComponent& transform) { sum += mesh.renderObject + transform.handle.index; });
+    }
+    double iterateTime = Seconds(begin);
+
+    std::printf("entities: %u, rounds: %d\n", count, rounds);
+    std::printf("create + destroy  %8.2f M entities/s, %lu allocations after warm up\n", (double)count * rounds / churnTime * 1e-6, churnAllocations);
+    std::printf("iterate (2 pools) %8.2f M entities/s (checksum %lu)\n", (double)count * rounds / iterateTime * 1e-6, sum);
+    return 0;
+}
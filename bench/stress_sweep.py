@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+# sweeps the generated stress scene one parameter at a time and prints frame time and draws against scale.
+# every step is its own `deferred --stress ... --bench ... --stats` run, read back from the json stats.
+#
+#   python3 ../bench/stress_sweep.py ./deferred [--frames 300] [--axis objects] [--window] [--csv out.csv]
+#
+# run it from the build directory, the executable finds shaders and resources in ../
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+BASE = {"objects": 1000, "meshes": 8, "lights": 4, "shadowed": 1.0, "materials": 8}
+SWEEPS = [
+    ("objects", [250, 1000, 4000, 16000, 64000]),
+    ("meshes", [1, 8, 64, 256, 1024]),
+    ("materials", [1, 8, 64, 256, 1024]),
+    ("lights", [1, 2, 4, 8]),
+    ("shadowed", [0.0, 0.25, 0.5, 1.0]),
+]
+COLUMNS = ["axis", "value", "frame p50", "frame p95", "gpu p50", "shadow gpu", "main gpu", "draws", "state", "binds"]
+
+
+def spec(params):
+    return ",".join("%s=%s" % (k, params[k]) for k in ("objects", "meshes", "lights", "shadowed", "materials"))
+
+
+def run(exe, params, args):
+    with tempfile.TemporaryDirectory() as tmp:
+        stats = os.path.join(tmp, "stats.json")
+        cmd = [exe, "--stress", spec(params), "--bench", args.path, "--frames", str(args.frames), "--stats", stats]
+        if not args.window:
+            cmd.append("--headless")
+        result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+        if result.returncode != 0 or not os.path.exists(stats):
+            sys.stdout.write(result.stdout)
+            raise RuntimeError("%s failed with %d" % (" ".join(cmd), result.returncode))
+        with open(stats) as f:
+            return json.load(f)
+
+
+def row(axis, value, stats):
+    passes = stats["passes"]
+    shadow = sum(p["gpu_ms"]["p50"] for p in passes if p["name"] in ("cascades", "point light"))
+    main = sum(p["gpu_ms"]["p50"] for p in passes if p["name"] == "main")
+    return [axis, str(value), "%.3f" % stats["frame_ms"]["p50"], "%.3f" % stats["frame_ms"]["p95"], "%.3f" % stats["frame_gpu_ms"]["p50"],
+            "%.3f" % shadow, "%.3f" % main, "%.0f" % sum(p["draws"] for p in passes), "%.0f" % sum(p["state_changes"] for p in passes),
+            "%.0f" % sum(p["texture_binds"] for p in passes)]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="stress scene scalability sweep")
+    parser.add_argument("exe", help="the deferred executable")
+    parser.add_argument("--frames", type=int, default=300)
+    parser.add_argument("--path", default="../res/paths/stress.txt", help="camera path, relative to the working directory")
+    parser.add_argument("--axis", action="append", help="only sweep these parameters")
+    parser.add_argument("--window", action="store_true", help="render to a window instead of --headless")
+    parser.add_argument("--csv", help="also write the table here")
+    args = parser.parse_args()
+
+    exe = os.path.abspath(args.exe)
+    rows = []
+    print(" ".join("%-10s" % c for c in COLUMNS))
+    for axis, values in SWEEPS:
+        if args.axis and axis not in args.axis:
+            continue
+        for value in values:
+            params = dict(BASE)
+            params[axis] = value
+            if axis == "shadowed":
+                params["lights"] = 8
+            rows.append(row(axis, value, run(exe, params, args)))
+            print(" ".join("%-10s" % c for c in rows[-1]), flush=True)
+
+    if args.csv:
+        with open(args.csv, "w") as f:
+            f.write(",".join(COLUMNS) + "\n")
+            for r in rows:
+                f.write(",".join(r) + "\n")
+
+
+if __name__ == "__main__":
+    main()
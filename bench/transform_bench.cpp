@@ -0,0 +1,85 @@
+// matrices per second: individually allocated Transform objects vs the SoA TransformStore
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "JobSystem.h"
+#include "TransformStore.h"
+#include "components/Transform.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double Seconds(Clock::time_point begin) { return std::chrono::duration<double>(Clock::now() - begin).count(); }
+
+static glm::vec3 Position(unsigned int i, int frame) { return glm::vec3((float)(i % 100), (float)frame * 0.01f, (float)(i / 100)); }
+
+int main(int argc, char** argv) {
+    unsigned int count = argc > 1 ? (unsigned int)std::atoi(argv[1]) : 100000;
+    int frames = argc > 2 ? std::atoi(argv[2]) : 50;
+    JobSystem inlineJobs(1);
+    JobSystem jobs;
+
+    std::vector<Transform*> transforms;
+    TransformStore store;
+    std::vector<TransformHandle> handles;
+    for (unsigned int i = 0; i < count; i++) {
+        glm::quat rotation = glm::angleAxis((float)i * 0.001f, glm::normalize(glm::vec3(1.f, 1.f, (float)(i % 7))));
+        glm::vec3 scale(1.f + (float)(i % 3));
+        Transform* t = new Transform(Position(i, 0));
+        t->SetRotation(rotation);
+        t->SetScale(scale);
+        transforms.push_back(t);
+        handles.push_back(store.Create(Position(i, 0), rotation, scale));
+    }
+
+    // every transform moves every frame, worst case for both
+    float checksum = 0.f;
+    Clock::time_point begin = Clock::now();
+    for (int f = 0; f < frames; f++) {
+        for (unsigned int i = 0; i < count; i++) {
+            transforms[i]->SetPosition(Position(i, f));
+            checksum += transforms[i]->GetLocalToWorldMatrix()[3][1];
+        }
+    }
+    double objectTime = Seconds(begin);
+
+    double storeTime[2];
+    JobSystem* jobSystems[2] = {&inlineJobs, &jobs};
+    for (int run = 0; run < 2; run++) {
+        begin = Clock::now();
+        for (int f = 0; f < frames; f++) {
+            for (unsigned int i = 0; i < count; i++) {
+                store.SetPosition(handles[i], Position(i, f));
+            }
+            store.Update(jobSystems[run]);
+            checksum += store.GetWorldMatrix(handles[f % count])[3][1];
+        }
+        storeTime[run] = Seconds(begin);
+    }
+
+    float maxError = 0.f;
+    for (unsigned int i = 0; i < count; i++) {
+        glm::mat4 a = transforms[i]->GetLocalToWorldMatrix();
+        const glm::mat4& b = store.GetWorldMatrix(handles[i]);
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 4; r++) {
+                maxError = std::max(maxError, std::abs(a[c][r] - b[c][r]));
+            }
+        }
+    }
+
+    double matrices = (double)count * frames;
+    std::printf("transforms: %u, frames: %d, simd width: %u\n", count, frames, TransformStore::BatchSize);
+    std::printf("Transform       %8.2f M matrices/s\n", matrices / objectTime * 1e-6);
+    std::printf("TransformStore  %8.2f M matrices/s (1 thread, %.2fx)\n", matrices / storeTime[0] * 1e-6, objectTime / storeTime[0]);
+    std::printf("TransformStore  %8.2f M matrices/s (%u workers, %.2fx)\n", matrices / storeTime[1] * 1e-6, jobs.GetWorkerCount(), objectTime / storeTime[1]);
+    std::printf("max difference: %g (checksum %g)\n", maxError, checksum);
+
+    for (Transform* t : transforms) {
+        delete t;
+    }
+    return 0;
+}
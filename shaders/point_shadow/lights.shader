@@ -0,0 +1,46 @@
+// shared by shadow_vs and shadow_fs. the features below are #defined per variant by the engine
+// (RenderingEngine.cpp, litShaderDefines), the fallbacks only keep the file compiling on its own
+
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 1 // at most RenderingEngine::MaxPointLights
+#endif
+#ifndef POINT_LIGHT_SHADOWS
+#define POINT_LIGHT_SHADOWS SHADOW_HARD // one per light
+#endif
+#ifndef USE_NORMAL_MAP
+#define USE_NORMAL_MAP 0
+#endif
+
+#define SHADOW_NONE 0
+#define SHADOW_HARD 1
+#define SHADOW_PCF 2 // 25 taps, castTranslucentShadow
+#define SHADOW_MOMENT 3
+
+const int pointLightShadows[NR_POINT_LIGHTS] = int[NR_POINT_LIGHTS](POINT_LIGHT_SHADOWS);
+
+struct PointLight {
+    vec3 position;
+    vec3 color;
+    float attenuation;
+    float shadowBias;
+    float shadowFilterSharpen;
+    float shadowStrength;
+    float intensity;
+    float momentMinVariance;
+    float lightBleedReduction;
+};
+
+struct DirectionalLight {
+    vec3 direction;
+    vec3 color;
+    float intensity;
+    float shadowBias;
+    bool castShadow;
+};
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    sampler2D normal;
+    float shininess;
+};
@@ -0,0 +1,34 @@
+#version 330 core
+
+in vec2 TexCoords;
+out vec2 FragColor;
+
+uniform samplerCube momentMap;
+uniform int face;
+uniform vec2 direction;
+uniform vec2 texelSize;
+
+// 13-tap gaussian folded into 7 bilinear fetches
+const float offsets[4] = float[] (0.0, 1.411764705882353, 3.2941176470588234, 5.176470588235294);
+const float weights[4] = float[] (0.1964825501511404, 0.2969069646728344, 0.09447039785044732, 0.010381362401148057);
+
+// face uv in [0, 1] to cubemap lookup direction, taps outside the face keep walking onto its neighbour
+vec3 FaceDirection(vec2 uv) {
+    vec2 st = uv * 2.0 - 1.0;
+    if (face == 0) return vec3( 1.0, -st.y, -st.x);
+    if (face == 1) return vec3(-1.0, -st.y,  st.x);
+    if (face == 2) return vec3( st.x,  1.0,  st.y);
+    if (face == 3) return vec3( st.x, -1.0, -st.y);
+    if (face == 4) return vec3( st.x, -st.y,  1.0);
+    return vec3(-st.x, -st.y, -1.0);
+}
+
+void main() {
+    vec2 step = direction * texelSize;
+    vec2 result = texture(momentMap, FaceDirection(TexCoords)).rg * weights[0];
+    for (int i = 1; i < 4; ++i) {
+        result += texture(momentMap, FaceDirection(TexCoords + step * offsets[i])).rg * weights[i];
+        result += texture(momentMap, FaceDirection(TexCoords - step * offsets[i])).rg * weights[i];
+    }
+    FragColor = result;
+}
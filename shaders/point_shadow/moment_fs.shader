@@ -0,0 +1,19 @@
+#version 330 core
+
+in vec4 FragPos;
+
+uniform vec3 lightPos;
+uniform float far_plane;
+
+layout (location = 0) out vec2 Moments;
+
+void main() {
+    float lightDistance = length(FragPos.xyz - lightPos);
+    lightDistance = lightDistance / far_plane;
+    gl_FragDepth = lightDistance;
+
+    // bias the second moment by the depth slope inside the texel
+    float dx = dFdx(lightDistance);
+    float dy = dFdy(lightDistance);
+    Moments = vec2(lightDistance, lightDistance * lightDistance + 0.25 * (dx * dx + dy * dy));
+}
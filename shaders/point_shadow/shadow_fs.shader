@@ -1,27 +1,11 @@
 #version 330 core
 out vec4 FragColor;
 
-#define NR_POINT_LIGHTS 3
-
-struct PointLight {
-    vec3 position;
-    vec3 color;
-    float attenuation;
-    float shadowBias;
-    float shadowFilterSharpen;
-    float shadowStrength;
-    float intensity;
-    bool castShadow;
-    bool castTranslucentShadow;
-};
+#define NR_CASCADES 4
+#define SUN_AMBIENT 0.1 // share of the sun that reaches shadowed and averted faces
+#define SUN_SPECULAR 0.5 // no specular maps are bound, highlights take the light color
 
-struct Material {
-    sampler2D diffuse;
-    sampler2D specular;
-    sampler2D normal;
-    bool useNormal;
-    float shininess;
-};
+#include "lights.shader"
 
 vec3 offsets[25] = vec3[] (
     vec3( 0,  0,  0), vec3( 0,  1,  1), vec3( 0, -1,  1),
@@ -44,6 +28,7 @@ in VS_OUT {
     vec3 WorldViewPos;
 
     vec3 TangentLightPos[NR_POINT_LIGHTS];
+    vec3 TangentDirLightDir;
     vec3 TangentViewPos;
     vec3 TangentFragPos;
 } fs_in;
@@ -51,27 +36,70 @@ in VS_OUT {
 uniform samplerCube depthMap[NR_POINT_LIGHTS];
 
 uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform Material material;
 uniform float far_plane;
 
+uniform DirectionalLight dirLight;
+uniform sampler2DArrayShadow cascadeMap;
+uniform mat4 cascadeMatrices[NR_CASCADES];
+uniform float cascadeSplits[NR_CASCADES];
+uniform mat4 view;
+
+#if MATERIAL_ARRAY && USE_NORMAL_MAP
+#error layered materials have no normal map, MATERIAL_ARRAY and USE_NORMAL_MAP exclude each other
+#endif
+
+#if MATERIAL_ARRAY
+// materials sharing a texture array, a draw only changes the id
+layout(std140) uniform Materials {
+    vec4 materialParams[MAX_MATERIALS]; // shininess, diffuse layer
+};
+uniform sampler2DArray materialDiffuse;
+uniform int materialId;
+
+float MaterialShininess() { return materialParams[materialId].x; }
+vec3 MaterialDiffuse() { return texture(materialDiffuse, vec3(fs_in.TexCoords, materialParams[materialId].y)).rgb; }
+// no specular maps, the other path never binds one either and reads the diffuse texture on unit 0
+vec3 MaterialSpecular() { return MaterialDiffuse(); }
+#else
+uniform Material material;
+
+float MaterialShininess() { return material.shininess; }
+vec3 MaterialDiffuse() { return texture(material.diffuse, fs_in.TexCoords).rgb; }
+vec3 MaterialSpecular() { return texture(material.specular, fs_in.TexCoords).rgb; }
+#endif
+
 vec3 CalcPointLight(PointLight light, vec3 lightPos, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow) {
     vec3 lightDir = normalize(lightPos - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), MaterialShininess());
     // attenuation
     float distance = length(lightPos - fragPos);
     float attenuation = 1.0 / (1.0 + clamp(light.attenuation, 0.0, 1.0) * pow(distance, 2));
 
     // combine results
-    vec3 ambient = light.color * vec3(texture(material.diffuse, fs_in.TexCoords)) * light.intensity * attenuation;
+    vec3 ambient = light.color * MaterialDiffuse() * light.intensity * attenuation;
     vec3 diffuse = ambient * diff; // intentional for the sake of performance
-    vec3 specular = light.color * spec * vec3(texture(material.specular, fs_in.TexCoords)) * attenuation;
+    vec3 specular = light.color * spec * MaterialSpecular() * attenuation;
     return (ambient + (1.0 - shadow) * diffuse + specular);
 }
 
+// chebyshev upper bound on the fraction of light reaching the fragment
+float MomentShadow(vec2 moments, float depth, int idx) {
+    if (depth <= moments.x) {
+        return 0.0;
+    }
+    float variance = max(moments.y - moments.x * moments.x, pointLights[idx].momentMinVariance);
+    float d = depth - moments.x;
+    float pMax = variance / (variance + d * d);
+    // cut off the tail to reduce light bleeding where occluders overlap
+    float bleed = clamp(pointLights[idx].lightBleedReduction, 0.0, 0.99);
+    pMax = clamp((pMax - bleed) / (1.0 - bleed), 0.0, 1.0);
+    return 1.0 - pMax;
+}
+
 // everything in world space
 float CalculateShadow(vec3 fragPos, vec3 viewPos, int idx) {
     vec3 fragToLight = fragPos - pointLights[idx].position;
@@ -79,7 +107,12 @@ float CalculateShadow(vec3 fragPos, vec3 viewPos, int idx) {
     float shadow = 0.0;
     float shadowStrength = clamp(pointLights[idx].shadowStrength, 0.0, 1.0);
 
-    if (pointLights[idx].castTranslucentShadow) {
+    // constant per light and variant, only one of these survives compilation
+    if (pointLightShadows[idx] == SHADOW_MOMENT) {
+        // the map is already blurred, a single filtered fetch gives the soft edge
+        vec2 moments = texture(depthMap[idx], fragToLight).rg;
+        shadow = MomentShadow(moments, (currentDepth - pointLights[idx].shadowBias) / far_plane, idx) * shadowStrength;
+    } else if (pointLightShadows[idx] == SHADOW_PCF) {
         int samples = 25;
         float radius = pointLights[idx].shadowFilterSharpen * clamp(length(viewPos - fragPos), 0.2, 6);
         for (int i = 0; i < samples; ++i) {
@@ -99,28 +132,85 @@ float CalculateShadow(vec3 fragPos, vec3 viewPos, int idx) {
     return shadow;
 }
 
-void main() {
-    vec3 normal = vec3(0.0);
-    if (material.useNormal) {
-        normal = texture(material.normal, fs_in.TexCoords).rgb;
-        normal = normalize(normal * 2.0 - 1.0); // transform normal vector to range [-1, 1]
-    } else {
-        normal = normalize(fs_in.Normal);
+vec3 CalcDirLight(vec3 lightDir, vec3 normal, vec3 viewDir, float shadow) {
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), MaterialShininess());
+
+    vec3 light = dirLight.color * dirLight.intensity;
+    vec3 albedo = MaterialDiffuse();
+    vec3 ambient = light * albedo * SUN_AMBIENT;
+    vec3 diffuse = light * albedo * diff;
+    vec3 specular = dirLight.color * spec * SUN_SPECULAR;
+    return (ambient + (1.0 - shadow) * (diffuse + specular));
+}
+
+float CalculateCascadeShadow(vec3 fragPos, vec3 worldNormal) {
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    int layer = -1;
+    for (int i = 0; i < NR_CASCADES; ++i) {
+        if (viewDepth < cascadeSplits[i]) {
+            layer = i;
+            break;
+        }
+    }
+    if (layer == -1) {
+        return 0.0;
     }
-    vec3 viewDir = normalize(
-        material.useNormal ? (fs_in.TangentViewPos - fs_in.TangentFragPos) : (fs_in.WorldViewPos - fs_in.FragPos)
-    );
+
+    vec4 fragPosLightSpace = cascadeMatrices[layer] * vec4(fragPos, 1.0);
+    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
+    projCoords = projCoords * 0.5 + 0.5;
+    if (projCoords.z > 1.0) {
+        return 0.0;
+    }
+
+    // slope scaled
+    float bias = max(dirLight.shadowBias * (1.0 - dot(worldNormal, -dirLight.direction)), dirLight.shadowBias * 0.1);
+    vec2 texelSize = 1.0 / vec2(textureSize(cascadeMap, 0).xy);
+    float shadow = 0.0;
+    for (int x = -1; x <= 1; ++x) {
+        for (int y = -1; y <= 1; ++y) {
+            shadow += 1.0 - texture(cascadeMap, vec4(projCoords.xy + vec2(x, y) * texelSize, layer, projCoords.z - bias));
+        }
+    }
+    return shadow / 9.0;
+}
+
+void main() {
+#if USE_NORMAL_MAP
+    // z is rebuilt from xy, cooked normal maps are BC5 and only keep two channels
+    vec2 xy = texture(material.normal, fs_in.TexCoords).rg * 2.0 - 1.0; // transform normal vector to range [-1, 1]
+    vec3 normal = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+    vec3 viewDir = normalize(fs_in.TangentViewPos - fs_in.TangentFragPos);
+    vec3 fragPos = fs_in.TangentFragPos;
+#else
+    vec3 normal = normalize(fs_in.Normal);
+    vec3 viewDir = normalize(fs_in.WorldViewPos - fs_in.FragPos);
+    vec3 fragPos = fs_in.FragPos;
+#endif
 
     vec3 result = vec3(0.0);
     float shadow = 0.0;
     for(int i = 0; i < NR_POINT_LIGHTS; i++) {
-        if (pointLights[i].castShadow) {
+        if (pointLightShadows[i] != SHADOW_NONE) {
             shadow += CalculateShadow(fs_in.FragPos, fs_in.WorldViewPos, i);
         }
-        result += CalcPointLight(pointLights[i],
-                        material.useNormal ? fs_in.TangentLightPos[i] : pointLights[i].position,
-                        normal, material.useNormal ? fs_in.TangentFragPos : fs_in.FragPos, viewDir, shadow);
+#if USE_NORMAL_MAP
+        vec3 lightPos = fs_in.TangentLightPos[i];
+#else
+        vec3 lightPos = pointLights[i].position;
+#endif
+        result += CalcPointLight(pointLights[i], lightPos, normal, fragPos, viewDir, shadow);
     }
 
+    float dirShadow = dirLight.castShadow ? CalculateCascadeShadow(fs_in.FragPos, normalize(fs_in.Normal)) : 0.0;
+#if USE_NORMAL_MAP
+    vec3 dirLightDir = normalize(-fs_in.TangentDirLightDir);
+#else
+    vec3 dirLightDir = normalize(-dirLight.direction);
+#endif
+    result += CalcDirLight(dirLightDir, normal, viewDir, dirShadow);
+
     FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+}
@@ -5,27 +5,7 @@ layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 aTangent;
 
-#define NR_POINT_LIGHTS 3
-
-struct PointLight {
-    vec3 position;
-    vec3 color;
-    float attenuation;
-    float shadowBias;
-    float shadowFilterSharpen;
-    float shadowStrength;
-    float intensity;
-    bool castShadow;
-    bool castTranslucentShadow;
-};
-
-struct Material {
-    sampler2D diffuse;
-    sampler2D specular;
-    sampler2D normal;
-    bool useNormal;
-    float shininess;
-};
+#include "lights.shader"
 
 out vec2 TexCoords;
 
@@ -36,6 +16,7 @@ out VS_OUT {
     vec3 WorldViewPos;
 
     vec3 TangentLightPos[NR_POINT_LIGHTS];
+    vec3 TangentDirLightDir;
     vec3 TangentViewPos;
     vec3 TangentFragPos;
 } vs_out;
@@ -46,6 +27,7 @@ uniform mat4 model;
 
 uniform vec3 viewPos;
 uniform PointLight pointLights[NR_POINT_LIGHTS];
+uniform DirectionalLight dirLight;
 uniform Material material;
 
 void main() {
@@ -56,7 +38,8 @@ void main() {
     vs_out.TexCoords = aTexCoords;
     vs_out.WorldViewPos = vec3(model * vec4(viewPos, 1.0));
 
-    if (material.useNormal) {
+#if USE_NORMAL_MAP
+    {
         vec3 T = normalize(normalMatrix * aTangent);
         vec3 N = normalize(normalMatrix * aNormal);
         T = normalize(T - dot(T, N) * N);
@@ -66,9 +49,11 @@ void main() {
         for(int i = 0; i < NR_POINT_LIGHTS; i++) {
             vs_out.TangentLightPos[i] = TBN * pointLights[i].position;
         }
+        vs_out.TangentDirLightDir = TBN * dirLight.direction;
         vs_out.TangentViewPos = TBN * viewPos;
         vs_out.TangentFragPos = TBN * vs_out.FragPos;
     }
+#endif
 
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
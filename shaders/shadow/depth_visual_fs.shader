@@ -3,9 +3,10 @@
 in vec2 TexCoords;
 out vec4 out_colour;
 
-uniform sampler2D depthMap;
+uniform sampler2DArray depthMap;
+uniform int layer;
 
 void main() {
-    float depthValue =  texture(depthMap, TexCoords).r;
+    float depthValue = texture(depthMap, vec3(TexCoords, layer)).r;
     out_colour = vec4(vec3(depthValue), 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,368 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <limits>
+
+static const unsigned int MAX_LEAF_SIZE = 4;
+static const unsigned int FORCE_SPLIT_SIZE = 16;
+static const int BIN_COUNT = 12;
+static const float TRAVERSAL_COST = 1.f;  // relative to one primitive test
+static const float REBUILD_THRESHOLD = 1.5f;
+
+Bvh::Bvh()
+    : nodes(), primIndices(), primMin(), primMax(), primUserData(), primAlive(), freeProxies(), proxyCount(0), needsRebuild(false), needsRefit(false), builtCost(0.f), lastVisitedNodes(0) {}
+
+unsigned int Bvh::Insert(unsigned int userData, const glm::vec3& min, const glm::vec3& max) {
+    unsigned int proxy;
+    if (!freeProxies.empty()) {
+        proxy = freeProxies.back();
+        freeProxies.pop_back();
+        primMin[proxy] = min;
+        primMax[proxy] = max;
+        primUserData[proxy] = userData;
+        primAlive[proxy] = true;
+    } else {
+        proxy = (unsigned int)primMin.size();
+        primMin.push_back(min);
+        primMax.push_back(max);
+        primUserData.push_back(userData);
+        primAlive.push_back(true);
+    }
+    proxyCount++;
+    needsRebuild = true;
+    return proxy;
+}
+
+void Bvh::Remove(unsigned int proxy) {
+    if (proxy >= primAlive.size() || !primAlive[proxy]) return;
+    primAlive[proxy] = false;
+    freeProxies.push_back(proxy);
+    proxyCount--;
+    needsRebuild = true;
+}
+
+void Bvh::Update(unsigned int proxy, const glm::vec3& min, const glm::vec3& max) {
+    // ignored once removed, as in Remove
+    if (proxy >= primAlive.size() || !primAlive[proxy]) return;
+    primMin[proxy] = min;
+    primMax[proxy] = max;
+    needsRefit = true;
+}
+
+void Bvh::Commit() {
+    if (needsRebuild) {
+        Build();
+        return;
+    }
+    if (!needsRefit) return;
+    Refit();
+    // objects drifted far enough that the old topology is a poor fit
+    if (Cost() > builtCost * REBUILD_THRESHOLD) Build();
+}
+
+void Bvh::Clear() {
+    nodes.clear();
+    primIndices.clear();
+    primMin.clear();
+    primMax.clear();
+    primUserData.clear();
+    primAlive.clear();
+    freeProxies.clear();
+    proxyCount = 0;
+    needsRebuild = false;
+    needsRefit = false;
+    builtCost = 0.f;
+}
+
+void Bvh::Build() {
+    nodes.clear();
+    primIndices.clear();
+    for (unsigned int i = 0; i < primAlive.size(); i++) {
+        if (primAlive[i]) primIndices.push_back(i);
+    }
+    needsRebuild = false;
+    needsRefit = false;
+    builtCost = 0.f;
+    if (primIndices.empty()) return;
+
+    nodes.reserve(primIndices.size() * 2);
+    Node root;
+    root.left = 0;
+    root.first = 0;
+    root.count = (unsigned int)primIndices.size();
+    root.leaf = true;
+    nodes.push_back(root);
+    Subdivide(0);
+    builtCost = Cost();
+}
+
+void Bvh::Subdivide(unsigned int nodeIndex) {
+    // nodes may reallocate below, so never hold a reference across push_back
+    unsigned int first = nodes[nodeIndex].first;
+    unsigned int count = nodes[nodeIndex].count;
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+    glm::vec3 centroidMin = boundsMin, centroidMax = boundsMax;
+    for (unsigned int i = first; i < first + count; i++) {
+        unsigned int prim = primIndices[i];
+        boundsMin = glm::min(boundsMin, primMin[prim]);
+        boundsMax = glm::max(boundsMax, primMax[prim]);
+        glm::vec3 centroid = (primMin[prim] + primMax[prim]) * 0.5f;
+        centroidMin = glm::min(centroidMin, centroid);
+        centroidMax = glm::max(centroidMax, centroid);
+    }
+    nodes[nodeIndex].min = boundsMin;
+    nodes[nodeIndex].max = boundsMax;
+    nodes[nodeIndex].leaf = true;
+    if (count <= MAX_LEAF_SIZE) return;
+
+    // binned SAH over the centroid extent of every axis
+    int bestAxis = -1, bestSplit = 0;
+    float bestCost = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = centroidMax[axis] - centroidMin[axis];
+        if (extent <= 0.f) continue;
+
+        unsigned int binCount[BIN_COUNT] = {0};
+        glm::vec3 binMin[BIN_COUNT], binMax[BIN_COUNT];
+        for (int b = 0; b < BIN_COUNT; b++) {
+            binMin[b] = glm::vec3(std::numeric_limits<float>::max());
+            binMax[b] = glm::vec3(-std::numeric_limits<float>::max());
+        }
+        float scale = (float)BIN_COUNT / extent;
+        for (unsigned int i = first; i < first + count; i++) {
+            unsigned int prim = primIndices[i];
+            float centroid = (primMin[prim][axis] + primMax[prim][axis]) * 0.5f;
+            int b = std::min(BIN_COUNT - 1, (int)((centroid - centroidMin[axis]) * scale));
+            binCount[b]++;
+            binMin[b] = glm::min(binMin[b], primMin[prim]);
+            binMax[b] = glm::max(binMax[b], primMax[prim]);
+        }
+
+        // sweep from both sides so each split plane is evaluated in O(1)
+        float leftArea[BIN_COUNT - 1], rightArea[BIN_COUNT - 1];
+        unsigned int leftCount[BIN_COUNT - 1], rightCount[BIN_COUNT - 1];
+        glm::vec3 accMin(std::numeric_limits<float>::max()), accMax(-std::numeric_limits<float>::max());
+        unsigned int acc = 0;
+        for (int b = 0; b < BIN_COUNT - 1; b++) {
+            acc += binCount[b];
+            if (binCount[b]) {
+                accMin = glm::min(accMin, binMin[b]);
+                accMax = glm::max(accMax, binMax[b]);
+            }
+            leftCount[b] = acc;
+            leftArea[b] = acc ? SurfaceArea(accMin, accMax) : 0.f;
+        }
+        accMin = glm::vec3(std::numeric_limits<float>::max());
+        accMax = glm::vec3(-std::numeric_limits<float>::max());
+        acc = 0;
+        for (int b = BIN_COUNT - 1; b > 0; b--) {
+            acc += binCount[b];
+            if (binCount[b]) {
+                accMin = glm::min(accMin, binMin[b]);
+                accMax = glm::max(accMax, binMax[b]);
+            }
+            rightCount[b - 1] = acc;
+            rightArea[b - 1] = acc ? SurfaceArea(accMin, accMax) : 0.f;
+        }
+        for (int b = 0; b < BIN_COUNT - 1; b++) {
+            if (!leftCount[b] || !rightCount[b]) continue;
+            float cost = leftCount[b] * leftArea[b] + rightCount[b] * rightArea[b];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b + 1;
+            }
+        }
+    }
+
+    if (bestAxis == -1) return;  // every centroid coincides
+    float nodeArea = SurfaceArea(boundsMin, boundsMax);
+    if (bestCost + TRAVERSAL_COST * nodeArea >= count * nodeArea && count <= FORCE_SPLIT_SIZE) return;
+
+    float scale = (float)BIN_COUNT / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+    float axisMin = centroidMin[bestAxis];
+    auto mid = std::partition(primIndices.begin() + first, primIndices.begin() + first + count, [&](unsigned int prim) {
+        float centroid = (primMin[prim][bestAxis] + primMax[prim][bestAxis]) * 0.5f;
+        return std::min(BIN_COUNT - 1, (int)((centroid - axisMin) * scale)) < bestSplit;
+    });
+    unsigned int leftCount = (unsigned int)(mid - primIndices.begin()) - first;
+    if (leftCount == 0 || leftCount == count) return;
+
+    unsigned int left = (unsigned int)nodes.size();
+    Node child;
+    child.left = 0;
+    child.leaf = true;
+    child.first = first;
+    child.count = leftCount;
+    nodes.push_back(child);
+    child.first = first + leftCount;
+    child.count = count - leftCount;
+    nodes.push_back(child);
+    nodes[nodeIndex].left = left;
+    nodes[nodeIndex].leaf = false;
+    Subdivide(left);
+    Subdivide(left + 1);
+}
+
+void Bvh::Refit() {
+    // children always come after their parent, so a reverse sweep is bottom-up
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node& node = nodes[i];
+        if (node.leaf) {
+            node.min = glm::vec3(std::numeric_limits<float>::max());
+            node.max = glm::vec3(-std::numeric_limits<float>::max());
+            for (unsigned int p = node.first; p < node.first + node.count; p++) {
+                node.min = glm::min(node.min, primMin[primIndices[p]]);
+                node.max = glm::max(node.max, primMax[primIndices[p]]);
+            }
+        } else {
+            node.min = glm::min(nodes[node.left].min, nodes[node.left + 1].min);
+            node.max = glm::max(nodes[node.left].max, nodes[node.left + 1].max);
+        }
+    }
+    needsRefit = false;
+}
+
+float Bvh::Cost() const {
+    if (nodes.empty()) return 0.f;
+    float cost = 0.f;
+    for (const Node& node : nodes) {
+        float area = SurfaceArea(node.min, node.max);
+        cost += node.leaf ? area * node.count : area * TRAVERSAL_COST;
+    }
+    return cost / glm::max(SurfaceArea(nodes[0].min, nodes[0].max), std::numeric_limits<float>::min());
+}
+
+float Bvh::SurfaceArea(const glm::vec3& min, const glm::vec3& max) {
+    glm::vec3 e = max - min;
+    return 2.f * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+void Bvh::CollectSubtree(const Node& node, std::vector<unsigned int>& out) const {
+    for (unsigned int p = node.first; p < node.first + node.count; p++) {
+        out.push_back(primUserData[primIndices[p]]);
+    }
+}
+
+void Bvh::QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& out) const {
+    out.clear();
+    unsigned int visited = 0;
+    if (nodes.empty()) return;
+
+    std::vector<unsigned int> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        visited++;
+
+        int result = frustum.ClassifyAABB(node.min, node.max);
+        if (result == Frustum::OUTSIDE) continue;
+        if (result == Frustum::INSIDE) {
+            // nothing below can be outside
+            CollectSubtree(node, out);
+        } else if (node.leaf) {
+            for (unsigned int p = node.first; p < node.first + node.count; p++) {
+                unsigned int prim = primIndices[p];
+                if (frustum.TestAABB(primMin[prim], primMax[prim])) out.push_back(primUserData[prim]);
+            }
+        } else {
+            stack.push_back(node.left);
+            stack.push_back(node.left + 1);
+        }
+    }
+    lastVisitedNodes.store(visited, std::memory_order_relaxed);
+}
+
+void Bvh::QuerySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& out) const {
+    out.clear();
+    unsigned int visited = 0;
+    if (nodes.empty()) return;
+
+    float radiusSq = radius * radius;
+    auto overlaps = [&](const glm::vec3& min, const glm::vec3& max) {
+        glm::vec3 closest = glm::clamp(center, min, max);
+        glm::vec3 d = closest - center;
+        return glm::dot(d, d) <= radiusSq;
+    };
+
+    std::vector<unsigned int> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        visited++;
+
+        if (!overlaps(node.min, node.max)) continue;
+        if (node.leaf) {
+            for (unsigned int p = node.first; p < node.first + node.count; p++) {
+                unsigned int prim = primIndices[p];
+                if (overlaps(primMin[prim], primMax[prim])) out.push_back(primUserData[prim]);
+            }
+        } else {
+            stack.push_back(node.left);
+            stack.push_back(node.left + 1);
+        }
+    }
+    lastVisitedNodes.store(visited, std::memory_order_relaxed);
+}
+
+// slab test, returns the entry distance or a negative value on a miss
+static float intersectAABB(const Ray& ray, const glm::vec3& invDir, const glm::vec3& min, const glm::vec3& max, float maxDistance) {
+    float tmin = 0.f, tmax = maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        float t1 = (min[axis] - ray.origin[axis]) * invDir[axis];
+        float t2 = (max[axis] - ray.origin[axis]) * invDir[axis];
+        tmin = std::max(tmin, std::min(t1, t2));
+        tmax = std::min(tmax, std::max(t1, t2));
+    }
+    return tmin <= tmax ? tmin : -1.f;
+}
+
+bool Bvh::Raycast(const Ray& ray, float maxDistance, unsigned int& outUserData, float& outDistance) const {
+    unsigned int visited = 0;
+    if (nodes.empty()) return false;
+
+    glm::vec3 invDir(1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z);
+    float best = maxDistance;
+    bool hit = false;
+    std::vector<unsigned int> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        visited++;
+
+        if (intersectAABB(ray, invDir, node.min, node.max, best) < 0.f) continue;
+        if (node.leaf) {
+            for (unsigned int p = node.first; p < node.first + node.count; p++) {
+                unsigned int prim = primIndices[p];
+                float t = intersectAABB(ray, invDir, primMin[prim], primMax[prim], best);
+                if (t >= 0.f && t < best) {
+                    best = t;
+                    outUserData = primUserData[prim];
+                    hit = true;
+                }
+            }
+        } else {
+            // visit the nearer child first so the far one is usually pruned
+            float tl = intersectAABB(ray, invDir, nodes[node.left].min, nodes[node.left].max, best);
+            float tr = intersectAABB(ray, invDir, nodes[node.left + 1].min, nodes[node.left + 1].max, best);
+            if (tl >= 0.f && tr >= 0.f) {
+                stack.push_back(tl < tr ? node.left + 1 : node.left);
+                stack.push_back(tl < tr ? node.left : node.left + 1);
+            } else if (tl >= 0.f) {
+                stack.push_back(node.left);
+            } else if (tr >= 0.f) {
+                stack.push_back(node.left + 1);
+            }
+        }
+    }
+    lastVisitedNodes.store(visited, std::memory_order_relaxed);
+    if (hit) outDistance = best;
+    return hit;
+}
@@ -0,0 +1,67 @@
+#ifndef DEFERRED_BVH_H
+#define DEFERRED_BVH_H
+
+#include <atomic>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Culling.h"
+
+struct Ray {
+    Ray() : origin(), direction(0.f, 0.f, -1.f) {}
+    Ray(const glm::vec3& o, const glm::vec3& d) : origin(o), direction(d) {}
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+// bounding volume hierarchy over world space AABBs.
+// built top-down with binned SAH, moved proxies only refit the tree until its cost degrades enough to rebuild.
+// queries only read the tree, so they can run from several jobs at once between commits.
+class Bvh {
+  public:
+    Bvh();
+
+    unsigned int Insert(unsigned int userData, const glm::vec3& min, const glm::vec3& max);
+    void Remove(unsigned int proxy);
+    void Update(unsigned int proxy, const glm::vec3& min, const glm::vec3& max);
+    void Commit();  // rebuild or refit whatever changed since the last commit
+    void Clear();
+
+    void QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& out) const;
+    void QuerySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& out) const;
+    bool Raycast(const Ray& ray, float maxDistance, unsigned int& outUserData, float& outDistance) const;
+
+    unsigned int GetNodeCount() const { return (unsigned int)nodes.size(); }
+    unsigned int GetProxyCount() const { return proxyCount; }
+    unsigned int GetLastVisitedNodes() const { return lastVisitedNodes.load(std::memory_order_relaxed); }
+
+  private:
+    struct Node {
+        glm::vec3 min, max;
+        unsigned int left;   // right child is left + 1
+        unsigned int first;  // range in primIndices covered by the whole subtree
+        unsigned int count;
+        bool leaf;
+    };
+
+    void Build();
+    void Refit();
+    void Subdivide(unsigned int nodeIndex);
+    void CollectSubtree(const Node& node, std::vector<unsigned int>& out) const;
+    float Cost() const;
+    static float SurfaceArea(const glm::vec3& min, const glm::vec3& max);
+
+  private:
+    std::vector<Node> nodes;
+    std::vector<unsigned int> primIndices;
+    std::vector<glm::vec3> primMin, primMax;
+    std::vector<unsigned int> primUserData;
+    std::vector<bool> primAlive;
+    std::vector<unsigned int> freeProxies;
+    unsigned int proxyCount;
+    bool needsRebuild, needsRefit;
+    float builtCost;
+    mutable std::atomic<unsigned int> lastVisitedNodes;  // queries are const and may run concurrently
+};
+
+#endif  // DEFERRED_BVH_H
@@ -0,0 +1,78 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <fstream>
+#include <glm/gtc/quaternion.hpp>
+#include <iostream>
+#include <sstream>
+
+#include "components/Transform.h"
+
+CameraPath::CameraPath() : cameraKeys(), lightKeys() {}
+
+bool CameraPath::Load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) return false;
+    cameraKeys.clear();
+    lightKeys.clear();
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream in(line);
+        std::string kind;
+        if (!(in >> kind)) continue;
+        Key key = {0.f, glm::vec3(0.f), glm::vec3(0.f)};
+        if (kind == "camera") {
+            if (!(in >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.target.x >> key.target.y >> key.target.z)) {
+                std::cout << path << ":" << lineNumber << ": expected camera <time> <position> <target>" << std::endl;
+                return false;
+            }
+            cameraKeys.push_back(key);
+        } else if (kind == "light") {
+            unsigned int index = 0;
+            if (!(in >> index >> key.time >> key.position.x >> key.position.y >> key.position.z)) {
+                std::cout << path << ":" << lineNumber << ": expected light <index> <time> <position>" << std::endl;
+                return false;
+            }
+            if (index >= lightKeys.size()) lightKeys.resize(index + 1);
+            lightKeys[index].push_back(key);
+        } else {
+            std::cout << path << ":" << lineNumber << ": unknown key " << kind << std::endl;
+            return false;
+        }
+    }
+
+    auto byTime = [](const Key& a, const Key& b) { return a.time < b.time; };
+    std::stable_sort(cameraKeys.begin(), cameraKeys.end(), byTime);
+    for (auto& keys : lightKeys) std::stable_sort(keys.begin(), keys.end(), byTime);
+    return !cameraKeys.empty();
+}
+
+float CameraPath::GetDuration() const { return cameraKeys.empty() ? 0.f : cameraKeys.back().time; }
+
+void CameraPath::SampleCamera(float time, glm::vec3& position, glm::quat& rotation) const {
+    if (cameraKeys.empty()) return;
+    Key key = Sample(cameraKeys, time);
+    position = key.position;
+    glm::vec3 direction = key.target - key.position;
+    if (glm::length(direction) > 1e-4f) rotation = glm::quatLookAt(glm::normalize(direction), Transform::Up);
+}
+
+bool CameraPath::SampleLight(unsigned int light, float time, glm::vec3& position) const {
+    if (light >= lightKeys.size() || lightKeys[light].empty()) return false;
+    position = Sample(lightKeys[light], time).position;
+    return true;
+}
+
+CameraPath::Key CameraPath::Sample(const std::vector<Key>& keys, float time) {
+    if (time <= keys.front().time) return keys.front();
+    if (time >= keys.back().time) return keys.back();
+    auto next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const Key& k) { return t < k.time; });
+    const Key& b = *next;
+    const Key& a = *(next - 1);
+    float t = b.time > a.time ? (time - a.time) / (b.time - a.time) : 0.f;
+    return {time, glm::mix(a.position, b.position, t), glm::mix(a.target, b.target, t)};
+}
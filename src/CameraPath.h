@@ -0,0 +1,39 @@
+#ifndef DEFERRED_CAMERAPATH_H
+#define DEFERRED_CAMERAPATH_H
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <string>
+#include <vector>
+
+// keyframed camera and point light positions for repeatable benchmark runs.
+// keys are linearly interpolated and clamped at both ends. one key per line, # starts a comment:
+//   camera <time> <x> <y> <z> <target x> <target y> <target z>
+//   light <index> <time> <x> <y> <z>
+class CameraPath {
+  public:
+    CameraPath();
+
+    bool Load(const std::string& path);
+    bool IsEmpty() const { return cameraKeys.empty(); }
+    float GetDuration() const;
+
+    void SampleCamera(float time, glm::vec3& position, glm::quat& rotation) const;
+    // false when the path leaves this light alone
+    bool SampleLight(unsigned int light, float time, glm::vec3& position) const;
+
+  private:
+    struct Key {
+        float time;
+        glm::vec3 position, target;
+    };
+
+    static Key Sample(const std::vector<Key>& keys, float time);
+
+  private:
+    std::vector<Key> cameraKeys;
+    std::vector<std::vector<Key>> lightKeys;
+};
+
+#endif  // DEFERRED_CAMERAPATH_H
@@ -0,0 +1,31 @@
+#include "CommandBuffer.h"
+
+#include <algorithm>
+
+// key layout, high to low: material 12 bits, vao 12 bits, depth 16 bits, object 24 bits
+static const unsigned int MATERIAL_BITS = 12;
+static const unsigned int VAO_BITS = 12;
+static const unsigned int DEPTH_BITS = 16;
+static const unsigned int OBJECT_BITS = 24;
+
+CommandBuffer::CommandBuffer() : draws() {}
+
+void CommandBuffer::Clear() { draws.clear(); }
+
+void CommandBuffer::AddDraw(uint64_t key, unsigned int vao, int vertexCount, const Material* material, unsigned int object, bool cullFace, bool conditional,
+                            const glm::mat4& model) {
+    draws.push_back(Draw{key, vao, vertexCount, material, object, cullFace, conditional, model});
+}
+
+void CommandBuffer::Sort() {
+    // keys are unique through the object bits, so the order never depends on the recording thread
+    std::sort(draws.begin(), draws.end(), [](const Draw& a, const Draw& b) { return a.key < b.key; });
+}
+
+uint64_t CommandBuffer::MakeKey(unsigned int material, unsigned int vao, float depth, unsigned int object) {
+    uint64_t m = material & ((1u << MATERIAL_BITS) - 1);
+    uint64_t v = vao & ((1u << VAO_BITS) - 1);
+    uint64_t d = (uint64_t)(glm::clamp(depth, 0.f, 1.f) * (float)((1u << DEPTH_BITS) - 1));
+    uint64_t o = object & ((1u << OBJECT_BITS) - 1);
+    return (m << (VAO_BITS + DEPTH_BITS + OBJECT_BITS)) | (v << (DEPTH_BITS + OBJECT_BITS)) | (d << OBJECT_BITS) | o;
+}
@@ -0,0 +1,41 @@
+#ifndef DEFERRED_COMMANDBUFFER_H
+#define DEFERRED_COMMANDBUFFER_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+class Material;
+
+// draws of one pass, recorded on any thread without touching gl and replayed in key order on the context thread.
+// each draw carries its own uniform payload (the model matrix) so recording never reads state that replay changes.
+class CommandBuffer {
+  public:
+    struct Draw {
+        uint64_t key;
+        unsigned int vao;
+        int vertexCount;
+        const Material* material;  // null for passes that don't bind materials
+        unsigned int object;
+        bool cullFace;
+        bool conditional;  // wrapped in the object's occlusion query
+        glm::mat4 model;
+    };
+
+    CommandBuffer();
+
+    void Clear();
+    void AddDraw(uint64_t key, unsigned int vao, int vertexCount, const Material* material, unsigned int object, bool cullFace, bool conditional, const glm::mat4& model);
+    void Sort();
+
+    const std::vector<Draw>& GetDraws() const { return draws; }
+    unsigned int Size() const { return (unsigned int)draws.size(); }
+
+    // state first so replay changes it as rarely as possible, then front to back, then the object for a stable order
+    static uint64_t MakeKey(unsigned int material, unsigned int vao, float depth, unsigned int object);
+
+  private:
+    std::vector<Draw> draws;
+};
+
+#endif  // DEFERRED_COMMANDBUFFER_H
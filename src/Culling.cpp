@@ -0,0 +1,180 @@
+#include "Culling.h"
+
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#define CULLING_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE 1
+#endif
+
+#if defined(CULLING_AVX)
+const unsigned int CullingSet::BatchSize = 8;
+
+// index of the lowest set bit, mask != 0
+static inline unsigned int lowestBit(unsigned int mask) {
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return (unsigned int)bit;
+#else
+    return (unsigned int)__builtin_ctz(mask);
+#endif
+}
+#elif defined(CULLING_SSE)
+const unsigned int CullingSet::BatchSize = 4;
+#else
+const unsigned int CullingSet::BatchSize = 1;
+#endif
+
+static const unsigned int PADDING = 8;
+
+Frustum::Frustum() {
+    for (glm::vec4& plane : planes) {
+        plane = glm::vec4(0.f, 0.f, 0.f, 1.f);
+    }
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection) { Extract(viewProjection); }
+
+void Frustum::Extract(const glm::mat4& m) {
+    // Gribb & Hartmann, rows of the column major matrix
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+    planes[PLANE_LEFT] = row3 + row0;
+    planes[PLANE_RIGHT] = row3 - row0;
+    planes[PLANE_BOTTOM] = row3 + row1;
+    planes[PLANE_TOP] = row3 - row1;
+    planes[PLANE_NEAR] = row3 + row2;
+    planes[PLANE_FAR] = row3 - row2;
+    for (glm::vec4& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::TestSphere(const glm::vec3& center, float radius) const {
+    for (const glm::vec4& plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+    }
+    return true;
+}
+
+bool Frustum::TestAABB(const glm::vec3& min, const glm::vec3& max) const {
+    for (const glm::vec4& plane : planes) {
+        // corner furthest along the plane normal
+        glm::vec3 p(plane.x >= 0.f ? max.x : min.x, plane.y >= 0.f ? max.y : min.y, plane.z >= 0.f ? max.z : min.z);
+        if (glm::dot(glm::vec3(plane), p) + plane.w < 0.f) return false;
+    }
+    return true;
+}
+
+int Frustum::ClassifyAABB(const glm::vec3& min, const glm::vec3& max) const {
+    int result = INSIDE;
+    for (const glm::vec4& plane : planes) {
+        glm::vec3 n = glm::vec3(plane);
+        glm::vec3 p(plane.x >= 0.f ? max.x : min.x, plane.y >= 0.f ? max.y : min.y, plane.z >= 0.f ? max.z : min.z);
+        glm::vec3 q(plane.x >= 0.f ? min.x : max.x, plane.y >= 0.f ? min.y : max.y, plane.z >= 0.f ? min.z : max.z);
+        if (glm::dot(n, p) + plane.w < 0.f) return OUTSIDE;
+        if (glm::dot(n, q) + plane.w < 0.f) result = INTERSECT;
+    }
+    return result;
+}
+
+CullingSet::CullingSet() : centerX(), centerY(), centerZ(), radius(), count(0) {}
+
+void CullingSet::Clear() {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radius.clear();
+    count = 0;
+}
+
+unsigned int CullingSet::Add(const glm::vec3& center, float r) {
+    unsigned int index = count;
+    Reserve(count + 1);
+    count++;
+    Set(index, center, r);
+    return index;
+}
+
+void CullingSet::Set(unsigned int index, const glm::vec3& center, float r) {
+    centerX[index] = center.x;
+    centerY[index] = center.y;
+    centerZ[index] = center.z;
+    radius[index] = r;
+}
+
+void CullingSet::Reserve(unsigned int n) {
+    unsigned int padded = (n + PADDING - 1) / PADDING * PADDING;
+    if (padded <= radius.size()) return;
+    centerX.resize(padded, 0.f);
+    centerY.resize(padded, 0.f);
+    centerZ.resize(padded, 0.f);
+    radius.resize(padded, -std::numeric_limits<float>::infinity());
+}
+
+void CullingSet::Cull(const Frustum& frustum, std::vector<unsigned int>& visible) const {
+    visible.clear();
+    unsigned int i = 0;
+#if defined(CULLING_AVX)
+    __m256 px[Frustum::PLANE_COUNT], py[Frustum::PLANE_COUNT], pz[Frustum::PLANE_COUNT], pw[Frustum::PLANE_COUNT];
+    for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+        px[p] = _mm256_set1_ps(frustum.planes[p].x);
+        py[p] = _mm256_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm256_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm256_set1_ps(frustum.planes[p].w);
+    }
+    for (; i < count; i += 8) {
+        __m256 x = _mm256_loadu_ps(&centerX[i]);
+        __m256 y = _mm256_loadu_ps(&centerY[i]);
+        __m256 z = _mm256_loadu_ps(&centerZ[i]);
+        __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&radius[i]));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+            __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], x), _mm256_mul_ps(py[p], y)), _mm256_add_ps(_mm256_mul_ps(pz[p], z), pw[p]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, negRadius, _CMP_GE_OQ));
+        }
+        unsigned int mask = (unsigned int)_mm256_movemask_ps(inside);
+        while (mask) {
+            unsigned int bit = lowestBit(mask);
+            if (i + bit < count) visible.push_back(i + bit);
+            mask &= mask - 1;
+        }
+    }
+#elif defined(CULLING_SSE)
+    __m128 px[Frustum::PLANE_COUNT], py[Frustum::PLANE_COUNT], pz[Frustum::PLANE_COUNT], pw[Frustum::PLANE_COUNT];
+    for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+        px[p] = _mm_set1_ps(frustum.planes[p].x);
+        py[p] = _mm_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+    for (; i < count; i += 4) {
+        __m128 x = _mm_loadu_ps(&centerX[i]);
+        __m128 y = _mm_loadu_ps(&centerY[i]);
+        __m128 z = _mm_loadu_ps(&centerZ[i]);
+        __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[i]));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)), _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negRadius));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (unsigned int bit = 0; bit < 4; bit++) {
+            if ((mask & (1 << bit)) && i + bit < count) visible.push_back(i + bit);
+        }
+    }
+#else
+    for (; i < count; i++) {
+        if (frustum.TestSphere(glm::vec3(centerX[i], centerY[i], centerZ[i]), radius[i])) visible.push_back(i);
+    }
+#endif
+}
@@ -0,0 +1,45 @@
+#ifndef DEFERRED_CULLING_H
+#define DEFERRED_CULLING_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// planes point inwards, a point p is inside when dot(plane.xyz, p) + plane.w >= 0
+class Frustum {
+  public:
+    Frustum();
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    void Extract(const glm::mat4& viewProjection);
+    bool TestSphere(const glm::vec3& center, float radius) const;
+    bool TestAABB(const glm::vec3& min, const glm::vec3& max) const;
+    int ClassifyAABB(const glm::vec3& min, const glm::vec3& max) const;
+
+    enum { OUTSIDE = 0, INTERSECT, INSIDE };
+    enum { PLANE_LEFT = 0, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+    glm::vec4 planes[PLANE_COUNT];
+};
+
+// bounding spheres kept as structure of arrays so the plane test runs 4 (SSE) or 8 (AVX) at a time
+class CullingSet {
+  public:
+    CullingSet();
+
+    void Clear();
+    unsigned int Add(const glm::vec3& center, float radius);
+    void Set(unsigned int index, const glm::vec3& center, float radius);
+    void Cull(const Frustum& frustum, std::vector<unsigned int>& visible) const;
+    unsigned int Size() const { return count; }
+
+    static const unsigned int BatchSize;
+
+  private:
+    void Reserve(unsigned int n);
+
+  private:
+    // padded to a multiple of 8, padding entries have a negative infinite radius and never pass
+    std::vector<float> centerX, centerY, centerZ, radius;
+    unsigned int count;
+};
+
+#endif  // DEFERRED_CULLING_H
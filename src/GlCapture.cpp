@@ -0,0 +1,444 @@
+#include "GlCapture.h"
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+static GlCapture& capture() { return GlCapture::Get(); }
+
+static size_t pixelSize(GLenum format, GLenum type) {
+    if (type == GL_UNSIGNED_INT_24_8) return 4;
+    if (type == GL_FLOAT_32_UNSIGNED_INT_24_8_REV) return 8;
+    size_t components = 4;
+    switch (format) {
+        case GL_RED:
+        case GL_RED_INTEGER:
+        case GL_DEPTH_COMPONENT:
+        case GL_STENCIL_INDEX:
+            components = 1;
+            break;
+        case GL_RG:
+        case GL_RG_INTEGER:
+        case GL_DEPTH_STENCIL:
+            components = 2;
+            break;
+        case GL_RGB:
+        case GL_BGR:
+            components = 3;
+            break;
+    }
+    switch (type) {
+        case GL_UNSIGNED_BYTE:
+        case GL_BYTE:
+            return components;
+        case GL_UNSIGNED_SHORT:
+        case GL_SHORT:
+        case GL_HALF_FLOAT:
+            return components * 2;
+        default:
+            return components * 4;
+    }
+}
+
+// every glew entry point the engine calls, hooked while capturing. the real function runs first, so the
+// stream only holds calls in the order the driver saw them
+#define GL_REAL(name) static decltype(__glew##name) real##name = nullptr;
+#define GL_HOOK(name, params, args, ...)           \
+    GL_REAL(name)                                  \
+    static void GLAPIENTRY hook##name params {     \
+        real##name args;                           \
+        capture().Record(GlOp::name, __VA_ARGS__); \
+    }
+#define GL_HOOK_NAMES(name, type)                              \
+    GL_REAL(name)                                              \
+    static void GLAPIENTRY hook##name(GLsizei n, type names) { \
+        real##name(n, names);                                  \
+        capture().RecordNames(GlOp::name, n, names);           \
+    }
+
+GL_HOOK(ActiveTexture, (GLenum texture), (texture), texture)
+GL_HOOK(GenerateMipmap, (GLenum target), (target), target)
+GL_HOOK_NAMES(GenBuffers, GLuint*)
+GL_HOOK_NAMES(DeleteBuffers, const GLuint*)
+GL_HOOK_NAMES(GenVertexArrays, GLuint*)
+GL_HOOK_NAMES(DeleteVertexArrays, const GLuint*)
+GL_HOOK(BindVertexArray, (GLuint array), (array), array)
+GL_HOOK(EnableVertexAttribArray, (GLuint index), (index), index)
+GL_HOOK(VertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer), (index, size, type, normalized, stride, pointer),
+        index, size, type, normalized, stride, (uint64_t)(uintptr_t)pointer)
+GL_HOOK_NAMES(GenFramebuffers, GLuint*)
+GL_HOOK_NAMES(DeleteFramebuffers, const GLuint*)
+GL_HOOK(BindFramebuffer, (GLenum target, GLuint framebuffer), (target, framebuffer), target, framebuffer)
+GL_HOOK(FramebufferTexture, (GLenum target, GLenum attachment, GLuint texture, GLint level), (target, attachment, texture, level), target, attachment, texture, level)
+GL_HOOK(FramebufferTexture2D, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level), (target, attachment, textarget, texture, level), target,
+        attachment, textarget, texture, level)
+GL_HOOK(FramebufferTextureLayer, (GLenum target, GLenum attachment, GLuint texture, GLint level, GLint layer), (target, attachment, texture, level, layer), target, attachment,
+        texture, level, layer)
+GL_HOOK(FramebufferRenderbuffer, (GLenum target, GLenum attachment, GLenum renderbufferTarget, GLuint renderbuffer), (target, attachment, renderbufferTarget, renderbuffer),
+        target, attachment, renderbufferTarget, renderbuffer)
+GL_HOOK_NAMES(GenRenderbuffers, GLuint*)
+GL_HOOK_NAMES(DeleteRenderbuffers, const GLuint*)
+GL_HOOK(BindRenderbuffer, (GLenum target, GLuint renderbuffer), (target, renderbuffer), target, renderbuffer)
+GL_HOOK(RenderbufferStorage, (GLenum target, GLenum internalFormat, GLsizei width, GLsizei height), (target, internalFormat, width, height), target, internalFormat, width,
+        height)
+GL_HOOK(CompileShader, (GLuint shader), (shader), shader)
+GL_HOOK(DeleteShader, (GLuint shader), (shader), shader)
+GL_HOOK(AttachShader, (GLuint program, GLuint shader), (program, shader), program, shader)
+GL_HOOK(LinkProgram, (GLuint program), (program), program)
+GL_HOOK(DeleteProgram, (GLuint program), (program), program)
+GL_HOOK(UseProgram, (GLuint program), (program), program)
+GL_HOOK(Uniform1i, (GLint location, GLint v0), (location, v0), location, v0)
+GL_HOOK(Uniform1f, (GLint location, GLfloat v0), (location, v0), location, v0)
+GL_HOOK(Uniform2f, (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1), location, v0, v1)
+GL_HOOK(Uniform3f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2), (location, v0, v1, v2), location, v0, v1, v2)
+GL_HOOK_NAMES(GenQueries, GLuint*)
+GL_HOOK_NAMES(DeleteQueries, const GLuint*)
+GL_HOOK(BeginQuery, (GLenum target, GLuint id), (target, id), target, id)
+GL_HOOK(EndQuery, (GLenum target), (target), target)
+GL_HOOK(BeginConditionalRender, (GLuint id, GLenum mode), (id, mode), id, mode)
+GL_HOOK(UniformBlockBinding, (GLuint program, GLuint index, GLuint binding), (program, index, binding), program, index, binding)
+GL_HOOK(BindBufferBase, (GLenum target, GLuint index, GLuint buffer), (target, index, buffer), target, index, buffer)
+
+GL_REAL(EndConditionalRender)
+static void GLAPIENTRY hookEndConditionalRender() {
+    realEndConditionalRender();
+    capture().Record(GlOp::EndConditionalRender);
+}
+
+GL_REAL(TexImage3D)
+static void GLAPIENTRY hookTexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type,
+                                      const void* pixels) {
+    realTexImage3D(target, level, internalFormat, width, height, depth, border, format, type, pixels);
+    capture().RecordTexImage(GlOp::TexImage3D, target, level, internalFormat, width, height, depth, border, format, type, pixels);
+}
+
+GL_REAL(CompressedTexImage2D)
+static void GLAPIENTRY hookCompressedTexImage2D(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLint border, GLsizei size, const void* data) {
+    realCompressedTexImage2D(target, level, internalFormat, width, height, border, size, data);
+    capture().RecordCompressedTexImage(target, level, internalFormat, width, height, border, size, data);
+}
+
+GL_REAL(BindBuffer)
+static void GLAPIENTRY hookBindBuffer(GLenum target, GLuint buffer) {
+    realBindBuffer(target, buffer);
+    capture().Record(GlOp::BindBuffer, target, buffer);
+    // texture uploads read from it instead of client memory
+    if (target == GL_PIXEL_UNPACK_BUFFER) capture().SetUnpackBuffer(buffer);
+}
+
+GL_REAL(BufferData)
+static void GLAPIENTRY hookBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    realBufferData(target, size, data, usage);
+    GlCapture& c = capture();
+    c.BeginRecord(GlOp::BufferData);
+    c.Put(target);
+    c.Put((int64_t)size);
+    c.Put(usage);
+    c.Put((uint8_t)(data != nullptr));
+    if (data) c.PutBytes(data, (size_t)size);
+    c.EndRecord();
+}
+
+GL_REAL(BufferSubData)
+static void GLAPIENTRY hookBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    realBufferSubData(target, offset, size, data);
+    GlCapture& c = capture();
+    c.BeginRecord(GlOp::BufferSubData);
+    c.Put(target);
+    c.Put((int64_t)offset);
+    c.Put((int64_t)size);
+    c.PutBytes(data, (size_t)size);
+    c.EndRecord();
+}
+
+GL_REAL(CreateShader)
+static GLuint GLAPIENTRY hookCreateShader(GLenum type) {
+    GLuint shader = realCreateShader(type);
+    capture().Record(GlOp::CreateShader, type, shader);
+    return shader;
+}
+
+GL_REAL(ShaderSource)
+static void GLAPIENTRY hookShaderSource(GLuint shader, GLsizei count, const GLchar* const* strings, const GLint* lengths) {
+    realShaderSource(shader, count, strings, lengths);
+    // the pieces are joined into one source
+    GlCapture& c = capture();
+    c.BeginRecord(GlOp::ShaderSource);
+    c.Put(shader);
+    for (GLsizei i = 0; i < count; i++) {
+        c.PutBytes(strings[i], lengths && lengths[i] >= 0 ? (size_t)lengths[i] : std::strlen(strings[i]));
+    }
+    c.Put('\0');
+    c.EndRecord();
+}
+
+GL_REAL(CreateProgram)
+static GLuint GLAPIENTRY hookCreateProgram() {
+    GLuint program = realCreateProgram();
+    capture().Record(GlOp::CreateProgram, program);
+    return program;
+}
+
+GL_REAL(GetUniformLocation)
+static GLint GLAPIENTRY hookGetUniformLocation(GLuint program, const GLchar* name) {
+    GLint location = realGetUniformLocation(program, name);
+    GlCapture& c = capture();
+    c.BeginRecord(GlOp::GetUniformLocation);
+    c.Put(program);
+    c.Put(location);
+    c.PutString(name);
+    c.EndRecord();
+    return location;
+}
+
+GL_REAL(GetUniformBlockIndex)
+static GLuint GLAPIENTRY hookGetUniformBlockIndex(GLuint program, const GLchar* name) {
+    GLuint index = realGetUniformBlockIndex(program, name);
+    GlCapture& c = capture();
+    c.BeginRecord(GlOp::GetUniformBlockIndex);
+    c.Put(program);
+    c.Put(index);
+    c.PutString(name);
+    c.EndRecord();
+    return index;
+}
+
+template <int N>
+static void recordUniformv(GlOp op, GLint location, GLsizei count, const GLfloat* value) {
+    GlCapture& c = capture();
+    c.BeginRecord(op);
+    c.Put(location);
+    c.Put(count);
+    c.PutBytes(value, (size_t)count * N * sizeof(GLfloat));
+    c.EndRecord();
+}
+
+GL_REAL(Uniform3fv)
+static void GLAPIENTRY hookUniform3fv(GLint location, GLsizei count, const GLfloat* value) {
+    realUniform3fv(location, count, value);
+    recordUniformv<3>(GlOp::Uniform3fv, location, count, value);
+}
+
+GL_REAL(Uniform4fv)
+static void GLAPIENTRY hookUniform4fv(GLint location, GLsizei count, const GLfloat* value) {
+    realUniform4fv(location, count, value);
+    recordUniformv<4>(GlOp::Uniform4fv, location, count, value);
+}
+
+GL_REAL(UniformMatrix4fv)
+static void GLAPIENTRY hookUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    realUniformMatrix4fv(location, count, transpose, value);
+    GlCapture& c = capture();
+    c.BeginRecord(GlOp::UniformMatrix4fv);
+    c.Put(location);
+    c.Put(count);
+    c.Put(transpose);
+    c.PutBytes(value, (size_t)count * 16 * sizeof(GLfloat));
+    c.EndRecord();
+}
+
+GlCapture& GlCapture::Get() {
+    static GlCapture glCapture;
+    return glCapture;
+}
+
+GlCapture::GlCapture() : file(nullptr), path(), record(), frame(0), frameLimit(0), bytesWritten(0), unpackBuffer(0), unpackAlignment(4) {}
+
+GlCapture::~GlCapture() { Stop(); }
+
+bool GlCapture::Start(const std::string& path, int frames, int width, int height) {
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cout << "gl capture to " << path << " failed" << std::endl;
+        return false;
+    }
+    GlCaptureHeader header = {{'D', 'G', 'L', 'C'}, Version, (uint32_t)width, (uint32_t)height, 0};
+    fwrite(&header, sizeof(header), 1, file);
+    this->path = path;
+    frame = 0;
+    frameLimit = frames;
+    bytesWritten = sizeof(header);
+    unpackBuffer = 0;
+    unpackAlignment = 4;
+    InstallHooks(true);
+    std::cout << "capturing gl calls of " << frames << " frames to " << path << std::endl;
+    return true;
+}
+
+void GlCapture::Stop() {
+    if (!file) return;
+    InstallHooks(false);
+    // the frame count is only known now, a capture cut short keeps 0 and replay counts the frames itself
+    uint32_t frames = (uint32_t)frame;
+    fseek(file, offsetof(GlCaptureHeader, frames), SEEK_SET);
+    fwrite(&frames, sizeof(frames), 1, file);
+    fclose(file);
+    file = nullptr;
+    std::cout << "captured " << frames << " frames, " << bytesWritten / 1024 << " KiB to " << path << std::endl;
+}
+
+void GlCapture::BeginFrame() {
+    if (!file) return;
+    Record(GlOp::FrameBegin, (uint32_t)frame);
+}
+
+void GlCapture::EndFrame() {
+    if (!file) return;
+    Record(GlOp::FrameEnd);
+    if (++frame >= frameLimit) Stop();
+}
+
+void GlCapture::BeginGroup(const char* name, int index) {
+    if (!file) return;
+    BeginRecord(GlOp::GroupBegin);
+    Put(index);
+    PutString(name);
+    EndRecord();
+}
+
+void GlCapture::EndGroup() {
+    if (!file) return;
+    Record(GlOp::GroupEnd);
+}
+
+void GlCapture::RecordNames(GlOp op, GLsizei n, const GLuint* names) {
+    BeginRecord(op);
+    Put(n);
+    PutBytes(names, (size_t)n * sizeof(GLuint));
+    EndRecord();
+}
+
+void GlCapture::RecordTexImage(GlOp op, GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format,
+                               GLenum type, const void* pixels) {
+    BeginRecord(op);
+    Put(target);
+    Put(level);
+    Put(internalFormat);
+    Put(width);
+    Put(height);
+    if (op == GlOp::TexImage3D) Put(depth);
+    Put(border);
+    Put(format);
+    Put(type);
+    if (unpackBuffer) {
+        Put(GlPixels::Offset);
+        Put((uint64_t)(uintptr_t)pixels);
+    } else if (pixels) {
+        // rows are padded to the unpack alignment, except the last one which gl never reads past
+        size_t rowSize = (size_t)width * pixelSize(format, type);
+        size_t stride = (rowSize + unpackAlignment - 1) / unpackAlignment * unpackAlignment;
+        uint64_t size = stride * ((size_t)height * depth - 1) + rowSize;
+        Put(GlPixels::Inline);
+        Put(size);
+        PutBytes(pixels, (size_t)size);
+    } else {
+        Put(GlPixels::None);
+    }
+    EndRecord();
+}
+
+void GlCapture::RecordCompressedTexImage(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLint border, GLsizei size, const void* data) {
+    BeginRecord(GlOp::CompressedTexImage2D);
+    Put(target);
+    Put(level);
+    Put(internalFormat);
+    Put(width);
+    Put(height);
+    Put(border);
+    Put(size);
+    if (unpackBuffer) {
+        Put(GlPixels::Offset);
+        Put((uint64_t)(uintptr_t)data);
+    } else if (data) {
+        // blocks have no row padding, size is all there is
+        Put(GlPixels::Inline);
+        Put((uint64_t)size);
+        PutBytes(data, (size_t)size);
+    } else {
+        Put(GlPixels::None);
+    }
+    EndRecord();
+}
+
+void GlCapture::BeginRecord(GlOp op) {
+    record.clear();
+    Put(op);
+    Put((uint32_t)0);
+}
+
+void GlCapture::PutBytes(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    record.insert(record.end(), bytes, bytes + size);
+}
+
+void GlCapture::PutString(const char* text) { PutBytes(text, std::strlen(text) + 1); }
+
+void GlCapture::EndRecord() {
+    uint32_t size = (uint32_t)(record.size() - sizeof(uint16_t) - sizeof(uint32_t));
+    std::memcpy(record.data() + sizeof(uint16_t), &size, sizeof(size));
+    fwrite(record.data(), record.size(), 1, file);
+    bytesWritten += record.size();
+}
+
+void GlCapture::InstallHooks(bool install) {
+#define GL_SWAP(name)                    \
+    if (install && __glew##name) {       \
+        real##name = __glew##name;       \
+        __glew##name = hook##name;       \
+    } else if (!install && real##name) { \
+        __glew##name = real##name;       \
+        real##name = nullptr;            \
+    }
+    GL_SWAP(ActiveTexture)
+    GL_SWAP(TexImage3D)
+    GL_SWAP(CompressedTexImage2D)
+    GL_SWAP(GenerateMipmap)
+    GL_SWAP(GenBuffers)
+    GL_SWAP(DeleteBuffers)
+    GL_SWAP(BindBuffer)
+    GL_SWAP(BindBufferBase)
+    GL_SWAP(BufferData)
+    GL_SWAP(BufferSubData)
+    GL_SWAP(GenVertexArrays)
+    GL_SWAP(DeleteVertexArrays)
+    GL_SWAP(BindVertexArray)
+    GL_SWAP(EnableVertexAttribArray)
+    GL_SWAP(VertexAttribPointer)
+    GL_SWAP(GenFramebuffers)
+    GL_SWAP(DeleteFramebuffers)
+    GL_SWAP(BindFramebuffer)
+    GL_SWAP(FramebufferTexture)
+    GL_SWAP(FramebufferTexture2D)
+    GL_SWAP(FramebufferTextureLayer)
+    GL_SWAP(FramebufferRenderbuffer)
+    GL_SWAP(GenRenderbuffers)
+    GL_SWAP(DeleteRenderbuffers)
+    GL_SWAP(BindRenderbuffer)
+    GL_SWAP(RenderbufferStorage)
+    GL_SWAP(CreateShader)
+    GL_SWAP(ShaderSource)
+    GL_SWAP(CompileShader)
+    GL_SWAP(DeleteShader)
+    GL_SWAP(CreateProgram)
+    GL_SWAP(AttachShader)
+    GL_SWAP(LinkProgram)
+    GL_SWAP(DeleteProgram)
+    GL_SWAP(UseProgram)
+    GL_SWAP(GetUniformLocation)
+    GL_SWAP(GetUniformBlockIndex)
+    GL_SWAP(UniformBlockBinding)
+    GL_SWAP(Uniform1i)
+    GL_SWAP(Uniform1f)
+    GL_SWAP(Uniform2f)
+    GL_SWAP(Uniform3f)
+    GL_SWAP(Uniform3fv)
+    GL_SWAP(Uniform4fv)
+    GL_SWAP(UniformMatrix4fv)
+    GL_SWAP(GenQueries)
+    GL_SWAP(DeleteQueries)
+    GL_SWAP(BeginQuery)
+    GL_SWAP(EndQuery)
+    GL_SWAP(BeginConditionalRender)
+    GL_SWAP(EndConditionalRender)
+#undef GL_SWAP
+}
@@ -0,0 +1,173 @@
+#ifndef DEFERRED_GLCAPTURE_H
+#define DEFERRED_GLCAPTURE_H
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// one record per gl call: u16 op, u32 payload size, then the payload in the order listed.
+// names are the ids the capturing process saw, replay maps them to its own
+enum class GlOp : uint16_t {
+    FrameBegin,  // u32 frame
+    FrameEnd,
+    GroupBegin,  // i32 index, name\0, a ProfileGpuScope
+    GroupEnd,
+
+    GenTextures,  // i32 n, u32 names[n], same for every Gen* and Delete*
+    DeleteTextures,
+    GenBuffers,
+    DeleteBuffers,
+    GenVertexArrays,
+    DeleteVertexArrays,
+    GenFramebuffers,
+    DeleteFramebuffers,
+    GenRenderbuffers,
+    DeleteRenderbuffers,
+    GenQueries,
+    DeleteQueries,
+
+    CreateShader,        // u32 type, u32 shader
+    ShaderSource,        // u32 shader, source\0
+    CompileShader,       // u32 shader
+    DeleteShader,        // u32 shader
+    CreateProgram,       // u32 program
+    AttachShader,        // u32 program, u32 shader
+    LinkProgram,         // u32 program
+    DeleteProgram,       // u32 program
+    GetUniformLocation,  // u32 program, i32 location, name\0
+
+    Enable,         // u32 cap
+    Disable,        // u32 cap
+    Viewport,       // i32 x, y, width, height
+    Clear,          // u32 mask
+    ClearColor,     // f32 r, g, b, a
+    DepthMask,      // u8 flag
+    ColorMask,      // u8 r, g, b, a
+    CullFace,       // u32 mode
+    BlendFunc,      // u32 sfactor, dfactor
+    DrawBuffer,     // u32 buffer
+    ReadBuffer,     // u32 buffer
+    PixelStorei,    // u32 pname, i32 param
+    ActiveTexture,  // u32 unit
+
+    UseProgram,        // u32 program
+    BindVertexArray,   // u32 vao
+    BindBuffer,        // u32 target, u32 buffer
+    BindTexture,       // u32 target, u32 texture
+    BindFramebuffer,   // u32 target, u32 framebuffer
+    BindRenderbuffer,  // u32 target, u32 renderbuffer
+
+    EnableVertexAttribArray,  // u32 index
+    VertexAttribPointer,      // u32 index, i32 size, u32 type, u8 normalized, i32 stride, u64 offset
+
+    BufferData,      // u32 target, i64 size, u32 usage, u8 has data, data[size]
+    BufferSubData,   // u32 target, i64 offset, i64 size, data[size]
+    TexImage2D,      // u32 target, i32 level, i32 internal format, i32 width, height, border, u32 format, type, pixels
+    TexImage3D,      // as TexImage2D with i32 depth after height
+    TexParameteri,   // u32 target, u32 pname, i32 param
+    TexParameterfv,  // u32 target, u32 pname, f32 params[4]
+    GenerateMipmap,  // u32 target
+
+    FramebufferTexture,       // u32 target, attachment, texture, i32 level
+    FramebufferTexture2D,     // u32 target, attachment, textarget, texture, i32 level
+    FramebufferTextureLayer,  // u32 target, attachment, texture, i32 level, layer
+    FramebufferRenderbuffer,  // u32 target, attachment, renderbuffer target, renderbuffer
+    RenderbufferStorage,      // u32 target, internal format, i32 width, height
+
+    Uniform1i,         // i32 location, i32 v0
+    Uniform1f,         // i32 location, f32 v0
+    Uniform2f,         // i32 location, f32 v0, v1
+    Uniform3f,         // i32 location, f32 v0, v1, v2
+    Uniform3fv,        // i32 location, i32 count, f32 values[3 count]
+    Uniform4fv,        // i32 location, i32 count, f32 values[4 count]
+    UniformMatrix4fv,  // i32 location, i32 count, u8 transpose, f32 values[16 count]
+
+    DrawArrays,  // u32 mode, i32 first, i32 count
+
+    // timestamps are left out, they belong to the GpuTimer and replay brings its own
+    BeginQuery,              // u32 target, u32 query
+    EndQuery,                // u32 target
+    BeginConditionalRender,  // u32 query, u32 mode
+    EndConditionalRender,
+
+    CompressedTexImage2D,  // u32 target, i32 level, u32 internal format, i32 width, height, border, i32 size, pixels
+    GetUniformBlockIndex,  // u32 program, u32 index, name\0
+    UniformBlockBinding,   // u32 program, u32 index, u32 binding
+    BindBufferBase,        // u32 target, u32 index, u32 buffer
+
+    Count
+};
+
+// pixels of TexImage2D/3D and CompressedTexImage2D: u8 source, then nothing (null), u64 offset (unpack buffer bound) or u64 size and the texels
+enum class GlPixels : uint8_t { None = 0, Offset = 1, Inline = 2 };
+
+struct GlCaptureHeader {
+    char magic[4];  // DGLC
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t frames;
+};
+
+// opt in recording of every gl call the engine makes, from context creation up to the end of a given frame.
+// entry points glew loads are hooked by swapping glew's function pointers while capturing; the gl 1.1 ones
+// are linked directly and recorded by their *_profile wrappers in util.h instead. gl reads are not recorded,
+// replay re-issues the same work whatever the results would have been. render thread only.
+class GlCapture {
+  public:
+    static const uint32_t Version = 1;
+
+    static GlCapture& Get();
+
+    // right after glewInit, before any other gl call
+    bool Start(const std::string& path, int frames, int width, int height);
+    void Stop();
+    bool IsActive() const { return file != nullptr; }
+
+    void BeginFrame();
+    void EndFrame();  // stops after the last requested frame
+    void BeginGroup(const char* name, int index);
+    void EndGroup();
+
+    template <typename... Args>
+    void Record(GlOp op, const Args&... args) {
+        BeginRecord(op);
+        (Put(args), ...);
+        EndRecord();
+    }
+    void RecordNames(GlOp op, GLsizei n, const GLuint* names);
+    void RecordTexImage(GlOp op, GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type,
+                        const void* pixels);
+    void RecordCompressedTexImage(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLint border, GLsizei size, const void* data);
+
+    // recording internals, public for the hooks
+    void BeginRecord(GlOp op);
+    template <typename T>
+    void Put(const T& value) {
+        PutBytes(&value, sizeof(T));
+    }
+    void PutBytes(const void* data, size_t size);
+    void PutString(const char* text);
+    void EndRecord();
+
+    void SetUnpackBuffer(GLuint buffer) { unpackBuffer = buffer; }
+    void SetUnpackAlignment(GLint alignment) { unpackAlignment = alignment; }
+
+  private:
+    GlCapture();
+    ~GlCapture();
+    void InstallHooks(bool install);
+
+  private:
+    FILE* file;
+    std::string path;
+    std::vector<uint8_t> record;
+    int frame, frameLimit;
+    uint64_t bytesWritten;
+    GLuint unpackBuffer;
+    GLint unpackAlignment;
+};
+
+#endif  // DEFERRED_GLCAPTURE_H
@@ -0,0 +1,549 @@
+#include "GlReplay.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "GpuTimer.h"
+#include "RenderStats.h"
+#include "util.h"
+
+static const size_t RECORD_HEADER = sizeof(uint16_t) + sizeof(uint32_t);
+
+// payload cursor, records are packed so every read goes through memcpy
+struct Reader {
+    const uint8_t* p;
+
+    template <typename T>
+    T Get() {
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return value;
+    }
+    const char* String() {
+        const char* text = reinterpret_cast<const char*>(p);
+        p += std::strlen(text) + 1;
+        return text;
+    }
+    const void* Bytes(size_t size) {
+        const void* bytes = p;
+        p += size;
+        return bytes;
+    }
+};
+
+// replay name of a captured one, grown on demand so an unknown name maps to 0
+static GLuint& slot(std::vector<GLuint>& table, GLuint name) {
+    if (name >= table.size()) table.resize(name + 1, 0);
+    return table[name];
+}
+
+static void genNames(Reader& in, std::vector<GLuint>& table, void (*gen)(GLsizei, GLuint*)) {
+    GLsizei n = in.Get<GLsizei>();
+    std::vector<GLuint> names(n);
+    gen(n, names.data());
+    for (GLsizei i = 0; i < n; i++) slot(table, in.Get<GLuint>()) = names[i];
+}
+
+static void deleteNames(Reader& in, std::vector<GLuint>& table, void (*del)(GLsizei, const GLuint*)) {
+    GLsizei n = in.Get<GLsizei>();
+    std::vector<GLuint> names(n);
+    for (GLsizei i = 0; i < n; i++) {
+        GLuint& name = slot(table, in.Get<GLuint>());
+        names[i] = name;
+        name = 0;
+    }
+    del(n, names.data());
+}
+
+GlReplay::GlReplay()
+    : header(),
+      data(),
+      setup(),
+      frames(),
+      defaultFramebuffer(0),
+      textures(),
+      buffers(),
+      vertexArrays(),
+      framebuffers(),
+      renderbuffers(),
+      queries(),
+      shaders(),
+      programs(),
+      locations(),
+      blockIndices(),
+      currentProgram(0) {}
+
+bool GlReplay::Load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "gl replay: cannot open " << path << std::endl;
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(header)) {
+        std::cout << "gl replay: " << path << " is not a capture" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, "DGLC", 4) != 0 || header.version != GlCapture::Version) {
+        std::cout << "gl replay: " << path << " is not a version " << GlCapture::Version << " capture" << std::endl;
+        return false;
+    }
+
+    // setup runs up to the first frame, every frame after it up to the end of its FrameEnd. a frame the capture
+    // was cut in the middle of is dropped
+    setup = {sizeof(header), sizeof(header)};
+    frames.clear();
+    bool inSetup = true;
+    size_t frameBegin = sizeof(header);
+    size_t pos = sizeof(header);
+    while (pos + RECORD_HEADER <= data.size()) {
+        uint16_t op;
+        uint32_t size;
+        std::memcpy(&op, &data[pos], sizeof(op));
+        std::memcpy(&size, &data[pos + sizeof(op)], sizeof(size));
+        size_t end = pos + RECORD_HEADER + size;
+        if (end > data.size() || op >= (uint16_t)GlOp::Count) break;
+        if (inSetup && op == (uint16_t)GlOp::FrameBegin) {
+            setup.end = frameBegin = pos;
+            inSetup = false;
+        } else if (!inSetup && op == (uint16_t)GlOp::FrameEnd) {
+            frames.push_back({frameBegin, end});
+            frameBegin = end;
+        }
+        pos = end;
+    }
+    if (inSetup) setup.end = pos;
+    if (frames.empty()) {
+        std::cout << "gl replay: " << path << " holds no complete frame" << std::endl;
+        return false;
+    }
+    std::cout << "gl replay: " << frames.size() << " frames, " << data.size() / 1024 << " KiB, captured at " << header.width << "x" << header.height << std::endl;
+    return true;
+}
+
+void GlReplay::RunSetup(unsigned int defaultFramebuffer) {
+    this->defaultFramebuffer = defaultFramebuffer;
+    Run(setup, nullptr);
+}
+
+void GlReplay::RunFrame(int frame, GpuTimer* timer) { Run(frames[frame], timer); }
+
+GLint GlReplay::MapLocation(GLint location) const {
+    if (location < 0) return location;
+    auto it = locations.find((uint64_t)currentProgram << 32 | (uint32_t)location);
+    return it != locations.end() ? it->second : -1;
+}
+
+void GlReplay::Run(const Segment& segment, GpuTimer* timer) {
+    size_t pos = segment.begin;
+    while (pos < segment.end) {
+        uint16_t op;
+        uint32_t size;
+        std::memcpy(&op, &data[pos], sizeof(op));
+        std::memcpy(&size, &data[pos + sizeof(op)], sizeof(size));
+        Reader in = {&data[pos + RECORD_HEADER]};
+        pos += RECORD_HEADER + size;
+
+        switch ((GlOp)op) {
+            case GlOp::FrameBegin:
+            case GlOp::FrameEnd:
+                break;
+            case GlOp::GroupBegin: {
+                int index = in.Get<int>();
+                const char* name = in.String();
+                if (timer) {
+                    timer->Begin(name, index);
+                    RenderStats::Get().BeginPass(name, index);
+                }
+                break;
+            }
+            case GlOp::GroupEnd:
+                if (timer) {
+                    RenderStats::Get().EndPass();
+                    timer->End();
+                }
+                break;
+
+            case GlOp::GenTextures:
+                genNames(in, textures, [](GLsizei n, GLuint* names) { glGenTextures(n, names); });
+                break;
+            case GlOp::DeleteTextures:
+                deleteNames(in, textures, [](GLsizei n, const GLuint* names) { glDeleteTextures(n, names); });
+                break;
+            case GlOp::GenBuffers:
+                genNames(in, buffers, [](GLsizei n, GLuint* names) { glGenBuffers(n, names); });
+                break;
+            case GlOp::DeleteBuffers:
+                deleteNames(in, buffers, [](GLsizei n, const GLuint* names) { glDeleteBuffers(n, names); });
+                break;
+            case GlOp::GenVertexArrays:
+                genNames(in, vertexArrays, [](GLsizei n, GLuint* names) { glGenVertexArrays(n, names); });
+                break;
+            case GlOp::DeleteVertexArrays:
+                deleteNames(in, vertexArrays, [](GLsizei n, const GLuint* names) { glDeleteVertexArrays(n, names); });
+                break;
+            case GlOp::GenFramebuffers:
+                genNames(in, framebuffers, [](GLsizei n, GLuint* names) { glGenFramebuffers(n, names); });
+                break;
+            case GlOp::DeleteFramebuffers:
+                deleteNames(in, framebuffers, [](GLsizei n, const GLuint* names) { glDeleteFramebuffers(n, names); });
+                break;
+            case GlOp::GenRenderbuffers:
+                genNames(in, renderbuffers, [](GLsizei n, GLuint* names) { glGenRenderbuffers(n, names); });
+                break;
+            case GlOp::DeleteRenderbuffers:
+                deleteNames(in, renderbuffers, [](GLsizei n, const GLuint* names) { glDeleteRenderbuffers(n, names); });
+                break;
+            case GlOp::GenQueries:
+                genNames(in, queries, [](GLsizei n, GLuint* names) { glGenQueries(n, names); });
+                break;
+            case GlOp::DeleteQueries:
+                deleteNames(in, queries, [](GLsizei n, const GLuint* names) { glDeleteQueries(n, names); });
+                break;
+
+            case GlOp::CreateShader: {
+                GLenum type = in.Get<GLenum>();
+                slot(shaders, in.Get<GLuint>()) = glCreateShader(type);
+                break;
+            }
+            case GlOp::ShaderSource: {
+                GLuint shader = slot(shaders, in.Get<GLuint>());
+                const char* source = in.String();
+                glShaderSource(shader, 1, &source, nullptr);
+                break;
+            }
+            case GlOp::CompileShader:
+                glCompileShader(slot(shaders, in.Get<GLuint>()));
+                break;
+            case GlOp::DeleteShader: {
+                GLuint& shader = slot(shaders, in.Get<GLuint>());
+                glDeleteShader(shader);
+                shader = 0;
+                break;
+            }
+            case GlOp::CreateProgram:
+                slot(programs, in.Get<GLuint>()) = glCreateProgram();
+                break;
+            case GlOp::AttachShader: {
+                GLuint program = slot(programs, in.Get<GLuint>());
+                glAttachShader(program, slot(shaders, in.Get<GLuint>()));
+                break;
+            }
+            case GlOp::LinkProgram:
+                glLinkProgram(slot(programs, in.Get<GLuint>()));
+                break;
+            case GlOp::DeleteProgram: {
+                GLuint& program = slot(programs, in.Get<GLuint>());
+                glDeleteProgram(program);
+                program = 0;
+                break;
+            }
+            case GlOp::GetUniformLocation: {
+                GLuint program = in.Get<GLuint>();
+                GLint location = in.Get<GLint>();
+                const char* name = in.String();
+                // queried again, the driver may well lay the program out differently this time
+                GLint replayed = glGetUniformLocation(slot(programs, program), name);
+                if (location >= 0) locations[(uint64_t)program << 32 | (uint32_t)location] = replayed;
+                break;
+            }
+            case GlOp::GetUniformBlockIndex: {
+                GLuint program = in.Get<GLuint>();
+                GLuint index = in.Get<GLuint>();
+                const char* name = in.String();
+                GLuint replayed = glGetUniformBlockIndex(slot(programs, program), name);
+                if (index != GL_INVALID_INDEX) blockIndices[(uint64_t)program << 32 | index] = replayed;
+                break;
+            }
+            case GlOp::UniformBlockBinding: {
+                GLuint program = in.Get<GLuint>();
+                GLuint index = in.Get<GLuint>();
+                GLuint binding = in.Get<GLuint>();
+                auto it = blockIndices.find((uint64_t)program << 32 | index);
+                if (it != blockIndices.end() && it->second != GL_INVALID_INDEX) glUniformBlockBinding(slot(programs, program), it->second, binding);
+                break;
+            }
+
+            case GlOp::Enable:
+                glEnable(in.Get<GLenum>());
+                break;
+            case GlOp::Disable:
+                glDisable(in.Get<GLenum>());
+                break;
+            case GlOp::Viewport: {
+                GLint x = in.Get<GLint>(), y = in.Get<GLint>();
+                GLsizei width = in.Get<GLsizei>(), height = in.Get<GLsizei>();
+                glViewport(x, y, width, height);
+                break;
+            }
+            case GlOp::Clear:
+                glClear(in.Get<GLbitfield>());
+                break;
+            case GlOp::ClearColor: {
+                GLfloat r = in.Get<GLfloat>(), g = in.Get<GLfloat>(), b = in.Get<GLfloat>(), a = in.Get<GLfloat>();
+                glClearColor(r, g, b, a);
+                break;
+            }
+            case GlOp::DepthMask:
+                glDepthMask(in.Get<GLboolean>());
+                break;
+            case GlOp::ColorMask: {
+                GLboolean r = in.Get<GLboolean>(), g = in.Get<GLboolean>(), b = in.Get<GLboolean>(), a = in.Get<GLboolean>();
+                glColorMask(r, g, b, a);
+                break;
+            }
+            case GlOp::CullFace:
+                glCullFace(in.Get<GLenum>());
+                break;
+            case GlOp::BlendFunc: {
+                GLenum sfactor = in.Get<GLenum>();
+                glBlendFunc(sfactor, in.Get<GLenum>());
+                break;
+            }
+            case GlOp::DrawBuffer:
+                glDrawBuffer(in.Get<GLenum>());
+                break;
+            case GlOp::ReadBuffer:
+                glReadBuffer(in.Get<GLenum>());
+                break;
+            case GlOp::PixelStorei: {
+                GLenum pname = in.Get<GLenum>();
+                glPixelStorei(pname, in.Get<GLint>());
+                break;
+            }
+            case GlOp::ActiveTexture:
+                glActiveTexture(in.Get<GLenum>());
+                break;
+
+            // the counted wrappers, so replayed frames report the same draws and binds as the captured ones
+            case GlOp::UseProgram:
+                currentProgram = in.Get<GLuint>();
+                glUseProgram_profile(slot(programs, currentProgram));
+                break;
+            case GlOp::BindVertexArray:
+                glBindVertexArray_profile(slot(vertexArrays, in.Get<GLuint>()));
+                break;
+            case GlOp::BindBuffer: {
+                GLenum target = in.Get<GLenum>();
+                glBindBuffer(target, slot(buffers, in.Get<GLuint>()));
+                break;
+            }
+            case GlOp::BindBufferBase: {
+                GLenum target = in.Get<GLenum>();
+                GLuint index = in.Get<GLuint>();
+                glBindBufferBase(target, index, slot(buffers, in.Get<GLuint>()));
+                break;
+            }
+            case GlOp::BindTexture: {
+                GLenum target = in.Get<GLenum>();
+                glBindTexture_profile(target, slot(textures, in.Get<GLuint>()));
+                break;
+            }
+            case GlOp::BindFramebuffer: {
+                GLenum target = in.Get<GLenum>();
+                GLuint framebuffer = in.Get<GLuint>();
+                glBindFramebuffer_profile(target, framebuffer ? slot(framebuffers, framebuffer) : defaultFramebuffer);
+                break;
+            }
+            case GlOp::BindRenderbuffer: {
+                GLenum target = in.Get<GLenum>();
+                glBindRenderbuffer(target, slot(renderbuffers, in.Get<GLuint>()));
+                break;
+            }
+
+            case GlOp::EnableVertexAttribArray:
+                glEnableVertexAttribArray(in.Get<GLuint>());
+                break;
+            case GlOp::VertexAttribPointer: {
+                GLuint index = in.Get<GLuint>();
+                GLint components = in.Get<GLint>();
+                GLenum type = in.Get<GLenum>();
+                GLboolean normalized = in.Get<GLboolean>();
+                GLsizei stride = in.Get<GLsizei>();
+                uint64_t offset = in.Get<uint64_t>();
+                glVertexAttribPointer(index, components, type, normalized, stride, (const void*)(uintptr_t)offset);
+                break;
+            }
+
+            case GlOp::BufferData: {
+                GLenum target = in.Get<GLenum>();
+                GLsizeiptr bytes = (GLsizeiptr)in.Get<int64_t>();
+                GLenum usage = in.Get<GLenum>();
+                const void* contents = in.Get<uint8_t>() ? in.Bytes((size_t)bytes) : nullptr;
+                glBufferData_profile(target, bytes, contents, usage);
+                break;
+            }
+            case GlOp::BufferSubData: {
+                GLenum target = in.Get<GLenum>();
+                GLintptr offset = (GLintptr)in.Get<int64_t>();
+                GLsizeiptr bytes = (GLsizeiptr)in.Get<int64_t>();
+                glBufferSubData_profile(target, offset, bytes, in.Bytes((size_t)bytes));
+                break;
+            }
+            case GlOp::TexImage2D:
+            case GlOp::TexImage3D: {
+                GLenum target = in.Get<GLenum>();
+                GLint level = in.Get<GLint>();
+                GLint internalFormat = in.Get<GLint>();
+                GLsizei width = in.Get<GLsizei>(), height = in.Get<GLsizei>();
+                GLsizei depth = (GlOp)op == GlOp::TexImage3D ? in.Get<GLsizei>() : 1;
+                GLint border = in.Get<GLint>();
+                GLenum format = in.Get<GLenum>(), type = in.Get<GLenum>();
+                const void* pixels = nullptr;
+                switch (in.Get<GlPixels>()) {
+                    case GlPixels::Offset:
+                        pixels = (const void*)(uintptr_t)in.Get<uint64_t>();
+                        break;
+                    case GlPixels::Inline:
+                        pixels = in.Bytes((size_t)in.Get<uint64_t>());
+                        break;
+                    case GlPixels::None:
+                        break;
+                }
+                if ((GlOp)op == GlOp::TexImage3D) {
+                    glTexImage3D(target, level, internalFormat, width, height, depth, border, format, type, pixels);
+                } else {
+                    glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+                }
+                break;
+            }
+            case GlOp::CompressedTexImage2D: {
+                GLenum target = in.Get<GLenum>();
+                GLint level = in.Get<GLint>();
+                GLenum internalFormat = in.Get<GLenum>();
+                GLsizei width = in.Get<GLsizei>(), height = in.Get<GLsizei>();
+                GLint border = in.Get<GLint>();
+                GLsizei size = in.Get<GLsizei>();
+                const void* data = nullptr;
+                switch (in.Get<GlPixels>()) {
+                    case GlPixels::Offset:
+                        data = (const void*)(uintptr_t)in.Get<uint64_t>();
+                        break;
+                    case GlPixels::Inline:
+                        data = in.Bytes((size_t)in.Get<uint64_t>());
+                        break;
+                    case GlPixels::None:
+                        break;
+                }
+                glCompressedTexImage2D(target, level, internalFormat, width, height, border, size, data);
+                break;
+            }
+            case GlOp::TexParameteri: {
+                GLenum target = in.Get<GLenum>(), pname = in.Get<GLenum>();
+                glTexParameteri(target, pname, in.Get<GLint>());
+                break;
+            }
+            case GlOp::TexParameterfv: {
+                GLenum target = in.Get<GLenum>(), pname = in.Get<GLenum>();
+                glTexParameterfv(target, pname, static_cast<const GLfloat*>(in.Bytes(4 * sizeof(GLfloat))));
+                break;
+            }
+            case GlOp::GenerateMipmap:
+                glGenerateMipmap(in.Get<GLenum>());
+                break;
+
+            case GlOp::FramebufferTexture: {
+                GLenum target = in.Get<GLenum>(), attachment = in.Get<GLenum>();
+                GLuint texture = slot(textures, in.Get<GLuint>());
+                glFramebufferTexture(target, attachment, texture, in.Get<GLint>());
+                break;
+            }
+            case GlOp::FramebufferTexture2D: {
+                GLenum target = in.Get<GLenum>(), attachment = in.Get<GLenum>(), textarget = in.Get<GLenum>();
+                GLuint texture = slot(textures, in.Get<GLuint>());
+                glFramebufferTexture2D(target, attachment, textarget, texture, in.Get<GLint>());
+                break;
+            }
+            case GlOp::FramebufferTextureLayer: {
+                GLenum target = in.Get<GLenum>(), attachment = in.Get<GLenum>();
+                GLuint texture = slot(textures, in.Get<GLuint>());
+                GLint level = in.Get<GLint>();
+                glFramebufferTextureLayer(target, attachment, texture, level, in.Get<GLint>());
+                break;
+            }
+            case GlOp::FramebufferRenderbuffer: {
+                GLenum target = in.Get<GLenum>(), attachment = in.Get<GLenum>(), renderbufferTarget = in.Get<GLenum>();
+                glFramebufferRenderbuffer(target, attachment, renderbufferTarget, slot(renderbuffers, in.Get<GLuint>()));
+                break;
+            }
+            case GlOp::RenderbufferStorage: {
+                GLenum target = in.Get<GLenum>(), internalFormat = in.Get<GLenum>();
+                GLsizei width = in.Get<GLsizei>();
+                glRenderbufferStorage(target, internalFormat, width, in.Get<GLsizei>());
+                break;
+            }
+
+            case GlOp::Uniform1i: {
+                GLint location = MapLocation(in.Get<GLint>());
+                glUniform1i_profile(location, in.Get<GLint>());
+                break;
+            }
+            case GlOp::Uniform1f: {
+                GLint location = MapLocation(in.Get<GLint>());
+                glUniform1f_profile(location, in.Get<GLfloat>());
+                break;
+            }
+            case GlOp::Uniform2f: {
+                GLint location = MapLocation(in.Get<GLint>());
+                GLfloat v0 = in.Get<GLfloat>();
+                glUniform2f_profile(location, v0, in.Get<GLfloat>());
+                break;
+            }
+            case GlOp::Uniform3f: {
+                GLint location = MapLocation(in.Get<GLint>());
+                GLfloat v0 = in.Get<GLfloat>(), v1 = in.Get<GLfloat>();
+                glUniform3f_profile(location, v0, v1, in.Get<GLfloat>());
+                break;
+            }
+            case GlOp::Uniform3fv: {
+                GLint location = MapLocation(in.Get<GLint>());
+                GLsizei count = in.Get<GLsizei>();
+                glUniform3fv_profile(location, count, static_cast<const GLfloat*>(in.Bytes((size_t)count * 3 * sizeof(GLfloat))));
+                break;
+            }
+            case GlOp::Uniform4fv: {
+                GLint location = MapLocation(in.Get<GLint>());
+                GLsizei count = in.Get<GLsizei>();
+                glUniform4fv_profile(location, count, static_cast<const GLfloat*>(in.Bytes((size_t)count * 4 * sizeof(GLfloat))));
+                break;
+            }
+            case GlOp::UniformMatrix4fv: {
+                GLint location = MapLocation(in.Get<GLint>());
+                GLsizei count = in.Get<GLsizei>();
+                GLboolean transpose = in.Get<GLboolean>();
+                glUniformMatrix4fv_profile(location, count, transpose, static_cast<const GLfloat*>(in.Bytes((size_t)count * 16 * sizeof(GLfloat))));
+                break;
+            }
+
+            case GlOp::DrawArrays: {
+                GLenum mode = in.Get<GLenum>();
+                GLint first = in.Get<GLint>();
+                glDrawArrays_profile(mode, first, in.Get<GLsizei>());
+                break;
+            }
+
+            case GlOp::BeginQuery: {
+                GLenum target = in.Get<GLenum>();
+                glBeginQuery(target, slot(queries, in.Get<GLuint>()));
+                break;
+            }
+            case GlOp::EndQuery:
+                glEndQuery(in.Get<GLenum>());
+                break;
+            case GlOp::BeginConditionalRender: {
+                GLuint query = slot(queries, in.Get<GLuint>());
+                glBeginConditionalRender(query, in.Get<GLenum>());
+                break;
+            }
+            case GlOp::EndConditionalRender:
+                glEndConditionalRender();
+                break;
+
+            case GlOp::Count:
+                break;
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef DEFERRED_GLREPLAY_H
+#define DEFERRED_GLREPLAY_H
+
+#include <GL/glew.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GlCapture.h"
+
+class GpuTimer;
+
+// re-issues a capture, untimed setup first, then any captured frame on its own so a benchmark can loop them.
+// captured framebuffer 0 is redirected to defaultFramebuffer, groups become GpuTimer scopes and RenderStats passes
+class GlReplay {
+  public:
+    GlReplay();
+
+    bool Load(const std::string& path);
+    int GetFrameCount() const { return (int)frames.size(); }
+    int GetWidth() const { return (int)header.width; }
+    int GetHeight() const { return (int)header.height; }
+    size_t GetSize() const { return data.size(); }
+
+    void RunSetup(unsigned int defaultFramebuffer);
+    void RunFrame(int frame, GpuTimer* timer);
+
+  private:
+    struct Segment {
+        size_t begin, end;
+    };
+
+    void Run(const Segment& segment, GpuTimer* timer);
+    GLint MapLocation(GLint location) const;
+
+  private:
+    GlCaptureHeader header;
+    std::vector<uint8_t> data;
+    Segment setup;
+    std::vector<Segment> frames;
+    unsigned int defaultFramebuffer;
+    // captured name to replay name, indexed by the captured name
+    std::vector<GLuint> textures, buffers, vertexArrays, framebuffers, renderbuffers, queries, shaders, programs;
+    std::unordered_map<uint64_t, GLint> locations;      // captured program << 32 | captured location
+    std::unordered_map<uint64_t, GLuint> blockIndices;  // captured program << 32 | captured block index
+    GLuint currentProgram;                          // captured name
+};
+
+#endif  // DEFERRED_GLREPLAY_H
@@ -0,0 +1,107 @@
+#include "GpuTimer.h"
+
+#include <GL/glew.h>
+
+GpuTimer::GpuTimer() : frames(), stack(), stackDepth(0), overflowDepth(0), frameCounter(0), results(), resultCount(0), latency(0), resultFrame(0), resultOrigin(0), droppedFrames(0) {}
+
+GpuTimer::~GpuTimer() {
+    for (Frame& f : frames) {
+        if (f.queries[0]) glDeleteQueries(MaxScopes * 2, f.queries);
+    }
+}
+
+bool GpuTimer::Init() {
+    for (Frame& f : frames) {
+        glGenQueries(MaxScopes * 2, f.queries);
+        f.scopeCount = 0;
+        f.lastQuery = -1;
+        f.frame = 0;
+        f.pending = false;
+    }
+    return glGetError() == GL_NO_ERROR;
+}
+
+void GpuTimer::BeginFrame() {
+    // the gpu finishes frames in order, so stop at the first one that is still running
+    for (int k = 1; k <= RingSize; k++) {
+        Frame& f = frames[(frameCounter + k) % RingSize];
+        if (f.pending && !Collect(f)) break;
+    }
+
+    frameCounter++;
+    Frame& f = frames[frameCounter % RingSize];
+    if (f.pending) droppedFrames++;
+    f.scopeCount = 0;
+    f.lastQuery = -1;
+    f.frame = frameCounter;
+    f.pending = false;
+    stackDepth = 0;
+    overflowDepth = 0;
+}
+
+void GpuTimer::EndFrame() {
+    Frame& f = frames[frameCounter % RingSize];
+    overflowDepth = 0;
+    while (stackDepth > 0) End();
+    f.pending = f.lastQuery >= 0;
+}
+
+void GpuTimer::Begin(const char* name, int index) {
+    Frame& f = frames[frameCounter % RingSize];
+    if (stackDepth == MaxScopes) {
+        overflowDepth++;
+        return;
+    }
+    if (f.scopeCount == MaxScopes) {
+        stack[stackDepth++] = -1;
+        return;
+    }
+    int s = f.scopeCount++;
+    f.scopes[s] = {name, index, stackDepth};
+    stack[stackDepth++] = s;
+    glQueryCounter(f.queries[s * 2], GL_TIMESTAMP);
+    f.lastQuery = s * 2;
+}
+
+void GpuTimer::End() {
+    // the scopes too deep to push close first, their parents are still open
+    if (overflowDepth > 0) {
+        overflowDepth--;
+        return;
+    }
+    if (stackDepth == 0) return;
+    int s = stack[--stackDepth];
+    if (s < 0) return;
+    Frame& f = frames[frameCounter % RingSize];
+    glQueryCounter(f.queries[s * 2 + 1], GL_TIMESTAMP);
+    f.lastQuery = s * 2 + 1;
+}
+
+double GpuTimer::GetFrameTime() const {
+    double total = 0.0;
+    for (int i = 0; i < resultCount; i++) {
+        if (results[i].depth == 0) total += results[i].end - results[i].begin;
+    }
+    return total;
+}
+
+bool GpuTimer::Collect(Frame& f) {
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(f.queries[f.lastQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return false;
+
+    GLuint64 origin = 0;
+    glGetQueryObjectui64v(f.queries[0], GL_QUERY_RESULT, &origin);
+    for (int s = 0; s < f.scopeCount; s++) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(f.queries[s * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(f.queries[s * 2 + 1], GL_QUERY_RESULT, &end);
+        results[s] = {f.scopes[s].name, f.scopes[s].index, f.scopes[s].depth, (double)(begin - origin) * 1e-6, (double)(end - origin) * 1e-6};
+    }
+    resultCount = f.scopeCount;
+    latency = (int)(frameCounter - f.frame);
+    resultFrame = f.frame;
+    resultOrigin = origin;
+    f.pending = false;
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef DEFERRED_GPUTIMER_H
+#define DEFERRED_GPUTIMER_H
+
+// per pass gpu timings without ever stalling on the gpu.
+// every scope writes a GL_TIMESTAMP at its begin and end, results of a frame are only read back once the last
+// timestamp of that frame reports GL_QUERY_RESULT_AVAILABLE, usually two or three frames later.
+// a frame whose slot comes around again before its results arrived is dropped rather than waited for.
+class GpuTimer {
+  public:
+    static const int RingSize = 4;    // frames in flight
+    static const int MaxScopes = 32;  // per frame, deeper scopes are ignored
+
+    struct Result {
+        const char* name;  // must outlive the timer, string literals only
+        int index;         // -1 unless the scope is one of many, like a light
+        int depth;
+        double begin, end;  // ms since the first scope of the frame
+    };
+
+    GpuTimer();
+    ~GpuTimer();
+
+    bool Init();
+    void BeginFrame();
+    void EndFrame();
+    void Begin(const char* name, int index = -1);
+    void End();
+
+    // the newest frame read back
+    int GetResultCount() const { return resultCount; }
+    const Result& GetResult(int i) const { return results[i]; }
+    double GetFrameTime() const;
+    int GetLatency() const { return latency; }  // frames between issue and read back
+    unsigned long GetResultFrame() const { return resultFrame; }
+    unsigned long long GetResultOrigin() const { return resultOrigin; }  // gpu timestamp in ns of the first scope
+    unsigned long GetDroppedFrames() const { return droppedFrames; }
+
+  private:
+    struct Scope {
+        const char* name;
+        int index, depth;
+    };
+    struct Frame {
+        unsigned int queries[MaxScopes * 2];
+        Scope scopes[MaxScopes];
+        int scopeCount;
+        int lastQuery;  // last timestamp issued, once it is available all of them are
+        unsigned long frame;
+        bool pending;
+    };
+
+    bool Collect(Frame& f);
+
+  private:
+    Frame frames[RingSize];
+    int stack[MaxScopes];
+    int stackDepth;
+    int overflowDepth;  // scopes opened past MaxScopes deep, End drops these before popping the stack
+    unsigned long frameCounter;
+    Result results[MaxScopes];
+    int resultCount, latency;
+    unsigned long resultFrame;
+    unsigned long long resultOrigin;
+    unsigned long droppedFrames;
+};
+
+#endif  // DEFERRED_GPUTIMER_H
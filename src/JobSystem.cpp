@@ -0,0 +1,137 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+
+// which worker of which job system the current thread is
+static thread_local const JobSystem* currentSystem = nullptr;
+static thread_local unsigned int currentWorker = 0;
+
+JobSystem::JobSystem(unsigned int workers)
+    : queues(), threads(), sleepMutex(), wakeCondition(), queuedJobs(0), quit(false), profileHook(), startTime(std::chrono::steady_clock::now()) {
+    if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int i = 0; i < workers; i++) {
+        queues.push_back(new Queue());
+    }
+    currentSystem = this;
+    currentWorker = 0;
+    for (unsigned int i = 1; i < workers; i++) {
+        threads.emplace_back(&JobSystem::WorkerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        quit = true;
+    }
+    wakeCondition.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (Queue* queue : queues) {
+        delete queue;
+    }
+    if (currentSystem == this) currentSystem = nullptr;
+}
+
+unsigned int JobSystem::GetCurrentWorker() const { return currentSystem == this ? currentWorker : 0; }
+
+void JobSystem::Run(const char* name, JobFunction func, JobCounter* counter, const JobCounter* dependency) {
+    if (counter) counter->value.fetch_add(1, std::memory_order_relaxed);
+    Job job = {name, std::move(func), counter, dependency};
+
+    if (queues.size() == 1) {
+        // inline, anything it depends on was submitted earlier and has already run
+        assert(!dependency || dependency->value.load() == 0);
+        Execute(job, 0);
+        return;
+    }
+
+    Queue* queue = queues[GetCurrentWorker()];
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->jobs.push_back(std::move(job));
+    }
+    queuedJobs.fetch_add(1, std::memory_order_release);
+    {
+        // pairs with the predicate check in WorkerLoop so the wake up can't be lost
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wakeCondition.notify_one();
+}
+
+void JobSystem::Wait(const JobCounter* counter) {
+    unsigned int worker = GetCurrentWorker();
+    while (counter->value.load(std::memory_order_acquire) > 0) {
+        if (!TryRunOne(worker)) std::this_thread::yield();
+    }
+}
+
+void JobSystem::ParallelFor(const char* name, unsigned int count, unsigned int grain, const RangeFunction& func) {
+    if (count == 0) return;
+    grain = std::max(grain, 1u);
+    JobCounter counter;
+    for (unsigned int begin = 0; begin < count; begin += grain) {
+        unsigned int end = std::min(begin + grain, count);
+        Run(name, [&func, begin, end]() { func(begin, end); }, &counter);
+    }
+    Wait(&counter);
+}
+
+void JobSystem::WorkerLoop(unsigned int worker) {
+    currentSystem = this;
+    currentWorker = worker;
+    while (true) {
+        if (TryRunOne(worker)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        if (quit) return;
+        if (queuedJobs.load(std::memory_order_acquire) > 0) {
+            // work exists but is blocked on a dependency or being taken right now
+            lock.unlock();
+            std::this_thread::yield();
+            continue;
+        }
+        wakeCondition.wait(lock, [this] { return quit || queuedJobs.load(std::memory_order_acquire) > 0; });
+        if (quit) return;
+    }
+}
+
+bool JobSystem::TryRunOne(unsigned int worker) {
+    unsigned int count = (unsigned int)queues.size();
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int victim = (worker + i) % count;
+        Queue* queue = queues[victim];
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            // own work newest first for cache locality, stolen work oldest first. jobs still blocked on a dependency
+            // are passed over where they are: moved to either end, the owner or every thief would pick them up next
+            std::deque<Job>& jobs = queue->jobs;
+            size_t size = jobs.size(), index = size;
+            for (size_t k = 0; k < size; k++) {
+                size_t candidate = victim == worker ? size - 1 - k : k;
+                const Job& next = jobs[candidate];
+                if (next.dependency && next.dependency->value.load(std::memory_order_acquire) > 0) continue;
+                index = candidate;
+                break;
+            }
+            if (index == size) continue;
+            job = std::move(jobs[index]);
+            jobs.erase(jobs.begin() + index);
+        }
+        queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        Execute(job, worker);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::Execute(Job& job, unsigned int worker) {
+    double begin = profileHook ? Now() : 0.0;
+    job.func();
+    if (profileHook) profileHook(JobProfile{job.name, worker, begin, Now()});
+    if (job.counter) job.counter->value.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+double JobSystem::Now() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count(); }
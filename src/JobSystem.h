@@ -0,0 +1,76 @@
+#ifndef DEFERRED_JOBSYSTEM_H
+#define DEFERRED_JOBSYSTEM_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// number of jobs still running, Run increments it and the job decrements it when done
+struct JobCounter {
+    JobCounter() : value(0) {}
+    std::atomic<int> value;
+};
+
+struct JobProfile {
+    const char* name;
+    unsigned int worker;
+    double begin, end;  // seconds since the job system started
+};
+
+// work stealing scheduler.
+// every thread owns a deque, it pushes and pops its own jobs at the back while idle threads steal from the front.
+// the calling thread is worker 0 and helps while it waits. with a single worker every job runs inline in submission
+// order, which makes a frame fully deterministic.
+class JobSystem {
+  public:
+    typedef std::function<void()> JobFunction;
+    typedef std::function<void(unsigned int begin, unsigned int end)> RangeFunction;
+    typedef std::function<void(const JobProfile& profile)> ProfileHook;
+
+    explicit JobSystem(unsigned int workers = 0);  // 0 picks one per hardware thread
+    ~JobSystem();
+
+    // dependency, if given, must reach zero before the job may start
+    void Run(const char* name, JobFunction func, JobCounter* counter, const JobCounter* dependency = nullptr);
+    void Wait(const JobCounter* counter);
+    void ParallelFor(const char* name, unsigned int count, unsigned int grain, const RangeFunction& func);
+
+    unsigned int GetWorkerCount() const { return (unsigned int)queues.size(); }
+    unsigned int GetCurrentWorker() const;
+    // called on the worker that ran the job, so it has to be thread safe
+    void SetProfileHook(ProfileHook hook) { profileHook = hook; }
+
+  private:
+    struct Job {
+        const char* name;
+        JobFunction func;
+        JobCounter* counter;
+        const JobCounter* dependency;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void WorkerLoop(unsigned int worker);
+    bool TryRunOne(unsigned int worker);
+    void Execute(Job& job, unsigned int worker);
+    double Now() const;
+
+  private:
+    std::vector<Queue*> queues;
+    std::vector<std::thread> threads;
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+    std::atomic<int> queuedJobs;
+    std::atomic<bool> quit;
+    ProfileHook profileHook;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+#endif  // DEFERRED_JOBSYSTEM_H
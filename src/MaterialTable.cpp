@@ -0,0 +1,98 @@
+#include "MaterialTable.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+
+#include "TextureCooker.h"
+#include "components/Material.h"
+#include "util.h"
+
+MaterialTable::MaterialTable() : materials(), ids(), arrayIndex(), pending(), arrays(), params(MaxMaterials, glm::vec4(0.f)), buffer(0), dirty(true) {}
+
+unsigned int MaterialTable::GetId(const Material* material) {
+    auto it = ids.emplace(material, (unsigned int)materials.size());
+    if (it.second) {
+        materials.push_back(material);
+        arrayIndex.push_back(-1);
+        dirty = true;
+    }
+    return it.first->second;
+}
+
+bool MaterialTable::AddLayer(Material* material, const unsigned char* rgba, int width, int height) {
+    // the shader indexes the block with the id, so only ids inside it can draw from a layer
+    if (GetId(material) >= MaxMaterials) return false;
+    pending.push_back({material, width, height, std::vector<unsigned char>(rgba, rgba + (size_t)width * height * 4)});
+    return true;
+}
+
+void MaterialTable::Upload() {
+    if (pending.empty()) return;
+    GLint maxLayers = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    std::stable_sort(pending.begin(), pending.end(), [](const Layer& a, const Layer& b) { return a.width != b.width ? a.width < b.width : a.height < b.height; });
+
+    std::vector<std::vector<CookedLevel>> mips;
+    std::vector<unsigned char> texels;
+    for (size_t first = 0; first < pending.size();) {
+        // one array per size, split where the driver runs out of layers
+        size_t last = first + 1;
+        while (last < pending.size() && last - first < (size_t)maxLayers && pending[last].width == pending[first].width && pending[last].height == pending[first].height) last++;
+        const int layers = (int)(last - first);
+        mips.resize(layers);
+        for (int l = 0; l < layers; l++) {
+            const Layer& layer = pending[first + l];
+            texture_cooker::buildMips(layer.texels.data(), layer.width, layer.height, 4, TextureUsage::Color, texture_cooker::MipFilter::Box, mips[l]);
+        }
+
+        unsigned int array;
+        glGenTextures_profile(1, &array);
+        glBindTexture_profile(GL_TEXTURE_2D_ARRAY, array);
+        for (size_t level = 0; level < mips[0].size(); level++) {
+            texels.clear();
+            for (int l = 0; l < layers; l++) texels.insert(texels.end(), mips[l][level].data.begin(), mips[l][level].data.end());
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, GL_RGBA8, mips[0][level].width, mips[0][level].height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+        }
+        glTexParameteri_profile(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri_profile(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri_profile(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri_profile(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        for (int l = 0; l < layers; l++) {
+            Material* material = pending[first + l].material;
+            material->SetDiffuseLayer(array, l);
+            arrayIndex[GetId(material)] = (int)arrays.size();
+        }
+        arrays.push_back(array);
+        first = last;
+    }
+    glBindTexture_profile(GL_TEXTURE_2D_ARRAY, 0);
+    pending.clear();
+    dirty = true;
+}
+
+unsigned int MaterialTable::GetSortKey(unsigned int id) const { return arrayIndex[id] >= 0 ? (unsigned int)arrayIndex[id] : (unsigned int)arrays.size() + id; }
+
+void MaterialTable::Bind() {
+    if (!buffer) glGenBuffers(1, &buffer);
+    if (dirty) {
+        for (unsigned int i = 0; i < materials.size() && i < MaxMaterials; i++) {
+            params[i] = glm::vec4(materials[i]->GetShininess(), (float)materials[i]->GetDiffuseLayer(), 0.f, 0.f);
+        }
+        // always the whole block, a smaller buffer behind it is undefined behaviour
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData_profile(GL_UNIFORM_BUFFER, (GLsizeiptr)(params.size() * sizeof(glm::vec4)), params.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        dirty = false;
+    }
+    glBindBufferBase(GL_UNIFORM_BUFFER, BlockBinding, buffer);
+}
+
+void MaterialTable::Release() {
+    if (!arrays.empty()) glDeleteTextures_profile((GLsizei)arrays.size(), arrays.data());
+    if (buffer) glDeleteBuffers(1, &buffer);
+    arrays.clear();
+    buffer = 0;
+    dirty = true;
+}
@@ -0,0 +1,57 @@
+#ifndef DEFERRED_MATERIALTABLE_H
+#define DEFERRED_MATERIALTABLE_H
+
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+
+class Material;
+
+// every material the scene draws, by a dense id. diffuse texels handed to AddLayer become a layer of a
+// GL_TEXTURE_2D_ARRAY shared with the other textures of their size, and the parameters of all materials sit in one
+// uniform block indexed by id: switching between layered materials of one array sets an int instead of binding
+// textures and uploading uniforms. file textures keep a texture of their own, they stream a level at a time and an
+// array has one mip range for all its layers.
+class MaterialTable {
+  public:
+    static const unsigned int MaxMaterials = 1024;  // a vec4 each, the 16 KiB every gl 3.3 driver allows a block
+    static const unsigned int BlockBinding = 0;     // uniform buffer binding of the Materials block
+
+    MaterialTable();
+
+    // dense id of a material, added on first use
+    unsigned int GetId(const Material* material);
+    const Material* Get(unsigned int id) const { return materials[id]; }
+    unsigned int GetCount() const { return (unsigned int)materials.size(); }
+    int GetArrayCount() const { return (int)arrays.size(); }
+
+    // copies the rgba texels of a material's diffuse texture, drawn from a layer after Upload. layered materials
+    // have no normal map. false when the block is full, the material then needs a texture of its own
+    bool AddLayer(Material* material, const unsigned char* rgba, int width, int height);
+    // builds the arrays from what AddLayer collected, mips box filtered on this thread
+    void Upload();
+    // the layered materials of one array share a key so their draws sort together, any other material has its own
+    unsigned int GetSortKey(unsigned int id) const;
+    // refreshes the block when materials were added and binds it, before the lit pass
+    void Bind();
+    // before the context goes
+    void Release();
+
+  private:
+    struct Layer {
+        Material* material;
+        int width, height;
+        std::vector<unsigned char> texels;
+    };
+
+    std::vector<const Material*> materials;
+    std::unordered_map<const Material*, unsigned int> ids;
+    std::vector<int> arrayIndex;  // per id, -1 for a material with its own textures
+    std::vector<Layer> pending;
+    std::vector<unsigned int> arrays;
+    std::vector<glm::vec4> params;  // shininess, diffuse layer
+    unsigned int buffer;
+    bool dirty;
+};
+
+#endif  // DEFERRED_MATERIALTABLE_H
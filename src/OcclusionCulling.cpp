@@ -0,0 +1,215 @@
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "JobSystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE 1
+#endif
+
+// bands are whole tile rows so the tile max pass never crosses a band
+static const int TILE_ROWS_PER_BAND = 2;
+static const float NEAR_W = 1e-4f;
+
+OcclusionCulling::OcclusionCulling(int w, int h, JobSystem* jobSystem)
+    : width((w + TileSize - 1) / TileSize * TileSize),
+      height((h + TileSize - 1) / TileSize * TileSize),
+      tilesX(width / TileSize),
+      tilesY(height / TileSize),
+      bandCount((tilesY + TILE_ROWS_PER_BAND - 1) / TILE_ROWS_PER_BAND),
+      viewProjection(1.f),
+      depth(width * height, 1.f),
+      tileMax(tilesX * tilesY, 1.f),
+      triangles(),
+      jobs(jobSystem) {}
+
+OcclusionCulling::~OcclusionCulling() {}
+
+void OcclusionCulling::Begin(const glm::mat4& vp) {
+    viewProjection = vp;
+    triangles.clear();
+    std::fill(depth.begin(), depth.end(), 1.f);
+    std::fill(tileMax.begin(), tileMax.end(), 1.f);
+}
+
+void OcclusionCulling::AddOccluder(const glm::mat4& model, const glm::vec3* positions, unsigned int vertexCount) {
+    glm::mat4 mvp = viewProjection * model;
+    for (unsigned int i = 0; i + 2 < vertexCount; i += 3) {
+        AddClipTriangle(mvp * glm::vec4(positions[i], 1.f), mvp * glm::vec4(positions[i + 1], 1.f), mvp * glm::vec4(positions[i + 2], 1.f));
+    }
+}
+
+void OcclusionCulling::AddClipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+    // clip against the near plane (z > -w), everything else is handled by the screen bounds
+    glm::vec4 in[3] = {a, b, c};
+    glm::vec4 poly[4];
+    int count = 0;
+    for (int i = 0; i < 3; i++) {
+        const glm::vec4& p = in[i];
+        const glm::vec4& q = in[(i + 1) % 3];
+        float dp = p.z + p.w;
+        float dq = q.z + q.w;
+        if (dp >= 0.f) poly[count++] = p;
+        if ((dp >= 0.f) != (dq >= 0.f)) poly[count++] = p + (q - p) * (dp / (dp - dq));
+    }
+    if (count < 3) return;
+
+    glm::vec3 screen[4];
+    for (int i = 0; i < count; i++) {
+        float invW = 1.f / std::max(poly[i].w, NEAR_W);
+        screen[i] = glm::vec3((poly[i].x * invW * 0.5f + 0.5f) * width, (poly[i].y * invW * 0.5f + 0.5f) * height, poly[i].z * invW * 0.5f + 0.5f);
+    }
+    for (int i = 1; i + 1 < count; i++) {
+        ScreenTriangle tri;
+        tri.v[0] = screen[0];
+        tri.v[1] = screen[i];
+        tri.v[2] = screen[i + 1];
+        float area = (tri.v[1].x - tri.v[0].x) * (tri.v[2].y - tri.v[0].y) - (tri.v[1].y - tri.v[0].y) * (tri.v[2].x - tri.v[0].x);
+        if (area == 0.f) continue;
+        if (area < 0.f) std::swap(tri.v[1], tri.v[2]);
+        triangles.push_back(tri);
+    }
+}
+
+void OcclusionCulling::Rasterize() {
+    if (!jobs) {
+        for (int band = 0; band < bandCount; band++) {
+            RasterizeBand(band);
+        }
+        return;
+    }
+    jobs->ParallelFor("occlusion raster", (unsigned int)bandCount, 1, [this](unsigned int begin, unsigned int end) {
+        for (unsigned int band = begin; band < end; band++) {
+            RasterizeBand((int)band);
+        }
+    });
+}
+
+void OcclusionCulling::RasterizeBand(int band) {
+    int tileY0 = band * TILE_ROWS_PER_BAND;
+    int tileY1 = std::min(tileY0 + TILE_ROWS_PER_BAND, tilesY);
+    int minY = tileY0 * TileSize;
+    int maxY = tileY1 * TileSize;
+
+    for (const ScreenTriangle& tri : triangles) {
+        RasterizeTriangle(tri, minY, maxY);
+    }
+
+    for (int ty = tileY0; ty < tileY1; ty++) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            float farthest = 0.f;
+            for (int y = ty * TileSize; y < (ty + 1) * TileSize; y++) {
+                const float* row = &depth[y * width + tx * TileSize];
+                for (int x = 0; x < TileSize; x++) {
+                    farthest = std::max(farthest, row[x]);
+                }
+            }
+            tileMax[ty * tilesX + tx] = farthest;
+        }
+    }
+}
+
+void OcclusionCulling::RasterizeTriangle(const ScreenTriangle& tri, int minY, int maxY) {
+    const glm::vec3& v0 = tri.v[0];
+    const glm::vec3& v1 = tri.v[1];
+    const glm::vec3& v2 = tri.v[2];
+
+    // pixel centers inside the bounding box, x aligned down to 4 for the simd loop
+    int x0 = std::max((int)std::floor(std::min(v0.x, std::min(v1.x, v2.x))), 0) & ~3;
+    int x1 = std::min((int)std::ceil(std::max(v0.x, std::max(v1.x, v2.x))), width);
+    int y0 = std::max((int)std::floor(std::min(v0.y, std::min(v1.y, v2.y))), minY);
+    int y1 = std::min((int)std::ceil(std::max(v0.y, std::max(v1.y, v2.y))), maxY);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    // edge functions e(x, y) = a * x + b * y + c, positive inside (counter clockwise)
+    float a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = v1.x * v2.y - v2.x * v1.y;
+    float a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = v2.x * v0.y - v0.x * v2.y;
+    float a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = v0.x * v1.y - v1.x * v0.y;
+    float invArea = 1.f / (c0 + c1 + c2);
+
+    // depth plane z(x, y) = zx * x + zy * y + zc
+    float zx = (a0 * v0.z + a1 * v1.z + a2 * v2.z) * invArea;
+    float zy = (b0 * v0.z + b1 * v1.z + b2 * v2.z) * invArea;
+    float zc = (c0 * v0.z + c1 * v1.z + c2 * v2.z) * invArea;
+
+#if defined(OCCLUSION_SSE)
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 va0 = _mm_set1_ps(a0), va1 = _mm_set1_ps(a1), va2 = _mm_set1_ps(a2), vzx = _mm_set1_ps(zx);
+    for (int y = y0; y < y1; y++) {
+        float py = (float)y + 0.5f;
+        __m128 rowE0 = _mm_set1_ps(b0 * py + c0);
+        __m128 rowE1 = _mm_set1_ps(b1 * py + c1);
+        __m128 rowE2 = _mm_set1_ps(b2 * py + c2);
+        __m128 rowZ = _mm_set1_ps(zy * py + zc);
+        float* row = &depth[y * width];
+        for (int x = x0; x < x1; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(va0, px), rowE0);
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(va1, px), rowE1);
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(va2, px), rowE2);
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside) == 0) continue;
+            __m128 z = _mm_add_ps(_mm_mul_ps(vzx, px), rowZ);
+            __m128 old = _mm_loadu_ps(row + x);
+            __m128 closer = _mm_min_ps(old, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, old)));
+        }
+    }
+#else
+    for (int y = y0; y < y1; y++) {
+        float py = (float)y + 0.5f;
+        float* row = &depth[y * width];
+        for (int x = x0; x < x1; x++) {
+            float px = (float)x + 0.5f;
+            if (a0 * px + b0 * py + c0 < 0.f || a1 * px + b1 * py + c1 < 0.f || a2 * px + b2 * py + c2 < 0.f) continue;
+            row[x] = std::min(row[x], zx * px + zy * py + zc);
+        }
+    }
+#endif
+}
+
+bool OcclusionCulling::IsVisible(const glm::vec3& aabbMin, const glm::vec3& aabbMax) const {
+    float minX = (float)width, minY = (float)height, maxX = 0.f, maxY = 0.f;
+    float nearest = 1.f;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? aabbMax.x : aabbMin.x, (i & 2) ? aabbMax.y : aabbMin.y, (i & 4) ? aabbMax.z : aabbMin.z);
+        glm::vec4 clip = viewProjection * glm::vec4(corner, 1.f);
+        // crosses the near plane, no usable screen rectangle
+        if (clip.w <= NEAR_W || clip.z < -clip.w) return true;
+        float invW = 1.f / clip.w;
+        float sx = (clip.x * invW * 0.5f + 0.5f) * width;
+        float sy = (clip.y * invW * 0.5f + 0.5f) * height;
+        minX = std::min(minX, sx);
+        maxX = std::max(maxX, sx);
+        minY = std::min(minY, sy);
+        maxY = std::max(maxY, sy);
+        nearest = std::min(nearest, clip.z * invW * 0.5f + 0.5f);
+    }
+
+    int x0 = std::max((int)std::floor(minX), 0);
+    int x1 = std::min((int)std::ceil(maxX), width);
+    int y0 = std::max((int)std::floor(minY), 0);
+    int y1 = std::min((int)std::ceil(maxY), height);
+    if (x0 >= x1 || y0 >= y1) return true;
+
+    for (int ty = y0 / TileSize; ty <= (y1 - 1) / TileSize; ty++) {
+        for (int tx = x0 / TileSize; tx <= (x1 - 1) / TileSize; tx++) {
+            // whole tile is in front of the box
+            if (nearest > tileMax[ty * tilesX + tx]) continue;
+            // fall back to the pixels of the tile covered by the rectangle
+            int py0 = std::max(y0, ty * TileSize), py1 = std::min(y1, (ty + 1) * TileSize);
+            int px0 = std::max(x0, tx * TileSize), px1 = std::min(x1, (tx + 1) * TileSize);
+            for (int y = py0; y < py1; y++) {
+                const float* row = &depth[y * width];
+                for (int x = px0; x < px1; x++) {
+                    if (nearest <= row[x]) return true;
+                }
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,49 @@
+#ifndef DEFERRED_OCCLUSIONCULLING_H
+#define DEFERRED_OCCLUSIONCULLING_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+class JobSystem;
+
+// CPU occlusion culling.
+// large occluders are rasterized into a small depth buffer split into 8x8 tiles that each keep their farthest depth,
+// occludees are rejected when their nearest depth lies behind every covered tile (or pixel) of their screen rectangle.
+// depth is order independent (min per pixel) so the result does not depend on which worker drew which band.
+class OcclusionCulling {
+  public:
+    static const int TileSize = 8;
+
+    OcclusionCulling(int w, int h, JobSystem* jobs);
+    ~OcclusionCulling();
+
+    void Begin(const glm::mat4& viewProjection);
+    void AddOccluder(const glm::mat4& model, const glm::vec3* positions, unsigned int vertexCount);
+    void Rasterize();
+    bool IsVisible(const glm::vec3& aabbMin, const glm::vec3& aabbMax) const;
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    const float* GetDepth() const { return &depth[0]; }
+    unsigned int GetTriangleCount() const { return (unsigned int)triangles.size(); }
+
+  private:
+    struct ScreenTriangle {
+        glm::vec3 v[3];  // pixels x, y and depth in [0, 1]
+    };
+
+    void AddClipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+    void RasterizeBand(int band);
+    void RasterizeTriangle(const ScreenTriangle& tri, int minY, int maxY);
+
+  private:
+    int width, height, tilesX, tilesY;
+    int bandCount;
+    glm::mat4 viewProjection;
+    std::vector<float> depth;    // width * height, cleared to 1 (far)
+    std::vector<float> tileMax;  // farthest depth inside each tile
+    std::vector<ScreenTriangle> triangles;
+    JobSystem* jobs;  // bands are rasterized as parallel jobs
+};
+
+#endif  // DEFERRED_OCCLUSIONCULLING_H
@@ -0,0 +1,154 @@
+#include "OcclusionQuery.h"
+
+#include <GL/glew.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "ShaderCompiler.h"
+#include "util.h"
+
+// boxes grow a little so a slowly moving camera doesn't pop objects in one frame late
+static const float BOX_MARGIN = 0.05f;
+// the camera near plane would clip the box open, such objects are always drawn
+static const float EYE_MARGIN = 0.5f;
+static const unsigned long NEVER = ~0ul;
+
+OcclusionQuery::OcclusionQuery()
+    : shader(0), boxVAO(0), boxVBO(0), currentFrame(0), eyePosition(0.f), entries(), testedCount(0), skippedCount(0), resolvedCount(0), resolvedLatency(0) {}
+
+OcclusionQuery::~OcclusionQuery() {
+    for (Entry& entry : entries) {
+        for (Slot& slot : entry.slots) {
+            glDeleteQueries(1, &slot.query);
+        }
+    }
+    glDeleteVertexArrays(1, &boxVAO);
+    glDeleteBuffers(1, &boxVBO);
+    ShaderCompiler::Get().Release(&shader);
+    glDeleteProgram(shader);
+}
+
+bool OcclusionQuery::Init() {
+    ShaderCompiler::Get().Build(&shader, "../shaders/occlusion/box_vs.shader", "", "../shaders/occlusion/box_fs.shader");
+
+    // unit cube, stretched to the box in the vertex shader
+    float vertices[36 * 3];
+    const int faces[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+    const int order[6] = {0, 1, 2, 0, 2, 3};
+    int n = 0;
+    for (const auto& face : faces) {
+        for (int i : order) {
+            int corner = face[i];
+            vertices[n++] = (float)(corner & 1);
+            vertices[n++] = (float)((corner >> 1) & 1);
+            vertices[n++] = (float)((corner >> 2) & 1);
+        }
+    }
+    glGenVertexArrays(1, &boxVAO);
+    glGenBuffers(1, &boxVBO);
+    glBindVertexArray_profile(boxVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+    glBufferData_profile(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBindVertexArray_profile(0);
+    return true;
+}
+
+OcclusionQuery::Entry& OcclusionQuery::GetEntry(unsigned int object) {
+    while (entries.size() <= object) {
+        Entry entry;
+        for (Slot& slot : entry.slots) {
+            glGenQueries(1, &slot.query);
+            slot.frame = NEVER;
+            slot.pending = false;
+        }
+        entry.occluded = false;
+        entries.push_back(entry);
+    }
+    return entries[object];
+}
+
+void OcclusionQuery::BeginFrame(unsigned long frame) {
+    currentFrame = frame;
+    testedCount = 0;
+    skippedCount = 0;
+    resolvedCount = 0;
+    resolvedLatency = 0;
+
+    for (Entry& entry : entries) {
+        unsigned long latest = NEVER;
+        for (Slot& slot : entry.slots) {
+            if (!slot.pending) continue;
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(slot.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) continue;
+            GLuint samples = 0;
+            glGetQueryObjectuiv(slot.query, GL_QUERY_RESULT, &samples);
+            slot.pending = false;
+            resolvedCount++;
+            resolvedLatency += (int)(frame - slot.frame);
+            if (latest == NEVER || slot.frame > latest) {
+                latest = slot.frame;
+                entry.occluded = samples == 0;
+            }
+        }
+        // this frame's draw is conditional on last frame's query
+        const Slot& previous = entry.slots[(frame + RingSize - 1) % RingSize];
+        if (entry.occluded && frame > 0 && previous.frame == frame - 1) skippedCount++;
+    }
+}
+
+bool OcclusionQuery::BeginConditionalRender(unsigned int object) const {
+    if (object >= entries.size() || currentFrame == 0) return false;
+    const Slot& previous = entries[object].slots[(currentFrame + RingSize - 1) % RingSize];
+    if (previous.frame != currentFrame - 1) return false;
+    // no wait: if the result isn't there yet the gpu simply draws
+    glBeginConditionalRender(previous.query, GL_QUERY_NO_WAIT);
+    return true;
+}
+
+void OcclusionQuery::EndConditionalRender() const { glEndConditionalRender(); }
+
+void OcclusionQuery::BeginQueries(const glm::mat4& viewProjection, const glm::vec3& eye) {
+    eyePosition = eye;
+    glUseProgram_profile(shader);
+    glUniformMatrix4fv_profile(glGetUniformLocation(shader, "viewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+    glColorMask_profile(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask_profile(GL_FALSE);
+    glEnable_profile(GL_DEPTH_TEST);
+    glDisable_profile(GL_CULL_FACE);
+    glBindVertexArray_profile(boxVAO);
+}
+
+void OcclusionQuery::Query(unsigned int object, const glm::vec3& aabbMin, const glm::vec3& aabbMax) {
+    glm::vec3 margin = (aabbMax - aabbMin) * BOX_MARGIN;
+    glm::vec3 boxMin = aabbMin - margin;
+    glm::vec3 boxMax = aabbMax + margin;
+    const glm::vec3& e = eyePosition;
+    if (e.x > boxMin.x - EYE_MARGIN && e.y > boxMin.y - EYE_MARGIN && e.z > boxMin.z - EYE_MARGIN && e.x < boxMax.x + EYE_MARGIN && e.y < boxMax.y + EYE_MARGIN &&
+        e.z < boxMax.z + EYE_MARGIN)
+        return;
+
+    Slot& slot = GetEntry(object).slots[currentFrame % RingSize];
+    glUniform3fv_profile(glGetUniformLocation(shader, "boxMin"), 1, glm::value_ptr(boxMin));
+    glUniform3fv_profile(glGetUniformLocation(shader, "boxMax"), 1, glm::value_ptr(boxMax));
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, slot.query);
+    glDrawArrays_profile(GL_TRIANGLES, 0, 36);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+    slot.frame = currentFrame;
+    slot.pending = true;
+    testedCount++;
+}
+
+void OcclusionQuery::EndQueries() {
+    glColorMask_profile(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask_profile(GL_TRUE);
+    glBindVertexArray_profile(0);
+}
+
+int OcclusionQuery::GetTestedCount() const { return testedCount; }
+
+int OcclusionQuery::GetSkippedCount() const { return skippedCount; }
+
+float OcclusionQuery::GetAverageLatency() const { return resolvedCount > 0 ? (float)resolvedLatency / (float)resolvedCount : 0.f; }
@@ -0,0 +1,52 @@
+#ifndef DEFERRED_OCCLUSIONQUERY_H
+#define DEFERRED_OCCLUSIONQUERY_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// hardware occlusion queries for expensive objects.
+// every frame the bounding box of each object is tested against the depth buffer, the draw of the next frame is
+// wrapped in a conditional render on that query so the gpu skips it without the cpu ever waiting for the result.
+// results are only read back when already available, to report latency and how many objects were skipped.
+class OcclusionQuery {
+  public:
+    static const int RingSize = 3;  // frames a query may stay in flight before its slot is reused
+
+    OcclusionQuery();
+    ~OcclusionQuery();
+
+    bool Init();
+    void BeginFrame(unsigned long frame);
+    bool BeginConditionalRender(unsigned int object) const;
+    void EndConditionalRender() const;
+    void BeginQueries(const glm::mat4& viewProjection, const glm::vec3& eye);
+    void Query(unsigned int object, const glm::vec3& aabbMin, const glm::vec3& aabbMax);
+    void EndQueries();
+
+    int GetTestedCount() const;
+    int GetSkippedCount() const;
+    float GetAverageLatency() const;
+
+  private:
+    struct Slot {
+        unsigned int query;
+        unsigned long frame;
+        bool pending;
+    };
+    struct Entry {
+        Slot slots[RingSize];
+        bool occluded;  // latest result read back
+    };
+
+    Entry& GetEntry(unsigned int object);
+
+  private:
+    unsigned int shader, boxVAO, boxVBO;
+    unsigned long currentFrame;
+    glm::vec3 eyePosition;
+    std::vector<Entry> entries;
+    int testedCount, skippedCount;
+    int resolvedCount, resolvedLatency;
+};
+
+#endif  // DEFERRED_OCCLUSIONQUERY_H
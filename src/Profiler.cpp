@@ -0,0 +1,188 @@
+#include "Profiler.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "GlCapture.h"
+#include "GpuTimer.h"
+#include "RenderStats.h"
+
+static thread_local void* currentBuffer = nullptr;
+
+Profiler& Profiler::Get() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+    : enabled(true), frame(0), startTime(std::chrono::steady_clock::now()), buffersMutex(), buffers(), gpuBuffer(new ThreadBuffer()), gpuOffset(0), lastGpuFrame(0) {
+    gpuBuffer->events.resize(EventsPerThread);
+    gpuBuffer->written = 0;
+    gpuBuffer->name = "gpu";
+    gpuBuffer->nameIndex = -1;
+    gpuBuffer->id = 0;
+    gpuBuffer->depth = 0;
+    gpuBuffer->overflowDepth = 0;
+}
+
+Profiler::~Profiler() {
+    for (ThreadBuffer* buffer : buffers) delete buffer;
+    delete gpuBuffer;
+}
+
+double Profiler::Now() const { return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count(); }
+
+Profiler::ThreadBuffer* Profiler::GetThreadBuffer() {
+    if (currentBuffer) return static_cast<ThreadBuffer*>(currentBuffer);
+    // buffers live as long as the profiler so the export can still read threads that have exited
+    ThreadBuffer* buffer = new ThreadBuffer();
+    buffer->events.resize(EventsPerThread);
+    buffer->written = 0;
+    buffer->name = "thread";
+    buffer->nameIndex = -1;
+    buffer->depth = 0;
+    buffer->overflowDepth = 0;
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffer->id = (unsigned int)buffers.size() + 1;
+    buffers.push_back(buffer);
+    currentBuffer = buffer;
+    return buffer;
+}
+
+void Profiler::SetThreadName(const char* name, int index) {
+    ThreadBuffer* buffer = GetThreadBuffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->name = name;
+    buffer->nameIndex = index;
+}
+
+void Profiler::Begin(const char* name, int index) {
+    ThreadBuffer* buffer = GetThreadBuffer();
+    if (buffer->depth == MaxDepth) {
+        buffer->overflowDepth++;
+        return;
+    }
+    buffer->stack[buffer->depth++] = {name, index, IsEnabled() ? Now() : -1.0};
+}
+
+void Profiler::End() {
+    ThreadBuffer* buffer = GetThreadBuffer();
+    // zones past MaxDepth were never pushed, closing them must not close their parents
+    if (buffer->overflowDepth > 0) {
+        buffer->overflowDepth--;
+        return;
+    }
+    if (buffer->depth == 0) return;
+    const OpenZone& zone = buffer->stack[--buffer->depth];
+    if (zone.begin < 0.0 || !IsEnabled()) return;
+    Write(buffer, {zone.name, zone.index, buffer->depth, GetFrame(), zone.begin, Now()});
+}
+
+void Profiler::AddEvent(const char* name, int index, double begin, double end) {
+    if (!IsEnabled()) return;
+    ThreadBuffer* buffer = GetThreadBuffer();
+    Write(buffer, {name, index, buffer->depth, GetFrame(), begin, end});
+}
+
+void Profiler::Write(ThreadBuffer* buffer, const ProfileEvent& event) {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->events[buffer->written % EventsPerThread] = event;
+    buffer->written++;
+}
+
+void Profiler::CalibrateGpu(long long gpuTime) { gpuOffset = gpuTime - (long long)(Now() * 1000.0); }
+
+void Profiler::AddGpuResults(const GpuTimer& timer) {
+    if (!IsEnabled() || timer.GetResultFrame() == lastGpuFrame) return;
+    lastGpuFrame = timer.GetResultFrame();
+    // gpu frames arrive late, file them under the frame that issued them
+    unsigned long issued = GetFrame() > (unsigned long)timer.GetLatency() ? GetFrame() - timer.GetLatency() : 0;
+    double origin = (double)((long long)timer.GetResultOrigin() - gpuOffset) / 1000.0;
+    for (int i = 0; i < timer.GetResultCount(); i++) {
+        const GpuTimer::Result& result = timer.GetResult(i);
+        Write(gpuBuffer, {result.name, result.index, result.depth, issued, origin + result.begin * 1000.0, origin + result.end * 1000.0});
+    }
+}
+
+bool Profiler::ExportChromeTrace(const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cout << "trace export to " << path << " failed" << std::endl;
+        return false;
+    }
+    unsigned long current = GetFrame();
+    unsigned long first = current >= (unsigned long)FrameCount ? current - FrameCount + 1 : 0;
+
+    std::vector<ThreadBuffer*> all;
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        all = buffers;
+    }
+    all.push_back(gpuBuffer);
+
+    char line[256];
+    bool comma = false;
+    file << "{\"traceEvents\":[\n";
+    std::vector<ProfileEvent> events;
+    for (ThreadBuffer* buffer : all) {
+        events.clear();
+        const char* name;
+        int nameIndex;
+        {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            unsigned long count = std::min<unsigned long>(buffer->written, EventsPerThread);
+            for (unsigned long i = buffer->written - count; i < buffer->written; i++) {
+                const ProfileEvent& event = buffer->events[i % EventsPerThread];
+                if (event.frame >= first) events.push_back(event);
+            }
+            name = buffer->name;
+            nameIndex = buffer->nameIndex;
+        }
+        if (nameIndex >= 0) {
+            std::snprintf(line, sizeof(line), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %d\"}}", buffer->id, name, nameIndex);
+        } else {
+            std::snprintf(line, sizeof(line), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", buffer->id, name);
+        }
+        file << (comma ? ",\n" : "") << line;
+        comma = true;
+        for (const ProfileEvent& event : events) {
+            if (event.index >= 0) {
+                std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s %d\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%lu}}", event.name, event.index,
+                              buffer->id, event.begin, event.end - event.begin, event.frame);
+            } else {
+                std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%lu}}", event.name, buffer->id,
+                              event.begin, event.end - event.begin, event.frame);
+            }
+            file << line;
+        }
+    }
+    file << "\n]}\n";
+    std::cout << "trace of frames " << first << " to " << current << " written to " << path << std::endl;
+    return true;
+}
+
+ProfileGpuScope::ProfileGpuScope(GpuTimer* timer, const char* name, int index) : timer(timer), cpu(name, index) {
+    timer->Begin(name, index);
+    RenderStats::Get().BeginPass(name, index);
+    GlCapture::Get().BeginGroup(name, index);
+    if (GLEW_KHR_debug) {
+        char label[64];
+        if (index >= 0) {
+            std::snprintf(label, sizeof(label), "%s %d", name, index);
+        } else {
+            std::snprintf(label, sizeof(label), "%s", name);
+        }
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, label);
+    }
+}
+
+ProfileGpuScope::~ProfileGpuScope() {
+    if (GLEW_KHR_debug) glPopDebugGroup();
+    GlCapture::Get().EndGroup();
+    RenderStats::Get().EndPass();
+    timer->End();
+}
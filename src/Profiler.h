@@ -0,0 +1,111 @@
+#ifndef DEFERRED_PROFILER_H
+#define DEFERRED_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class GpuTimer;
+
+struct ProfileEvent {
+    const char* name;  // string literals only, they are kept until export
+    int index;         // -1 unless the zone is one of many, like a light
+    int depth;
+    unsigned long frame;
+    double begin, end;  // microseconds since the profiler started
+};
+
+// hierarchical cpu zones from any thread plus the gpu passes of GpuTimer, kept for the last FrameCount frames and
+// written out as chrome trace events (chrome://tracing or ui.perfetto.dev).
+// every thread writes its own ring under its own, practically uncontended lock, so zones are cheap enough to stay
+// compiled in: a disabled profiler costs one relaxed load per zone.
+class Profiler {
+  public:
+    static const int FrameCount = 240;
+    static const int EventsPerThread = 1 << 15;
+    static const int MaxDepth = 64;
+
+    static Profiler& Get();
+
+    void SetEnabled(bool e) { enabled.store(e, std::memory_order_relaxed); }
+    bool IsEnabled() const { return enabled.load(std::memory_order_relaxed); }
+    void BeginFrame() { frame.fetch_add(1, std::memory_order_relaxed); }
+    unsigned long GetFrame() const { return frame.load(std::memory_order_relaxed); }
+    double Now() const;
+
+    void SetThreadName(const char* name, int index = -1);
+    void Begin(const char* name, int index = -1);
+    void End();
+    // a zone that already finished on this thread, for timings measured elsewhere
+    void AddEvent(const char* name, int index, double begin, double end);
+
+    // pairs a gpu timestamp in ns, read with glGetInteger64v(GL_TIMESTAMP), with the cpu clock
+    void CalibrateGpu(long long gpuTime);
+    void AddGpuResults(const GpuTimer& timer);
+
+    bool ExportChromeTrace(const std::string& path);
+
+  private:
+    struct OpenZone {
+        const char* name;
+        int index;
+        double begin;  // negative while the profiler was disabled
+    };
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::vector<ProfileEvent> events;
+        unsigned long written;
+        const char* name;
+        int nameIndex;
+        unsigned int id;
+        OpenZone stack[MaxDepth];
+        int depth;
+        int overflowDepth;  // zones opened past MaxDepth
+    };
+
+    Profiler();
+    ~Profiler();
+    ThreadBuffer* GetThreadBuffer();
+    void Write(ThreadBuffer* buffer, const ProfileEvent& event);
+
+  private:
+    std::atomic<bool> enabled;
+    std::atomic<unsigned long> frame;
+    std::chrono::steady_clock::time_point startTime;
+    std::mutex buffersMutex;
+    std::vector<ThreadBuffer*> buffers;
+    ThreadBuffer* gpuBuffer;
+    long long gpuOffset;  // gpu ns minus profiler ns
+    unsigned long lastGpuFrame;
+};
+
+class ProfileScope {
+  public:
+    explicit ProfileScope(const char* name, int index = -1) { Profiler::Get().Begin(name, index); }
+    ~ProfileScope() { Profiler::Get().End(); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+// cpu zone, gpu timestamps, a debug group for frame debuggers and a RenderStats pass, all under one name.
+// render thread only
+class ProfileGpuScope {
+  public:
+    ProfileGpuScope(GpuTimer* timer, const char* name, int index = -1);
+    ~ProfileGpuScope();
+    ProfileGpuScope(const ProfileGpuScope&) = delete;
+    ProfileGpuScope& operator=(const ProfileGpuScope&) = delete;
+
+  private:
+    GpuTimer* timer;
+    ProfileScope cpu;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(...) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(__VA_ARGS__)
+#define PROFILE_GPU_SCOPE(timer, ...) ProfileGpuScope PROFILE_CONCAT(profileGpuScope, __LINE__)(timer, __VA_ARGS__)
+
+#endif  // DEFERRED_PROFILER_H
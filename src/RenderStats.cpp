@@ -0,0 +1,209 @@
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "GpuTimer.h"
+#include "util.h"
+
+// the median needs some history before a frame can count as a spike
+static const int SPIKE_MIN_SAMPLES = 60;
+static const float SPIKE_FACTOR = 2.f;
+
+RenderCounters RenderCounters::Capture() {
+    return {drawCallCount, vertexCount, triangleCount, stateChangeCount, textureBindCount, uniformUploadCount, bufferUploadBytes};
+}
+
+RenderCounters& RenderCounters::operator+=(const RenderCounters& o) {
+    drawCalls += o.drawCalls;
+    vertices += o.vertices;
+    triangles += o.triangles;
+    stateChanges += o.stateChanges;
+    textureBinds += o.textureBinds;
+    uniformUploads += o.uniformUploads;
+    bufferBytes += o.bufferBytes;
+    return *this;
+}
+
+RenderCounters RenderCounters::operator-(const RenderCounters& o) const {
+    return {drawCalls - o.drawCalls,       vertices - o.vertices,         triangles - o.triangles,  stateChanges - o.stateChanges,
+            textureBinds - o.textureBinds, uniformUploads - o.uniformUploads, bufferBytes - o.bufferBytes};
+}
+
+StatWindow::StatWindow() : values(), count(0), next(0) {}
+
+void StatWindow::Add(float value) {
+    values[next] = value;
+    next = (next + 1) % WindowSize;
+    count = std::min(count + 1, WindowSize);
+}
+
+float StatWindow::Percentile(float p) const {
+    if (count == 0) return 0.f;
+    float sorted[WindowSize];
+    std::copy(values, values + count, sorted);
+    int k = std::min(count - 1, (int)(p * count));
+    std::nth_element(sorted, sorted + k, sorted + count);
+    return sorted[k];
+}
+
+float StatWindow::Mean() const {
+    if (count == 0) return 0.f;
+    float sum = 0.f;
+    for (int i = 0; i < count; i++) sum += values[i];
+    return sum / count;
+}
+
+float StatWindow::Last() const { return count > 0 ? values[(next + WindowSize - 1) % WindowSize] : 0.f; }
+
+RenderStats& RenderStats::Get() {
+    static RenderStats stats;
+    return stats;
+}
+
+RenderStats::RenderStats()
+    : passes(), stack(), depth(0), overflowDepth(0), frameTime(), frameGpu(), lastFrameEnd(std::chrono::steady_clock::now()), frameCount(0), lastGpuFrame(0), spikeCount(0), worstFrame(0.f) {}
+
+void RenderStats::BeginFrame() {
+    depth = 0;
+    overflowDepth = 0;
+}
+
+void RenderStats::EndFrame() {
+    auto now = std::chrono::steady_clock::now();
+    float ms = std::chrono::duration<float, std::milli>(now - lastFrameEnd).count();
+    lastFrameEnd = now;
+    if (frameCount++ == 0) return;  // the first interval includes loading
+
+    if (frameTime.GetCount() >= SPIKE_MIN_SAMPLES && ms > SPIKE_FACTOR * frameTime.Percentile(0.5f)) spikeCount++;
+    worstFrame = std::max(worstFrame, ms);
+    frameTime.Add(ms);
+}
+
+void RenderStats::BeginPass(const char* name, int index) {
+    if (depth == MaxDepth) {
+        overflowDepth++;
+        return;
+    }
+    stack[depth++] = {FindPass(name, index), RenderCounters::Capture(), std::chrono::steady_clock::now()};
+}
+
+void RenderStats::EndPass() {
+    // passes too deep to track close before their parents
+    if (overflowDepth > 0) {
+        overflowDepth--;
+        return;
+    }
+    if (depth == 0) return;
+    const OpenPass& open = stack[--depth];
+    Pass& pass = passes[open.pass];
+    pass.last = RenderCounters::Capture() - open.begin;
+    pass.total += pass.last;
+    pass.frames++;
+    pass.cpu.Add(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - open.beginTime).count());
+}
+
+void RenderStats::AddGpuResults(const GpuTimer& timer) {
+    if (timer.GetResultCount() == 0 || timer.GetResultFrame() == lastGpuFrame) return;
+    lastGpuFrame = timer.GetResultFrame();
+    frameGpu.Add((float)timer.GetFrameTime());
+    for (int i = 0; i < timer.GetResultCount(); i++) {
+        const GpuTimer::Result& result = timer.GetResult(i);
+        passes[FindPass(result.name, result.index)].gpu.Add((float)(result.end - result.begin));
+    }
+}
+
+int RenderStats::FindPass(const char* name, int index) {
+    for (int i = 0; i < (int)passes.size(); i++) {
+        if (passes[i].index == index && (passes[i].name == name || std::strcmp(passes[i].name, name) == 0)) return i;
+    }
+    Pass pass = {};
+    pass.name = name;
+    pass.index = index;
+    passes.push_back(pass);
+    return (int)passes.size() - 1;
+}
+
+bool RenderStats::Write(const std::string& path) const {
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if (!(json ? WriteJson(path) : WriteCsv(path))) {
+        std::cout << "stats export to " << path << " failed" << std::endl;
+        return false;
+    }
+    std::cout << "stats of " << frameCount << " frames written to " << path << std::endl;
+    return true;
+}
+
+void RenderStats::PrintSummary() const {
+    std::ios format(nullptr);
+    format.copyfmt(std::cout);
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "frame ms: mean " << frameTime.Mean() << " p50 " << frameTime.Percentile(0.5f) << " p95 " << frameTime.Percentile(0.95f) << " p99 "
+              << frameTime.Percentile(0.99f) << ", worst " << worstFrame << ", spikes " << spikeCount << std::endl;
+    std::cout << "frame gpu ms: mean " << frameGpu.Mean() << " p50 " << frameGpu.Percentile(0.5f) << " p95 " << frameGpu.Percentile(0.95f) << " p99 "
+              << frameGpu.Percentile(0.99f) << std::endl;
+    std::cout << std::left << std::setw(16) << "pass" << std::right;
+    for (const char* column : {"cpu p50", "cpu p95", "cpu p99", "gpu p50", "gpu p95", "gpu p99", "draws"}) std::cout << ' ' << std::setw(9) << column;
+    std::cout << std::endl;
+    for (const Pass& pass : passes) {
+        std::string name = pass.name;
+        if (pass.index >= 0) name += " " + std::to_string(pass.index);
+        std::cout << std::left << std::setw(16) << name << std::right;
+        for (float ms : {pass.cpu.Percentile(0.5f), pass.cpu.Percentile(0.95f), pass.cpu.Percentile(0.99f), pass.gpu.Percentile(0.5f), pass.gpu.Percentile(0.95f),
+                         pass.gpu.Percentile(0.99f)}) {
+            std::cout << ' ' << std::setw(9) << ms;
+        }
+        std::cout << ' ' << std::setw(9) << std::setprecision(1) << (pass.frames > 0 ? (double)pass.total.drawCalls / pass.frames : 0.0) << std::setprecision(3) << std::endl;
+    }
+    std::cout.copyfmt(format);
+}
+
+bool RenderStats::WriteCsv(const std::string& path) const {
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) return false;
+    fprintf(fp, "pass,frames,draws,vertices,triangles,state_changes,texture_binds,uniform_uploads,buffer_bytes,cpu_p50,cpu_p95,cpu_p99,gpu_p50,gpu_p95,gpu_p99\n");
+    fprintf(fp, "frame,%lu,,,,,,,,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", frameCount, frameTime.Percentile(0.5f), frameTime.Percentile(0.95f), frameTime.Percentile(0.99f),
+            frameGpu.Percentile(0.5f), frameGpu.Percentile(0.95f), frameGpu.Percentile(0.99f));
+    for (const Pass& pass : passes) {
+        double n = pass.frames > 0 ? (double)pass.frames : 1.0;
+        char name[64];
+        if (pass.index >= 0) {
+            snprintf(name, sizeof(name), "%s %d", pass.name, pass.index);
+        } else {
+            snprintf(name, sizeof(name), "%s", pass.name);
+        }
+        fprintf(fp, "%s,%lu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", name, pass.frames, pass.total.drawCalls / n, pass.total.vertices / n,
+                pass.total.triangles / n, pass.total.stateChanges / n, pass.total.textureBinds / n, pass.total.uniformUploads / n, pass.total.bufferBytes / n,
+                pass.cpu.Percentile(0.5f), pass.cpu.Percentile(0.95f), pass.cpu.Percentile(0.99f), pass.gpu.Percentile(0.5f), pass.gpu.Percentile(0.95f), pass.gpu.Percentile(0.99f));
+    }
+    fclose(fp);
+    return true;
+}
+
+bool RenderStats::WriteJson(const std::string& path) const {
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) return false;
+    fprintf(fp, "{\n  \"frames\": %lu,\n  \"spikes\": %d,\n  \"worst_frame_ms\": %.4f,\n", frameCount, spikeCount, worstFrame);
+    fprintf(fp, "  \"frame_ms\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"mean\": %.4f},\n", frameTime.Percentile(0.5f), frameTime.Percentile(0.95f), frameTime.Percentile(0.99f),
+            frameTime.Mean());
+    fprintf(fp, "  \"frame_gpu_ms\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"mean\": %.4f},\n", frameGpu.Percentile(0.5f), frameGpu.Percentile(0.95f), frameGpu.Percentile(0.99f),
+            frameGpu.Mean());
+    fprintf(fp, "  \"passes\": [\n");
+    for (int i = 0; i < (int)passes.size(); i++) {
+        const Pass& pass = passes[i];
+        double n = pass.frames > 0 ? (double)pass.frames : 1.0;
+        fprintf(fp, "    {\"name\": \"%s\", \"index\": %d, \"frames\": %lu, ", pass.name, pass.index, pass.frames);
+        fprintf(fp, "\"draws\": %.1f, \"vertices\": %.1f, \"triangles\": %.1f, \"state_changes\": %.1f, \"texture_binds\": %.1f, \"uniform_uploads\": %.1f, \"buffer_bytes\": %.1f, ",
+                pass.total.drawCalls / n, pass.total.vertices / n, pass.total.triangles / n, pass.total.stateChanges / n, pass.total.textureBinds / n, pass.total.uniformUploads / n,
+                pass.total.bufferBytes / n);
+        fprintf(fp, "\"cpu_ms\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f}, \"gpu_ms\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f}}%s\n", pass.cpu.Percentile(0.5f),
+                pass.cpu.Percentile(0.95f), pass.cpu.Percentile(0.99f), pass.gpu.Percentile(0.5f), pass.gpu.Percentile(0.95f), pass.gpu.Percentile(0.99f),
+                i + 1 < (int)passes.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    fclose(fp);
+    return true;
+}
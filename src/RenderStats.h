@@ -0,0 +1,97 @@
+#ifndef DEFERRED_RENDERSTATS_H
+#define DEFERRED_RENDERSTATS_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+class GpuTimer;
+
+// snapshot of the global counters bumped by the *_profile gl wrappers in util.h
+struct RenderCounters {
+    int drawCalls, vertices, triangles, stateChanges, textureBinds, uniformUploads;
+    long long bufferBytes;
+
+    static RenderCounters Capture();
+    RenderCounters& operator+=(const RenderCounters& o);
+    RenderCounters operator-(const RenderCounters& o) const;
+};
+
+// the last WindowSize samples of a timing in ms
+class StatWindow {
+  public:
+    static constexpr int WindowSize = 600;
+
+    StatWindow();
+    void Add(float value);
+    float Percentile(float p) const;  // p in 0..1
+    float Mean() const;
+    float Last() const;
+    int GetCount() const { return count; }
+
+  private:
+    float values[WindowSize];
+    int count, next;
+};
+
+// per pass counters and cpu/gpu times. a pass is whatever ProfileGpuScope opens, so every light gets its own.
+// frame times, from one EndFrame to the next, keep rolling p50/p95/p99 and count spikes, frames that take twice the
+// median.
+class RenderStats {
+  public:
+    static const int MaxDepth = 16;
+
+    struct Pass {
+        const char* name;
+        int index;
+        RenderCounters last;   // the newest frame that ran the pass
+        RenderCounters total;  // since start, divided by frames for averages
+        unsigned long frames;
+        StatWindow cpu, gpu;
+    };
+
+    static RenderStats& Get();
+
+    void BeginFrame();
+    void EndFrame();
+    void BeginPass(const char* name, int index = -1);
+    void EndPass();
+    void AddGpuResults(const GpuTimer& timer);
+
+    int GetPassCount() const { return (int)passes.size(); }
+    const Pass& GetPass(int i) const { return passes[i]; }
+    const StatWindow& GetFrameTime() const { return frameTime; }
+    const StatWindow& GetFrameGpu() const { return frameGpu; }
+    int GetSpikeCount() const { return spikeCount; }
+    float GetWorstFrame() const { return worstFrame; }
+    unsigned long GetFrameCount() const { return frameCount; }
+
+    // csv or json, picked by the extension
+    bool Write(const std::string& path) const;
+    // frame and per pass times as a table on stdout
+    void PrintSummary() const;
+
+  private:
+    struct OpenPass {
+        int pass;
+        RenderCounters begin;
+        std::chrono::steady_clock::time_point beginTime;
+    };
+
+    RenderStats();
+    int FindPass(const char* name, int index);
+    bool WriteCsv(const std::string& path) const;
+    bool WriteJson(const std::string& path) const;
+
+  private:
+    std::vector<Pass> passes;
+    OpenPass stack[MaxDepth];
+    int depth, overflowDepth;
+    StatWindow frameTime, frameGpu;  // frame time is wall time, swap and vsync waits included
+    std::chrono::steady_clock::time_point lastFrameEnd;
+    unsigned long frameCount, lastGpuFrame;
+    int spikeCount;
+    float worstFrame;
+};
+
+#endif  // DEFERRED_RENDERSTATS_H
@@ -2,8 +2,17 @@
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#ifdef DEFERRED_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 #include <glm/gtc/type_ptr.hpp>
+#include <iomanip>
+#include <random>
 #include <vector>
 
 #include "components/Camera.h"
@@ -11,9 +20,73 @@
 #include "components/Material.h"
 #include "components/Time.h"
 #include "components/Transform.h"
+#include "CameraPath.h"
+#include "CommandBuffer.h"
+#include "GlCapture.h"
+#include "GlReplay.h"
+#include "GpuTimer.h"
+#include "JobSystem.h"
+#include "OcclusionCulling.h"
+#include "OcclusionQuery.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "ShaderCache.h"
+#include "ShaderCompiler.h"
+#include "ShaderPermutations.h"
+#include "Simulation.h"
+#include "StressScene.h"
+#include "TextureLoader.h"
 #include "obj_parser.h"
 #include "util.h"
 
+// below this many objects a linear SIMD sweep beats walking the tree
+static const unsigned int BVH_CULLING_THRESHOLD = 64;
+// software occlusion buffer, coarse on purpose
+static const int OCCLUSION_WIDTH = 256;
+static const int OCCLUSION_HEIGHT = 128;
+// meshes this heavy are drawn behind a hardware occlusion query, a box is cheaper than a false draw
+static const int OCCLUSION_QUERY_MIN_VERTICES = 3000;
+// simulated frame rate of benchmark runs, independent of how fast frames actually render
+static const float BENCHMARK_FRAME_RATE = 60.f;
+// generated objects are scattered over this half extent of the floor, lights orbit inside it
+static const float STRESS_SCENE_EXTENT = 20.f;
+// program binaries of the last run, next to the executable like the trace
+static const char* SHADER_CACHE_PATH = "shader_cache.bin";
+
+// lit shader variant key: bits 0-3 light count, bit 4 normal map, then the ShadowSampling of every light in 2 bits,
+// then whether the diffuse texture is a layer of a MaterialTable array
+static const uint32_t LIT_NORMAL_MAP = 1u << 4;
+static const int LIT_SHADOW_SHIFT = 5;
+static const uint32_t LIT_MATERIAL_ARRAY = 1u << (LIT_SHADOW_SHIFT + 2 * RenderingEngine::MaxPointLights);
+// the material dependent part of the key, one lit program per entry draws the materials litVariant picks it for
+static const int LIT_VARIANTS = 3;
+static const uint32_t LIT_VARIANT_BITS[LIT_VARIANTS] = {0, LIT_NORMAL_MAP, LIT_MATERIAL_ARRAY};
+
+static int litVariant(const Material *material) {
+    if (material->GetDiffuseArray()) return 2;
+    return material->GetUseNormal() ? 1 : 0;
+}
+
+static uint32_t litShaderKey(const std::vector<PointLight *> &lights, const ShadowFilterMode *filterMode) {
+    uint32_t key = (uint32_t)lights.size();
+    for (size_t i = 0; i < lights.size(); i++) {
+        ShadowSampling sampling = lights[i]->GetShadowSampling(filterMode ? *filterMode : lights[i]->GetShadowFilterMode());
+        key |= (uint32_t)sampling << (LIT_SHADOW_SHIFT + 2 * i);
+    }
+    return key;
+}
+
+static std::string litShaderDefines(uint32_t key) {
+    int count = (int)(key & 15u);
+    std::string shadows;
+    for (int i = 0; i < count; i++) {
+        if (i > 0) shadows += ", ";
+        shadows += std::to_string((key >> (LIT_SHADOW_SHIFT + 2 * i)) & 3u);
+    }
+    return "#define NR_POINT_LIGHTS " + std::to_string(count) + "\n#define POINT_LIGHT_SHADOWS " + shadows + "\n#define USE_NORMAL_MAP " + ((key & LIT_NORMAL_MAP) ? "1" : "0") +
+           "\n#define MATERIAL_ARRAY " + ((key & LIT_MATERIAL_ARRAY) ? "1" : "0") + "\n#define MAX_MATERIALS " + std::to_string(MaterialTable::MaxMaterials) + "\n";
+}
+
 static void callbackResize(GLFWwindow *win, int cx, int cy) {
     auto *ptr = static_cast<RenderingEngine *>(glfwGetWindowUserPointer(win));
     if (ptr != nullptr) {
@@ -23,60 +96,161 @@ static void callbackResize(GLFWwindow *win, int cx, int cy) {
 
 RenderingEngine *RenderingEngine::instance = nullptr;
 
-RenderingEngine::RenderingEngine()
+RenderingEngine::RenderingEngine(unsigned int workers, float simulationRate)
     : mWindow(nullptr),
+      compileWindow(nullptr),
       mMonitor(nullptr),
+      eglDisplay(nullptr),
+      eglContext(nullptr),
+      eglCompileContext(nullptr),
+      offscreenFBO(0),
+      offscreenColor(0),
+      offscreenDepth(0),
       MouseSensitivity(0.2f),
       lastMouseX(0.f),
       lastMouseY(0.f),
+      mouseLook(0.f),
       normal_shader(0),
       depth_cubemap_shader(0),
-      shadow_cubemap_shader(0),
+      depth_moment_shader(0),
+      moment_blur_shader(0),
+      cascade_depth_shader(0),
+      depth_visual_shader(0),
+      litShaders(nullptr),
       cubeVAO(0),
       cubeVBO(0),
       planeVAO(0),
       planeVBO(0),
       dragonVAO(0),
       dragonVBO(0),
+      quadVAO(0),
+      quadVBO(0),
       width(0),
       height(0),
-      gpuTimeProfileQuery(0),
-      timeElapsed(0),
       hdrKeyPressed(false),
       useNormalKeyPressed(false),
+      shadowFilterKeyPressed(false),
+      cascadeDebugKeyPressed(false),
+      cascadeSkipKeyPressed(false),
+      pickButtonPressed(false),
+      occlusionKeyPressed(false),
+      occlusionQueryKeyPressed(false),
+      traceKeyPressed(false),
+      frameIndex(0),
+      cascadeDebugLayer(-1),
+      cascadeUpdates(0),
+      cascadeDrawCalls(0),
       fontRenderer(new FontRenderer()),
       camera(new Camera(glm::vec3(0.0f, 2.3f, 8.0f))),
       time(new Time()),
       cameraTrans(nullptr),
       cube1_material(nullptr),
       cube2_material(nullptr),
+      stressScene({0, 0, 0, 0.f, 0, 0}),
+      stressMaterials(),
+      stressVAOs(),
+      stressVBOs(),
       lights(),
+      sun(nullptr),
+      registry(),
+      transformStore(),
+      renderObjects(),
+      allObjects(),
+      visibleObjects(),
+      materialTable(),
+      materialDemand(),
+      cascadeCommands(),
+      lightCommands(),
+      cameraCommands(),
+      queryCommands(),
+      objectBounds(),
+      sceneBvh(),
+      jobSystem(new JobSystem(workers)),
+      simulation(new Simulation(simulationRate)),
+      simulationCamera(new Transform()),
+      simulationTime(0.f),
+      appliedTick(0),
+      cameraPath(),
+      occlusionCulling(new OcclusionCulling(OCCLUSION_WIDTH, OCCLUSION_HEIGHT, jobSystem)),
+      occlusionQuery(nullptr),
+      gpuTimer(nullptr),
+      tracePath("trace.json"),
+      exportTraceOnExit(false),
+      statsPath(),
+      capturePath(),
+      captureFrames(0),
+      useOcclusionQueries(true),
+      queryObjects(),
+      cubeOccluder(),
+      planeOccluder(),
+      visibleCount(0),
+      culledCount(0),
+      occludedCount(0),
+      lightCasterCount(0),
+      pickedObject(-1),
+      pickedDistance(0.f),
       isInvalidate(true) {
     instance = this;
     lights.clear();
+    for (int &casters : cascadeCasters) casters = 0;
+    for (bool &active : cascadeActive) active = false;
 }
 
 RenderingEngine::~RenderingEngine() {
+    ShaderCompiler::Get().Shutdown();
+    TextureLoader::Get().Shutdown();
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteBuffers(1, &cubeVBO);
     glDeleteVertexArrays(1, &planeVAO);
     glDeleteBuffers(1, &planeVBO);
     glDeleteVertexArrays(1, &dragonVAO);
     glDeleteBuffers(1, &dragonVBO);
+    glDeleteVertexArrays(1, &quadVAO);
+    glDeleteBuffers(1, &quadVBO);
+    if (!stressVAOs.empty()) {
+        glDeleteVertexArrays((GLsizei)stressVAOs.size(), stressVAOs.data());
+        glDeleteBuffers((GLsizei)stressVBOs.size(), stressVBOs.data());
+    }
 
     glDeleteProgram(normal_shader);
     glDeleteProgram(depth_cubemap_shader);
-    glDeleteProgram(shadow_cubemap_shader);
-    glDeleteQueries(1, &gpuTimeProfileQuery);
+    glDeleteProgram(depth_moment_shader);
+    glDeleteProgram(moment_blur_shader);
+    glDeleteProgram(cascade_depth_shader);
+    glDeleteProgram(depth_visual_shader);
+    materialTable.Release();
 
+    SAFE_DEALLOC(litShaders);
+    SAFE_DEALLOC(simulation);
+    SAFE_DEALLOC(simulationCamera);
     SAFE_DEALLOC(fontRenderer);
     SAFE_DEALLOC(camera);
     SAFE_DEALLOC(time);
     SAFE_DEALLOC(cube1_material);
     SAFE_DEALLOC(cube2_material);
+    for (auto material : stressMaterials) {
+        SAFE_DEALLOC(material);
+    }
     for (auto pl : lights) {
         SAFE_DEALLOC(pl);
     }
+    SAFE_DEALLOC(sun);
+    SAFE_DEALLOC(occlusionCulling);
+    SAFE_DEALLOC(occlusionQuery);
+    SAFE_DEALLOC(gpuTimer);
+    SAFE_DEALLOC(jobSystem);
+
+    glDeleteFramebuffers(1, &offscreenFBO);
+    glDeleteRenderbuffers(1, &offscreenColor);
+    glDeleteRenderbuffers(1, &offscreenDepth);
+#ifdef DEFERRED_HEADLESS
+    if (eglDisplay) {
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (eglCompileContext) eglDestroyContext(eglDisplay, eglCompileContext);
+        eglDestroyContext(eglDisplay, eglContext);
+        eglTerminate(eglDisplay);
+    }
+#endif
 }
 
 bool RenderingEngine::initWindow(const std::string &title, int w, int h) {
@@ -114,10 +288,111 @@ bool RenderingEngine::initWindow(const std::string &title, int w, int h) {
         std::cout << "glew init error" << std::endl;
         return false;
     }
+    if (!capturePath.empty() && !GlCapture::Get().Start(capturePath, captureFrames, width, height)) return false;
+    // a hidden window only for its context, unless the driver compiles on threads of its own
+    if (ShaderCompiler::NeedsWorkerContext()) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        compileWindow = glfwCreateWindow(1, 1, "shader compile", nullptr, mWindow);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    }
+    ShaderCompiler::WorkerContextFn workerContext;
+    if (compileWindow) {
+        GLFWwindow *shared = compileWindow;
+        workerContext = [shared](bool current) {
+            glfwMakeContextCurrent(current ? shared : nullptr);
+            return true;
+        };
+    }
+    ShaderCompiler::Get().Init(workerContext);
 
     lastMouseX = (float)w / 2.f;
     lastMouseY = (float)h / 2.f;
 
+    return initResources();
+}
+
+#ifdef DEFERRED_HEADLESS
+bool RenderingEngine::initHeadless(int w, int h) {
+    // no window system at all: a surfaceless egl context (mesa llvmpipe works) drawing into an offscreen framebuffer
+    EGLDisplay display = EGL_NO_DISPLAY;
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        std::cout << "egl init error" << std::endl;
+        return false;
+    }
+    const EGLint configAttribs[] = {EGL_SURFACE_TYPE, 0, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0 || !eglBindAPI(EGL_OPENGL_API)) {
+        std::cout << "egl config error" << std::endl;
+        return false;
+    }
+    const EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3, EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cout << "egl context error" << std::endl;
+        return false;
+    }
+    eglDisplay = display;
+    eglContext = context;
+    this->width = w;
+    this->height = h;
+
+    glewExperimental = GL_TRUE;
+    GLenum glewError = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // glew built for glx complains about the missing x display but has loaded every entry point already
+    if (glewError == GLEW_ERROR_NO_GLX_DISPLAY) glewError = GLEW_OK;
+#endif
+    if (glewError != GLEW_OK) {
+        std::cout << "glew init error" << std::endl;
+        return false;
+    }
+    glGetError();
+    if (!capturePath.empty() && !GlCapture::Get().Start(capturePath, captureFrames, width, height)) return false;
+    // a second context for the shader compile worker, unless the driver compiles on threads of its own
+    ShaderCompiler::WorkerContextFn workerContext;
+    if (ShaderCompiler::NeedsWorkerContext()) {
+        EGLContext shared = eglCreateContext(display, config, context, contextAttribs);
+        if (shared != EGL_NO_CONTEXT) {
+            eglCompileContext = shared;
+            workerContext = [display, shared](bool current) {
+                // the bound api is per thread
+                eglBindAPI(EGL_OPENGL_API);
+                return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, current ? shared : EGL_NO_CONTEXT) == EGL_TRUE;
+            };
+        }
+    }
+    ShaderCompiler::Get().Init(workerContext);
+
+    glGenFramebuffers(1, &offscreenFBO);
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, offscreenFBO);
+    glGenRenderbuffers(1, &offscreenColor);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreenColor);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColor);
+    glGenRenderbuffers(1, &offscreenDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreenDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, offscreenDepth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "offscreen framebuffer incomplete" << std::endl;
+        return false;
+    }
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, 0);
+
+    if (!initResources()) return false;
+    camera->SetTargetFramebuffer(offscreenFBO);
+    return true;
+}
+#endif
+
+bool RenderingEngine::initResources() {
+    ShaderCache::Get().Open(SHADER_CACHE_PATH);
+    // materials get placeholders and their images stream in over the first frames
+    TextureLoader::Get().Init();
     if (!fontRenderer->Init("../res/arial.ttf")) {
         std::cout << "fontRenderer Init failed" << std::endl;
         return false;
@@ -135,26 +410,74 @@ bool RenderingEngine::initWindow(const std::string &title, int w, int h) {
     if (!cube2_material->InitDiffuse("../res/stone/stone_diffuse_map.png")) return false;
     if (!cube2_material->InitNormal("../res/stone/stone_normal_map.png")) return false;
 
-    PointLight *light1 = new PointLight(glm::vec3(3.17f, 2.34f, -4.184f), glm::vec3(1.f, 1.f, 1.f));
-    if (!light1->Init()) {
-        std::cout << "light1 Init failed" << std::endl;
-        return false;
+    if (stressScene.objects > 0) {
+        std::vector<unsigned char> texels;
+        for (int i = 0; i < stressScene.materials; i++) {
+            stress_scene::generateTexture(i, texels);
+            Material *material = new Material(32.f + 16.f * (i % 7));
+            stressMaterials.push_back(material);
+            // all the same size, they end up as layers of one array and draw without texture binds in between
+            if (!materialTable.AddLayer(material, texels.data(), stress_scene::TEXTURE_SIZE, stress_scene::TEXTURE_SIZE) &&
+                !material->InitDiffuse(texels.data(), stress_scene::TEXTURE_SIZE, stress_scene::TEXTURE_SIZE)) {
+                std::cout << "stress material Init failed" << std::endl;
+                return false;
+            }
+        }
+        materialTable.Upload();
+        // the first lights get the shadows, orbits are spread from the center to the edge
+        int shadowed = (int)std::lround(stressScene.lights * stressScene.shadowedFraction);
+        for (int i = 0; i < stressScene.lights; i++) {
+            PointLight *light = new PointLight(glm::vec3(0.f, 3.f, 0.f), glm::vec3(1.f, 1.f, 1.f));
+            lights.emplace_back(light);
+            if (!light->Init()) {
+                std::cout << "stress light Init failed" << std::endl;
+                return false;
+            }
+            light->SetCastShadow(i < shadowed);
+            float orbitRadius = 2.f + (STRESS_SCENE_EXTENT - 2.f) * (i + 0.5f) / stressScene.lights;
+            registry.Add<PointLightComponent>(registry.Create(), light, 0.2f + 0.15f * i, orbitRadius);
+        }
+    } else {
+        PointLight *light1 = new PointLight(glm::vec3(3.17f, 2.34f, -4.184f), glm::vec3(1.f, 1.f, 1.f));
+        if (!light1->Init()) {
+            std::cout << "light1 Init failed" << std::endl;
+            return false;
+        }
+        PointLight *light2 = new PointLight(glm::vec3(2.3f, 2.f, -4.0f), glm::vec3(1.f, 1.f, 1.f));
+        if (!light2->Init()) {
+            std::cout << "light2 Init failed" << std::endl;
+            return false;
+        }
+        PointLight *light3 = new PointLight(glm::vec3(2.3f, 2.f, -8.0f), glm::vec3(1.f, 1.f, 1.f));
+        if (!light3->Init()) {
+            std::cout << "light3 Init failed" << std::endl;
+            return false;
+        }
+        lights.emplace_back(light1);
+        lights.emplace_back(light2);
+        lights.emplace_back(light3);
+        for (unsigned int i = 0; i < lights.size(); i++) {
+            registry.Add<PointLightComponent>(registry.Create(), lights[i], 0.5f * (i + 1), 5.f);
+        }
     }
-    PointLight *light2 = new PointLight(glm::vec3(2.3f, 2.f, -4.0f), glm::vec3(1.f, 1.f, 1.f));
-    if (!light2->Init()) {
-        std::cout << "light2 Init failed" << std::endl;
+
+    sun = new DirectionalLight(glm::vec3(-0.4f, -1.f, -0.3f), glm::vec3(1.f, 0.95f, 0.85f));
+    if (!sun->Init()) {
+        std::cout << "sun Init failed" << std::endl;
         return false;
     }
-    PointLight *light3 = new PointLight(glm::vec3(2.3f, 2.f, -8.0f), glm::vec3(1.f, 1.f, 1.f));
-    if (!light3->Init()) {
-        std::cout << "light3 Init failed" << std::endl;
+
+    occlusionQuery = new OcclusionQuery();
+    if (!occlusionQuery->Init()) {
+        std::cout << "occlusionQuery Init failed" << std::endl;
         return false;
     }
-    lights.emplace_back(light1);
-    lights.emplace_back(light2);
-    lights.emplace_back(light3);
 
-    glGenQueries(1, &gpuTimeProfileQuery);
+    gpuTimer = new GpuTimer();
+    if (!gpuTimer->Init()) {
+        std::cout << "gpuTimer Init failed" << std::endl;
+        return false;
+    }
 
     return true;
 }
@@ -162,30 +485,45 @@ bool RenderingEngine::initWindow(const std::string &title, int w, int h) {
 void RenderingEngine::initVertex() {
     glGenVertexArrays(1, &planeVAO);
     glGenBuffers(1, &planeVBO);
-    glBindVertexArray(planeVAO);
+    glBindVertexArray_profile(planeVAO);
     glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(utils::planeVertices), utils::planeVertices, GL_STATIC_DRAW);
+    glBufferData_profile(GL_ARRAY_BUFFER, sizeof(utils::planeVertices), utils::planeVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-    glBindVertexArray(0);
+    glBindVertexArray_profile(0);
 
-    obj_parser::Scene scene;
-    obj_parser::loadObj("../res/cube.obj", scene, obj_parser::ParseOption::FLIP_UV | obj_parser::ParseOption::CALC_TANGENT);
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO);
+    glBindVertexArray_profile(quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData_profile(GL_ARRAY_BUFFER, sizeof(utils::quadVertices), utils::quadVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(3 * sizeof(float)));
+    glBindVertexArray_profile(0);
+
+    // both meshes are parsed in parallel, the gl uploads stay on this thread
+    obj_parser::Scene scene, dragonScene;
+    JobCounter loading;
+    jobSystem->Run("load cube.obj", [&scene]() { obj_parser::loadObj("../res/cube.obj", scene, obj_parser::ParseOption::FLIP_UV | obj_parser::ParseOption::CALC_TANGENT); }, &loading);
+    jobSystem->Run("load dragon.obj", [&dragonScene]() { obj_parser::loadObj("../res/dragon.obj", dragonScene, obj_parser::ParseOption::FLIP_UV); }, &loading);
+    jobSystem->Wait(&loading);
 
     glGenVertexArrays(1, &cubeVAO);
     glGenBuffers(1, &cubeVBO);
-    glBindVertexArray(cubeVAO);
+    glBindVertexArray_profile(cubeVAO);
     glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
     const unsigned int POSITION_OFFSET = 3;
     const unsigned int NORMAL_OFFSET = 3;
     const unsigned int TEXTURE_OFFSET = 2;
     const unsigned int TANGENT_OFFSET = 3;
     const unsigned int STRIDE = (POSITION_OFFSET + NORMAL_OFFSET + TEXTURE_OFFSET + TANGENT_OFFSET) * sizeof(float);
-    glBufferData(GL_ARRAY_BUFFER, scene.meshes[0].vertices.size() * STRIDE, &(scene.meshes[0].vertices[0].position.x), GL_STATIC_DRAW);
+    glBufferData_profile(GL_ARRAY_BUFFER, scene.meshes[0].vertices.size() * STRIDE, &(scene.meshes[0].vertices[0].position.x), GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, STRIDE, (void *)0);
     glEnableVertexAttribArray(1);
@@ -195,13 +533,17 @@ void RenderingEngine::initVertex() {
     glEnableVertexAttribArray(3);
     glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, STRIDE, (void *)((POSITION_OFFSET + NORMAL_OFFSET + TEXTURE_OFFSET) * sizeof(float)));
 
-    obj_parser::loadObj("../res/dragon.obj", scene, obj_parser::ParseOption::FLIP_UV);
+    const obj_parser::Bounds cubeBounds = scene.meshes[0].bounds;
+    const int cubeVertexCount = (int)scene.meshes[0].vertices.size();
+    for (const auto &vertex : scene.meshes[0].vertices) {
+        cubeOccluder.push_back(vertex.position);
+    }
 
     glGenVertexArrays(1, &dragonVAO);
     glGenBuffers(1, &dragonVBO);
-    glBindVertexArray(dragonVAO);
+    glBindVertexArray_profile(dragonVAO);
     glBindBuffer(GL_ARRAY_BUFFER, dragonVBO);
-    glBufferData(GL_ARRAY_BUFFER, scene.meshes[1].vertices.size() * STRIDE, &(scene.meshes[1].vertices[0].position.x), GL_STATIC_DRAW);
+    glBufferData_profile(GL_ARRAY_BUFFER, dragonScene.meshes[0].vertices.size() * STRIDE, &(dragonScene.meshes[0].vertices[0].position.x), GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, STRIDE, (void *)0);
     glEnableVertexAttribArray(1);
@@ -210,22 +552,267 @@ void RenderingEngine::initVertex() {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, STRIDE, (void *)((POSITION_OFFSET + NORMAL_OFFSET) * sizeof(float)));
     glEnableVertexAttribArray(3);
     glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, STRIDE, (void *)((POSITION_OFFSET + NORMAL_OFFSET + TEXTURE_OFFSET) * sizeof(float)));
+    glBindVertexArray_profile(0);
+
+    const obj_parser::Bounds dragonBounds = dragonScene.meshes[0].bounds;
+    const obj_parser::Bounds planeBounds = obj_parser::calcBounds(utils::planeVertices, 6, 8, 6);
+    const int dragonVertexCount = (int)dragonScene.meshes[0].vertices.size();
+    for (int i = 0; i < 6; i++) {
+        planeOccluder.push_back(glm::vec3(utils::planeVertices[i * 8], utils::planeVertices[i * 8 + 1], utils::planeVertices[i * 8 + 2]));
+    }
+
+    const glm::quat noRotation(1.f, 0.f, 0.f, 0.f);
+    const glm::quat tilted = glm::angleAxis(glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 1.0, 1.0)));
+    // floor
+    createMeshEntity(planeVAO, 6, cube1_material, glm::vec3(0.f), noRotation, glm::vec3(1.f), planeBounds, false, &planeOccluder);
+    if (stressScene.objects > 0) {
+        initStressScene();
+        placeMeshEntities();
+        sceneBvh.Commit();
+        return;
+    }
+    // first cube
+    createMeshEntity(cubeVAO, cubeVertexCount, cube1_material, glm::vec3(0.0f, 1.5f, -8.0), noRotation, glm::vec3(0.5f), cubeBounds, true, &cubeOccluder);
+    // another cube
+    createMeshEntity(cubeVAO, cubeVertexCount, cube1_material, glm::vec3(2.0f, 0.0f, -6.0), tilted, glm::vec3(0.5f), cubeBounds, true, &cubeOccluder);
+    // another cube2
+    createMeshEntity(cubeVAO, cubeVertexCount, cube1_material, glm::vec3(-1.0f, 0.0f, -4.0), glm::angleAxis(glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0))),
+                     glm::vec3(0.25), cubeBounds, true, &cubeOccluder);
+    // dragon
+    createMeshEntity(dragonVAO, dragonVertexCount, cube1_material, glm::vec3(3.0f, 0.0f, 0.0), noRotation, glm::vec3(0.1f), dragonBounds, true, nullptr);
+    // dragon2, offset in the first dragon's scaled space
+    createMeshEntity(dragonVAO, dragonVertexCount, cube1_material, glm::vec3(3.3f, 0.0f, 0.9), noRotation, glm::vec3(0.1f), dragonBounds, true, nullptr);
+    // cube1
+    createMeshEntity(cubeVAO, cubeVertexCount, cube2_material, glm::vec3(1.92f, 0.f, -3.f), noRotation, glm::vec3(0.5f), cubeBounds, true, &cubeOccluder);
+    // cube2
+    createMeshEntity(cubeVAO, cubeVertexCount, cube2_material, glm::vec3(-4.0f, 0.0f, -2.0), tilted, glm::vec3(0.5f), cubeBounds, true, &cubeOccluder);
+    // cube3
+    createMeshEntity(cubeVAO, cubeVertexCount, cube2_material, glm::vec3(-1.0f, 0.0f, 0.0), noRotation, glm::vec3(0.5f), cubeBounds, true, &cubeOccluder);
+
+    placeMeshEntities();
+    sceneBvh.Commit();
+}
+
+void RenderingEngine::initStressScene() {
+    // generated in parallel like the obj files, the gl uploads stay on this thread
+    std::vector<std::vector<float>> meshes(stressScene.meshes);
+    JobCounter generating;
+    for (int m = 0; m < stressScene.meshes; m++) {
+        jobSystem->Run("generate stress mesh", [&meshes, m]() { stress_scene::generateMesh(m, meshes[m]); }, &generating);
+    }
+    jobSystem->Wait(&generating);
+
+    const unsigned int STRIDE = stress_scene::VERTEX_STRIDE * sizeof(float);
+    std::vector<obj_parser::Bounds> meshBounds(stressScene.meshes);
+    std::vector<int> meshVertexCounts(stressScene.meshes);
+    stressVAOs.resize(stressScene.meshes);
+    stressVBOs.resize(stressScene.meshes);
+    glGenVertexArrays(stressScene.meshes, stressVAOs.data());
+    glGenBuffers(stressScene.meshes, stressVBOs.data());
+    for (int m = 0; m < stressScene.meshes; m++) {
+        meshVertexCounts[m] = (int)(meshes[m].size() / stress_scene::VERTEX_STRIDE);
+        meshBounds[m] = obj_parser::calcBounds(meshes[m].data(), meshVertexCounts[m], stress_scene::VERTEX_STRIDE, 6);
+        glBindVertexArray_profile(stressVAOs[m]);
+        glBindBuffer(GL_ARRAY_BUFFER, stressVBOs[m]);
+        glBufferData_profile(GL_ARRAY_BUFFER, meshes[m].size() * sizeof(float), meshes[m].data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, STRIDE, (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, STRIDE, (void *)(3 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, STRIDE, (void *)(6 * sizeof(float)));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, STRIDE, (void *)(8 * sizeof(float)));
+    }
+    glBindVertexArray_profile(0);
+
+    // mesh and material are drawn independently, so both counts change the sort and bind pattern on their own
+    std::mt19937 rng(stressScene.seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    for (int i = 0; i < stressScene.objects; i++) {
+        int mesh = (int)(rng() % stressScene.meshes);
+        Material *material = stressMaterials[rng() % stressScene.materials];
+        glm::vec3 position((unit(rng) * 2.f - 1.f) * STRESS_SCENE_EXTENT, unit(rng) * 3.f, (unit(rng) * 2.f - 1.f) * STRESS_SCENE_EXTENT);
+        glm::vec3 axis = glm::normalize(glm::vec3(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f) + glm::vec3(0.f, 1e-3f, 0.f));
+        glm::quat rotation = glm::angleAxis(unit(rng) * glm::radians(360.f), axis);
+        glm::vec3 scale(0.15f + 0.35f * unit(rng));
+        createMeshEntity(stressVAOs[mesh], meshVertexCounts[mesh], material, position, rotation, scale, meshBounds[mesh], true, nullptr);
+    }
+}
+
+Entity RenderingEngine::createMeshEntity(unsigned int vao, int vertexCount, Material *material, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale,
+                                         const obj_parser::Bounds &localBounds, bool cullFace, const std::vector<glm::vec3> *occluder) {
+    Entity entity = registry.Create();
+    TransformHandle transform = transformStore.Create(position, rotation, scale);
+    unsigned int renderObject = (unsigned int)renderObjects.size();
+    // placed by placeMeshEntities, after the last one
+    addRenderObject(vao, vertexCount, material, glm::mat4(1.f), localBounds, cullFace, occluder);
+    registry.Add<TransformComponent>(entity, transform);
+    registry.Add<MeshRenderer>(entity, vao, vertexCount, cullFace, occluder, renderObject);
+    registry.Add<MaterialComponent>(entity, material);
+    return entity;
+}
+
+void RenderingEngine::placeMeshEntities() {
+    // one batch for every transform created, updating per entity would make building a large scene quadratic
+    transformStore.Update();
+    registry.Each<MeshRenderer, TransformComponent>([this](Entity, MeshRenderer &mesh, TransformComponent &transform) {
+        setModelMatrix(mesh.renderObject, transformStore.GetWorldMatrix(transform.handle));
+    });
+}
+
+void RenderingEngine::addRenderObject(unsigned int vao, int vertexCount, Material *material, const glm::mat4 &model, const obj_parser::Bounds &localBounds, bool cullFace,
+                                      const std::vector<glm::vec3> *occluder) {
+    RenderObject obj;
+    obj.vao = vao;
+    obj.vertexCount = vertexCount;
+    obj.material = material;
+    obj.materialId = materialTable.GetId(material);
+    obj.model = model;
+    obj.localMin = localBounds.min;
+    obj.localMax = localBounds.max;
+    obj.localCenter = localBounds.center;
+    obj.localRadius = localBounds.radius;
+    obj.uvDensity = localBounds.uvDensity;
+    obj.cullFace = cullFace;
+    obj.occluder = occluder;
+    obj.queryOcclusion = vertexCount >= OCCLUSION_QUERY_MIN_VERTICES;
+    updateWorldBounds(obj);
+    unsigned int index = (unsigned int)renderObjects.size();
+    obj.bvhProxy = sceneBvh.Insert(index, obj.aabbMin, obj.aabbMax);
+    allObjects.push_back(index);
+    objectBounds.Add(obj.center, obj.radius);
+    renderObjects.push_back(obj);
+}
+
+void RenderingEngine::updateWorldBounds(RenderObject &obj) {
+    const glm::mat4 &model = obj.model;
+    obj.center = glm::vec3(model * glm::vec4(obj.localCenter, 1.f));
+    float maxScale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    obj.radius = obj.localRadius * maxScale;
+    // transformed box extents (Arvo)
+    glm::vec3 boxCenter = glm::vec3(model * glm::vec4((obj.localMin + obj.localMax) * 0.5f, 1.f));
+    glm::vec3 halfExtent = (obj.localMax - obj.localMin) * 0.5f;
+    glm::vec3 worldExtent = glm::abs(glm::vec3(model[0])) * halfExtent.x + glm::abs(glm::vec3(model[1])) * halfExtent.y + glm::abs(glm::vec3(model[2])) * halfExtent.z;
+    obj.aabbMin = boxCenter - worldExtent;
+    obj.aabbMax = boxCenter + worldExtent;
+}
+
+void RenderingEngine::setModelMatrix(unsigned int object, const glm::mat4 &model) {
+    RenderObject &obj = renderObjects[object];
+    obj.model = model;
+    updateWorldBounds(obj);
+    objectBounds.Set(object, obj.center, obj.radius);
+    // refit happens once per frame in renderFrame
+    sceneBvh.Update(obj.bvhProxy, obj.aabbMin, obj.aabbMax);
+}
+
+void RenderingEngine::cullObjects(const glm::mat4 &viewProjection, std::vector<unsigned int> &visible) {
+    Frustum frustum(viewProjection);
+    if (renderObjects.size() < BVH_CULLING_THRESHOLD) {
+        objectBounds.Cull(frustum, visible);
+        return;
+    }
+    sceneBvh.QueryFrustum(frustum, visible);
+    // tree order scatters materials, keep submission order stable
+    std::sort(visible.begin(), visible.end());
+}
+
+void RenderingEngine::occludeObjects(const glm::mat4 &viewProjection, std::vector<unsigned int> &visible) {
+    // only occluders that survived frustum culling can hide anything on screen
+    occlusionCulling->Begin(viewProjection);
+    for (unsigned int idx : visible) {
+        const RenderObject &obj = renderObjects[idx];
+        if (obj.occluder) occlusionCulling->AddOccluder(obj.model, &(*obj.occluder)[0], (unsigned int)obj.occluder->size());
+    }
+    occlusionCulling->Rasterize();
+    visible.erase(std::remove_if(visible.begin(), visible.end(),
+                                 [this](unsigned int idx) { return !occlusionCulling->IsVisible(renderObjects[idx].aabbMin, renderObjects[idx].aabbMax); }),
+                  visible.end());
+}
+
+void RenderingEngine::pickObject() {
+    Ray ray(cameraTrans->GetWorldPosition(), cameraTrans->GetForward());
+    unsigned int hit;
+    float distance;
+    if (sceneBvh.Raycast(ray, camera->GetFarClipPlane(), hit, distance)) {
+        pickedObject = (int)hit;
+        pickedDistance = distance;
+    } else {
+        pickedObject = -1;
+    }
 }
 
 bool RenderingEngine::initShader() {
-    normal_shader = loadShaderFromFile("../shaders/normal/normal_vs.shader", "../shaders/normal/normal_fs.shader");
-    if (!normal_shader) return false;
-    depth_cubemap_shader = loadShaderFromFile("../shaders/point_shadow/depth_vs.shader", "../shaders/point_shadow/depth_gs.shader", "../shaders/point_shadow/depth_fs.shader");
-    if (!depth_cubemap_shader) return false;
-    shadow_cubemap_shader = loadShaderFromFile("../shaders/point_shadow/shadow_vs.shader", "../shaders/point_shadow/shadow_fs.shader");
-    if (!shadow_cubemap_shader) return false;
+    // submitted together so they build side by side, the font, hdr and occlusion programs already were in initResources
+    ShaderCompiler &compiler = ShaderCompiler::Get();
+    compiler.Build(&normal_shader, "../shaders/normal/normal_vs.shader", "", "../shaders/normal/normal_fs.shader");
+    compiler.Build(&depth_cubemap_shader, "../shaders/point_shadow/depth_vs.shader", "../shaders/point_shadow/depth_gs.shader", "../shaders/point_shadow/depth_fs.shader");
+    compiler.Build(&depth_moment_shader, "../shaders/point_shadow/depth_vs.shader", "../shaders/point_shadow/depth_gs.shader", "../shaders/point_shadow/moment_fs.shader");
+    compiler.Build(&moment_blur_shader, "../shaders/point_shadow/moment_blur_vs.shader", "", "../shaders/point_shadow/moment_blur_fs.shader");
+    compiler.Build(&cascade_depth_shader, "../shaders/shadow/depth_vs.shader", "", "../shaders/shadow/depth_fs.shader");
+    compiler.Build(&depth_visual_shader, "../shaders/shadow/depth_visual_vs.shader", "", "../shaders/shadow/depth_visual_fs.shader");
+    litShaders = new ShaderPermutations("../shaders/point_shadow/shadow_vs.shader", "../shaders/point_shadow/shadow_fs.shader", litShaderDefines);
+    uint32_t litKey = litShaderKey(lights, nullptr);
+    litShaders->Request(litKey);
+    litShaders->Request(litKey | LIT_NORMAL_MAP);
+    if (materialTable.GetArrayCount() > 0) litShaders->Request(litKey | LIT_MATERIAL_ARRAY);
+    // the first frame draws with all of them
+    if (!compiler.WaitAll()) return false;
+    // the variants the M and TAB keys switch to keep building in the background
+    ShadowFilterMode toggledMode = lights[0]->GetShadowFilterMode() == ShadowFilterMode::PCF ? ShadowFilterMode::MOMENT : ShadowFilterMode::PCF;
+    uint32_t toggledKey = litShaderKey(lights, &toggledMode);
+    litShaders->Request(toggledKey);
+    litShaders->Request(toggledKey | LIT_NORMAL_MAP);
+    if (materialTable.GetArrayCount() > 0) litShaders->Request(toggledKey | LIT_MATERIAL_ARRAY);
+    ShaderCache::Get().Save();
+    ShaderCache::Get().PrintSummary();
     return true;
 }
 
 bool RenderingEngine::isFullscreen() { return glfwGetWindowMonitor(mWindow) != nullptr; }
 
+void RenderingEngine::beginFrameLoop() {
+    // from here on the registry, the transform store and the lights' orbits belong to the simulation
+    simulationCamera->SetPosition(cameraTrans->GetPosition());
+    simulationCamera->SetRotation(cameraTrans->GetRotation());
+    simulation->Start([this](float dt, const SimulationInput &input, SceneSnapshot &out) { simulate(dt, input, out); });
+
+    Profiler &profiler = Profiler::Get();
+    // nothing loaded during init counts towards the first frame
+    resetProfile();
+    profiler.SetThreadName("main");
+    GLint64 gpuTime = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+    profiler.CalibrateGpu(gpuTime);
+    jobSystem->SetProfileHook([](const JobProfile &job) {
+        Profiler &p = Profiler::Get();
+        double now = p.Now();
+        if (job.worker > 0) p.SetThreadName("worker", (int)job.worker);
+        p.AddEvent(job.name, -1, now - (job.end - job.begin) * 1e6, now);
+    });
+}
+
+void RenderingEngine::endFrameLoop() {
+    simulation->Stop();
+    GlCapture::Get().Stop();
+    // the worker's context goes with glfwTerminate
+    ShaderCompiler::Get().Shutdown();
+    // programs linked after startup, later variants and reloads, go into the cache too
+    ShaderCache::Get().Save();
+    TextureLoader::Get().Shutdown();
+    if (exportTraceOnExit) Profiler::Get().ExportChromeTrace(tracePath);
+    if (!statsPath.empty()) RenderStats::Get().Write(statsPath);
+}
+
 int RenderingEngine::render() {
+    beginFrameLoop();
+    Profiler &profiler = Profiler::Get();
+    RenderStats &stats = RenderStats::Get();
+
     while (!glfwWindowShouldClose(mWindow)) {
+        profiler.BeginFrame();
+        PROFILE_SCOPE("frame");
         if (isInvalidate) {
             int w, h;
             glfwGetFramebufferSize(mWindow, &w, &h);
@@ -238,155 +825,570 @@ int RenderingEngine::render() {
 
         time->Update();
         keyboardCallback();
+        simulation->Step(time->GetDeltaTime());
 
-        glBeginQuery(GL_TIME_ELAPSED, gpuTimeProfileQuery);
+        GlCapture::Get().BeginFrame();
+        gpuTimer->BeginFrame();
+        profiler.AddGpuResults(*gpuTimer);
+        stats.BeginFrame();
+        stats.AddGpuResults(*gpuTimer);
         renderFrame();
-        glEndQuery(GL_TIME_ELAPSED);
-        glGetQueryObjectuiv(gpuTimeProfileQuery, GL_QUERY_RESULT, &timeElapsed);
-
-        renderFont();
+        {
+            PROFILE_GPU_SCOPE(gpuTimer, "hud");
+            renderFont();
+        }
+        {
+            // a pass of its own, so the pixel buffer uploads are counted before resetProfile clears them
+            PROFILE_GPU_SCOPE(gpuTimer, "texture uploads");
+            TextureLoader::Get().Update();
+        }
+        gpuTimer->EndFrame();
+        stats.EndFrame();
+        GlCapture::Get().EndFrame();
+        ShaderCompiler::Get().Update();
         resetProfile();
         glfwSwapBuffers(mWindow);
         glfwPollEvents();
     }
 
+    endFrameLoop();
     glfwTerminate();
     return 0;
 }
 
+int RenderingEngine::runBenchmark(const std::string &pathFile, int frames, bool printHash) {
+    if (!cameraPath.Load(pathFile)) {
+        std::cout << "camera path " << pathFile << " load failed" << std::endl;
+        return -1;
+    }
+    // conditional rendering depends on when query results arrive, which would make the image hash differ run to run
+    if (printHash) useOcclusionQueries = false;
+    // every run measures and hashes the same texels, not whichever placeholders or mip levels are left
+    TextureLoader::Get().Finish();
+    beginFrameLoop();
+    Profiler &profiler = Profiler::Get();
+    RenderStats &stats = RenderStats::Get();
+
+    // fixed steps: the same path always renders the same frames, however long each one takes
+    const float dt = 1.f / BENCHMARK_FRAME_RATE;
+    int frame = 0;
+    for (; frame < frames; frame++) {
+        if (mWindow && glfwWindowShouldClose(mWindow)) break;
+        profiler.BeginFrame();
+        PROFILE_SCOPE("frame");
+        simulation->Step(dt);
+        GlCapture::Get().BeginFrame();
+        gpuTimer->BeginFrame();
+        profiler.AddGpuResults(*gpuTimer);
+        stats.BeginFrame();
+        stats.AddGpuResults(*gpuTimer);
+        renderFrame();
+        gpuTimer->EndFrame();
+        stats.EndFrame();
+        GlCapture::Get().EndFrame();
+        ShaderCompiler::Get().Update();
+        resetProfile();
+        if (mWindow) {
+            glfwSwapBuffers(mWindow);
+            glfwPollEvents();
+        } else {
+            glFlush();
+        }
+    }
+    glFinish();
+
+    std::cout << "benchmark: " << frame << " frames of " << pathFile << " (" << cameraPath.GetDuration() << " s path at " << BENCHMARK_FRAME_RATE << " fps)" << std::endl;
+    stats.PrintSummary();
+    if (printHash) {
+        std::vector<unsigned char> pixels((size_t)width * height * 4);
+        glBindFramebuffer_profile(GL_READ_FRAMEBUFFER, camera->GetTargetFramebuffer());
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        // fnv-1a
+        unsigned long long hash = 14695981039346656037ull;
+        for (unsigned char c : pixels) hash = (hash ^ c) * 1099511628211ull;
+        std::cout << "image hash: " << std::hex << std::setfill('0') << std::setw(16) << hash << std::setfill(' ') << std::dec << std::endl;
+    }
+    endFrameLoop();
+    if (mWindow) glfwTerminate();
+    return 0;
+}
+
+int RenderingEngine::runReplay(GlReplay &replay, int frames) {
+    // the capture brings its own shaders and scene, only the timer and the target framebuffer are the engine's
+    replay.RunSetup(camera->GetTargetFramebuffer());
+    glFinish();
+    resetProfile();
+    Profiler &profiler = Profiler::Get();
+    profiler.SetThreadName("main");
+    RenderStats &stats = RenderStats::Get();
+
+    int frame = 0;
+    for (; frame < frames; frame++) {
+        if (mWindow && glfwWindowShouldClose(mWindow)) break;
+        profiler.BeginFrame();
+        PROFILE_SCOPE("frame");
+        gpuTimer->BeginFrame();
+        profiler.AddGpuResults(*gpuTimer);
+        stats.BeginFrame();
+        stats.AddGpuResults(*gpuTimer);
+        replay.RunFrame(frame % replay.GetFrameCount(), gpuTimer);
+        gpuTimer->EndFrame();
+        stats.EndFrame();
+        resetProfile();
+        if (mWindow) {
+            glfwSwapBuffers(mWindow);
+            glfwPollEvents();
+        } else {
+            glFlush();
+        }
+    }
+    glFinish();
+
+    std::cout << "replay: " << frame << " frames, " << replay.GetFrameCount() << " captured ones looped" << std::endl;
+    stats.PrintSummary();
+    if (exportTraceOnExit) profiler.ExportChromeTrace(tracePath);
+    if (!statsPath.empty()) stats.Write(statsPath);
+    ShaderCompiler::Get().Shutdown();
+    TextureLoader::Get().Shutdown();
+    if (mWindow) glfwTerminate();
+    return 0;
+}
+
 void RenderingEngine::renderFont() {
     fontRenderer->SetScale(0.27);
     fontRenderer->SetColor(glm::vec3(0.25f, 0.25f, 0.25f));
     fontRenderer->Printf(glm::vec2(5.f, height - 12 * 1), "triangle count: %d", triangleCount);
     fontRenderer->Printf(glm::vec2(5.f, height - 12 * 2), "vertex count: %d", vertexCount);
-    fontRenderer->Printf(glm::vec2(5.f, height - 12 * 3), "draw call: %d", drawCallCount);
-    fontRenderer->Printf(glm::vec2(5.f, height - 12 * 4), "GPU time: %d ns", timeElapsed);
+    fontRenderer->Printf(glm::vec2(5.f, height - 12 * 3), "draw call: %d (visible: %d, culled: %d, occluded: %d)", drawCallCount, visibleCount, culledCount,
+                         occludedCount);
+    fontRenderer->Printf(glm::vec2(5.f, height - 12 * 4), "GPU time: %.2f ms (%d frames late, %lu dropped)", gpuTimer->GetFrameTime(), gpuTimer->GetLatency(),
+                         gpuTimer->GetDroppedFrames());
+    const RenderStats &stats = RenderStats::Get();
+    for (int i = 0; i < stats.GetPassCount(); i++) {
+        const RenderStats::Pass &pass = stats.GetPass(i);
+        char name[32];
+        if (pass.index >= 0) {
+            snprintf(name, sizeof(name), "%s %d", pass.name, pass.index);
+        } else {
+            snprintf(name, sizeof(name), "%s", pass.name);
+        }
+        fontRenderer->Printf(glm::vec2(width - 400.f, height - 12.f * (i + 1)), "%s: gpu %.3f cpu %.3f ms, %d draws, %d tris, %d binds, %d uniforms", name, pass.gpu.Last(),
+                             pass.cpu.Last(), pass.last.drawCalls, pass.last.triangles, pass.last.stateChanges + pass.last.textureBinds, pass.last.uniformUploads);
+    }
+    fontRenderer->Printf(glm::vec2(5.f, height - 12 * 5), "sun cascades: %d/%d updated, %d draw calls%s", cascadeUpdates, DirectionalLight::CascadeCount, cascadeDrawCalls,
+                         sun->GetUpdateDistantCascadesEveryOtherFrame() ? " (distant every other frame)" : "");
+    fontRenderer->Printf(glm::vec2(5.f, height - 12 * 6), "cascade casters: %d %d %d %d", cascadeCasters[0], cascadeCasters[1], cascadeCasters[2], cascadeCasters[3]);
+    fontRenderer->Printf(glm::vec2(5.f, height - 12 * 7), "cascade splits: %.1f %.1f %.1f %.1f m", sun->GetCascadeSplit(0), sun->GetCascadeSplit(1), sun->GetCascadeSplit(2), sun->GetCascadeSplit(3));
+    fontRenderer->Printf(glm::vec2(5.f, height - 12 * 8), "cascade coverage: %.1f %.1f %.1f %.1f m", sun->GetCascadeCoverage(0), sun->GetCascadeCoverage(1), sun->GetCascadeCoverage(2),
+                         sun->GetCascadeCoverage(3));
+    fontRenderer->Printf(glm::vec2(5.f, height - 12 * 9), "bvh nodes: %d, point light casters: %d", sceneBvh.GetNodeCount(), lightCasterCount);
+    if (pickedObject >= 0) {
+        fontRenderer->Printf(glm::vec2(5.f, height - 12 * 10), "picked: object %d at %.2f m", pickedObject, pickedDistance);
+    }
+    if (simulation->IsThreaded()) {
+        fontRenderer->Printf(glm::vec2(5.f, height - 12 * 12), "simulation: %.0f Hz, tick %lu, showing %lu", simulation->GetTickRate(), simulation->GetTickCount(), appliedTick);
+    } else {
+        fontRenderer->Printf(glm::vec2(5.f, height - 12 * 12), "simulation: inline, tick %lu", appliedTick);
+    }
+    fontRenderer->Printf(glm::vec2(5.f, height - 12 * 13), "frame p50/p95/p99: %.2f/%.2f/%.2f ms, gpu %.2f/%.2f/%.2f ms, spikes: %d", stats.GetFrameTime().Percentile(0.5f),
+                         stats.GetFrameTime().Percentile(0.95f), stats.GetFrameTime().Percentile(0.99f), stats.GetFrameGpu().Percentile(0.5f), stats.GetFrameGpu().Percentile(0.95f),
+                         stats.GetFrameGpu().Percentile(0.99f), stats.GetSpikeCount());
+    fontRenderer->Printf(glm::vec2(5.f, height - 12 * 14), "state changes: %d, texture binds: %d, uniforms: %d, uploaded: %lld bytes", stateChangeCount, textureBindCount,
+                         uniformUploadCount, bufferUploadBytes);
+    const TextureLoader &textures = TextureLoader::Get();
+    fontRenderer->Printf(glm::vec2(5.f, height - 12 * 15), "textures: %.1f/%.0f MB resident, %d sharpening", textures.GetResidentBytes() / 1048576.0, textures.GetBudget() / 1048576.0,
+                         textures.GetStreamingCount());
+    if (useOcclusionQueries) {
+        int tested = occlusionQuery->GetTestedCount();
+        fontRenderer->Printf(glm::vec2(5.f, height - 12 * 11), "occlusion queries: %d, skipped: %d (%.0f%%), latency: %.1f frames", tested, occlusionQuery->GetSkippedCount(),
+                             tested > 0 ? 100.f * occlusionQuery->GetSkippedCount() / tested : 0.f, occlusionQuery->GetAverageLatency());
+    }
     fontRenderer->SetScale(0.4);
     fontRenderer->SetColor(glm::vec3(1.f, 1.f, 1.f));
+    fontRenderer->Printf(glm::vec2(5.f, 5 + 22 * 7), "occlusion culling: %s", camera->GetUseOcclusionCulling() ? "true" : "false");
+    fontRenderer->Printf(glm::vec2(5.f, 5 + 22 * 6), "shadow filter: %s", lights[0]->GetShadowFilterMode() == ShadowFilterMode::MOMENT ? "moment" : "pcf");
     fontRenderer->Printf(glm::vec2(5.f, 5 + 22 * 5), "use normal: %s", cube2_material->GetUseNormal() ? "true" : "false");
     fontRenderer->Printf(glm::vec2(5.f, 5 + 22 * 4), "use hdr: %s", camera->IsHdr() ? "true" : "false");
     fontRenderer->Printf(glm::vec2(5.f, 5 + 22 * 3), "exposure: %.5f", camera->GetHdrExposure());
     fontRenderer->Printf(glm::vec2(5.f, 5 + 22 * 2), "total lights: %ld", lights.size());
     glm::vec3 f = cameraTrans->GetForward();
     fontRenderer->Printf(glm::vec2(5.f, 5 + 22 * 1), "camera front: [%.2f, %.2f, %.2f]", f.x, f.y, f.z);
-    glm::vec3 p = cameraTrans->GetPosition();
+    glm::vec3 p = cameraTrans->GetWorldPosition();
     fontRenderer->Printf(glm::vec2(5.f, 5 + 22 * 0), "camera pos: [%.2f, %.2f, %.2f]", p.x, p.y, p.z);
 }
 
-void RenderingEngine::renderScene(unsigned int shader) {
-    glEnable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
+void RenderingEngine::renderScene(unsigned int shader) { renderScene(shader, allObjects); }
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, cube1_material->GetDiffuse());
-    glUniform1i(glGetUniformLocation(shader, "material.diffuse"), 0);
-    glUniform1f(glGetUniformLocation(shader, "material.useNormal"), cube1_material->GetUseNormal());
-    glUniform1f(glGetUniformLocation(shader, "material.shininess"), cube1_material->GetShininess());
+void RenderingEngine::renderScene(unsigned int shader, const std::vector<unsigned int> &objects) {
+    CommandBuffer commands;
+    recordScene(commands, objects, true, nullptr, false);
+    submit(shader, commands);
+}
 
-    // floor
-    glm::mat4 model = glm::mat4(1.0f);
-    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glBindVertexArray(planeVAO);
-    glDrawArrays_profile(GL_TRIANGLES, 0, 6);
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-    // first cube
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(0.0f, 1.5f, -8.0));
-    model = glm::scale(model, glm::vec3(0.5f));
-    glBindVertexArray(cubeVAO);
-    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays_profile(GL_TRIANGLES, 0, 36);
-    // another cube
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(2.0f, 0.0f, -6.0));
-    model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 1.0, 1.0)));
-    model = glm::scale(model, glm::vec3(0.5f));
-    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays_profile(GL_TRIANGLES, 0, 36);
-    // another cube2
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -4.0));
-    model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
-    model = glm::scale(model, glm::vec3(0.25));
-    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays_profile(GL_TRIANGLES, 0, 36);
+void RenderingEngine::recordScene(CommandBuffer &commands, const std::vector<unsigned int> &objects, bool bindMaterials, const glm::mat4 *viewProjection, bool conditional) const {
+    commands.Clear();
+    for (unsigned int idx : objects) {
+        const RenderObject &obj = renderObjects[idx];
+        float depth = 0.f;
+        if (viewProjection) {
+            glm::vec4 clip = *viewProjection * glm::vec4(obj.center, 1.f);
+            depth = clip.w > 0.f ? clip.z / clip.w * 0.5f + 0.5f : 0.f;
+        }
+        uint64_t key = CommandBuffer::MakeKey(bindMaterials ? materialTable.GetSortKey(obj.materialId) : 0, obj.vao, depth, idx);
+        commands.AddDraw(key, obj.vao, obj.vertexCount, bindMaterials ? obj.material : nullptr, idx, obj.cullFace, conditional && obj.queryOcclusion, obj.model);
+    }
+    commands.Sort();
+}
 
-    // dragon
-    glBindVertexArray(dragonVAO);
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(3.0f, 0.0f, 0.0));
-    model = glm::scale(model, glm::vec3(0.1f));
-    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays_profile(GL_TRIANGLES, 0, 300000);
-
-    // dragon2
-    model = glm::translate(model, glm::vec3(3.0f, 0.0f, 9.0));
-    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays_profile(GL_TRIANGLES, 0, 300000);
+void RenderingEngine::submit(unsigned int shader, const CommandBuffer &commands, const unsigned int *variants) {
+    glEnable_profile(GL_DEPTH_TEST);
+
+    const Material *boundMaterial = nullptr;
+    unsigned int boundVAO = 0, boundArray = 0;
+    int boundCullFace = -1;
+    bool skipMaterial = false;
+    GLint modelLocation = glGetUniformLocation(shader, "model");
+    GLint materialIdLocation = glGetUniformLocation(shader, "materialId");
+    for (const CommandBuffer::Draw &draw : commands.GetDraws()) {
+        if (draw.material && draw.material != boundMaterial) {
+            boundMaterial = draw.material;
+            unsigned int variant = variants ? variants[litVariant(draw.material)] : shader;
+            // a variant that failed to build draws nothing instead of drawing with program 0
+            skipMaterial = variant == 0;
+            if (skipMaterial) continue;
+            if (variant != shader) {
+                shader = variant;
+                glUseProgram_profile(shader);
+                modelLocation = glGetUniformLocation(shader, "model");
+                materialIdLocation = glGetUniformLocation(shader, "materialId");
+            }
+            if (draw.material->GetDiffuseArray()) {
+                // the layers of one array only differ in the id the shader reads the Materials block with
+                if (draw.material->GetDiffuseArray() != boundArray) {
+                    boundArray = draw.material->GetDiffuseArray();
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture_profile(GL_TEXTURE_2D_ARRAY, boundArray);
+                }
+                glUniform1i_profile(materialIdLocation, (GLint)renderObjects[draw.object].materialId);
+            } else {
+                bindMaterial(shader, draw.material);
+            }
+        }
+        if (skipMaterial) continue;
+        if ((int)draw.cullFace != boundCullFace) {
+            if (draw.cullFace) {
+                glEnable_profile(GL_CULL_FACE);
+                glCullFace_profile(GL_BACK);
+            } else {
+                glDisable_profile(GL_CULL_FACE);
+            }
+            boundCullFace = (int)draw.cullFace;
+        }
+        if (draw.vao != boundVAO) {
+            glBindVertexArray_profile(draw.vao);
+            boundVAO = draw.vao;
+        }
+        glUniformMatrix4fv_profile(modelLocation, 1, GL_FALSE, glm::value_ptr(draw.model));
+        bool skippable = draw.conditional && occlusionQuery->BeginConditionalRender(draw.object);
+        glDrawArrays_profile(GL_TRIANGLES, 0, draw.vertexCount);
+        if (skippable) occlusionQuery->EndConditionalRender();
+    }
+}
+
+void RenderingEngine::estimateTextureDemand(const std::vector<unsigned int> &objects) {
+    // world units a pixel covers one unit in front of the camera
+    const float pixelSize = 2.f * std::tan(camera->GetFieldOfView() * 0.5f) / (float)height;
+    const glm::vec3 eye = cameraTrans->GetWorldPosition();
+    for (unsigned int idx : objects) {
+        const RenderObject &obj = renderObjects[idx];
+        if (!obj.material || obj.uvDensity <= 0.f || obj.localRadius <= 0.f) continue;
+        // the nearest point of the bounding sphere, and the largest scale: never blurrier than what is drawn
+        float distance = std::max(glm::length(obj.center - eye) - obj.radius, camera->GetNearClipPlane());
+        float uvPerPixel = obj.uvDensity * obj.localRadius / obj.radius * distance * pixelSize;
+        materialDemand[obj.materialId] = std::min(materialDemand[obj.materialId], uvPerPixel);
+    }
+}
+
+void RenderingEngine::requestTextures() {
+    TextureLoader &textures = TextureLoader::Get();
+    for (unsigned int i = 0; i < materialDemand.size(); i++) {
+        if (materialDemand[i] == FLT_MAX) continue;
+        const Material *material = materialTable.Get(i);
+        // a layer of an array is always fully resident
+        if (!material->GetDiffuseArray()) textures.Request(material->GetDiffuse(), materialDemand[i]);
+        textures.Request(material->GetSpecular(), materialDemand[i]);
+        if (material->GetUseNormal()) textures.Request(material->GetNormal(), materialDemand[i]);
+    }
+}
 
+void RenderingEngine::bindMaterial(unsigned int shader, const Material *material) {
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, cube2_material->GetDiffuse());
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, cube2_material->GetNormal());
-    glUniform1i(glGetUniformLocation(shader, "material.normal"), 1);
-    glUniform1f(glGetUniformLocation(shader, "material.useNormal"), cube2_material->GetUseNormal());
-    glUniform1f(glGetUniformLocation(shader, "material.shininess"), cube2_material->GetShininess());
+    glBindTexture_profile(GL_TEXTURE_2D, material->GetDiffuse());
+    glUniform1i_profile(glGetUniformLocation(shader, "material.diffuse"), 0);
+    if (material->GetNormal()) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture_profile(GL_TEXTURE_2D, material->GetNormal());
+        glUniform1i_profile(glGetUniformLocation(shader, "material.normal"), 1);
+    }
+    glUniform1f_profile(glGetUniformLocation(shader, "material.shininess"), material->GetShininess());
+}
 
-    // cube1
-    glBindVertexArray(cubeVAO);
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(1.92f, 0.f, -3.f));
-    model = glm::scale(model, glm::vec3(0.5f));
-    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays_profile(GL_TRIANGLES, 0, 36);
-    // cube2
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(-4.0f, 0.0f, -2.0));
-    model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 1.0, 1.0)));
-    model = glm::scale(model, glm::vec3(0.5f));
-    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays_profile(GL_TRIANGLES, 0, 36);
-    // cube3
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 0.0));
-    model = glm::scale(model, glm::vec3(0.5f));
-    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays_profile(GL_TRIANGLES, 0, 36);
+void RenderingEngine::bindLitUniforms(unsigned int shader) {
+    glUniformMatrix4fv_profile(glGetUniformLocation(shader, "projection"), 1, GL_FALSE, glm::value_ptr(camera->GetProjectionMatrix()));
+    glUniformMatrix4fv_profile(glGetUniformLocation(shader, "view"), 1, GL_FALSE, glm::value_ptr(camera->GetWorldToCameraMatrix()));
+    glUniform3fv_profile(glGetUniformLocation(shader, "viewPos"), 1, glm::value_ptr(cameraTrans->GetWorldPosition()));
+    glUniform1f_profile(glGetUniformLocation(shader, "far_plane"), camera->GetFarClipPlane());
+    for (int i = 0; i < lights.size(); i++) {
+        lights[i]->BindUniform(shader, i);
+    }
+    sun->BindUniform(shader);
+    sun->BindShadowMap(shader, 2 + MaxPointLights);
+    // only the MATERIAL_ARRAY variant has the block
+    GLuint materials = glGetUniformBlockIndex(shader, "Materials");
+    if (materials != GL_INVALID_INDEX) {
+        glUniformBlockBinding(shader, materials, MaterialTable::BlockBinding);
+        glUniform1i_profile(glGetUniformLocation(shader, "materialDiffuse"), 0);
+    }
+}
+
+void RenderingEngine::recordPasses(const glm::mat4 &viewProjection) {
+    PROFILE_SCOPE("record passes");
+    // every pass is recorded as its own job, nothing here may touch gl
+    JobCounter recording;
+    for (int c = 0; c < DirectionalLight::CascadeCount; c++) {
+        if (!cascadeActive[c]) continue;
+        jobSystem->Run("record cascade", [this, c]() {
+            // only what can throw a shadow into this cascade
+            std::vector<unsigned int> casters;
+            for (unsigned int i = 0; i < renderObjects.size(); i++) {
+                if (sun->IsCaster(c, renderObjects[i].center, renderObjects[i].radius)) casters.push_back(i);
+            }
+            cascadeCasters[c] = (int)casters.size();
+            recordScene(cascadeCommands[c], casters, false, nullptr, false);
+        }, &recording);
+    }
+    lightCommands.resize(lights.size());
+    for (unsigned int i = 0; i < lights.size(); i++) {
+        if (!lights[i]->GetCastShadow()) continue;
+        jobSystem->Run("record point light", [this, i]() {
+            // nothing outside the light range can shadow what it lights
+            std::vector<unsigned int> casters;
+            sceneBvh.QuerySphere(lights[i]->GetTransform()->GetWorldPosition(), lights[i]->GetRange(), casters);
+            recordScene(lightCommands[i], casters, false, nullptr, false);
+        }, &recording);
+    }
+    jobSystem->Run("record camera", [this, viewProjection]() {
+        cullObjects(viewProjection, visibleObjects);
+        culledCount = (int)renderObjects.size() - (int)visibleObjects.size();
+        occludedCount = 0;
+        if (camera->GetUseOcclusionCulling()) {
+            occludeObjects(viewProjection, visibleObjects);
+            occludedCount = (int)renderObjects.size() - culledCount - (int)visibleObjects.size();
+        }
+        visibleCount = (int)visibleObjects.size();
+        // expensive objects go last: their boxes are tested against everything else, the draws use last frame's result
+        queryObjects.clear();
+        if (useOcclusionQueries) {
+            for (unsigned int idx : visibleObjects) {
+                if (renderObjects[idx].queryOcclusion) queryObjects.push_back(idx);
+            }
+            visibleObjects.erase(std::remove_if(visibleObjects.begin(), visibleObjects.end(), [this](unsigned int idx) { return renderObjects[idx].queryOcclusion; }),
+                                 visibleObjects.end());
+        }
+        recordScene(cameraCommands, visibleObjects, true, &viewProjection, false);
+        recordScene(queryCommands, queryObjects, true, &viewProjection, true);
+        materialDemand.assign(materialTable.GetCount(), FLT_MAX);
+        estimateTextureDemand(visibleObjects);
+        estimateTextureDemand(queryObjects);
+    }, &recording);
+    jobSystem->Wait(&recording);
+}
+
+void RenderingEngine::renderCascades() {
+    int drawCallsBefore = drawCallCount;
+    cascadeUpdates = 0;
+    for (int c = 0; c < DirectionalLight::CascadeCount; c++) {
+        if (!cascadeActive[c]) continue;
+        sun->RenderToTexture(cascade_depth_shader, c);
+        submit(cascade_depth_shader, cascadeCommands[c]);
+        cascadeUpdates++;
+    }
+    cascadeDrawCalls = drawCallCount - drawCallsBefore;
+}
+
+void RenderingEngine::simulate(float dt, const SimulationInput &input, SceneSnapshot &out) {
+    simulationTime += dt;
+    out.time = simulationTime;
+
+    if (cameraPath.IsEmpty()) {
+        float velocity = (input.fast ? 7.5f : 2.5f) * dt;
+        simulationCamera->Rotate(Transform::Up, input.look.x);
+        simulationCamera->Rotate(simulationCamera->GetRight(), input.look.y);
+        simulationCamera->Translate((simulationCamera->GetRight() * input.move.x + simulationCamera->GetUp() * input.move.y + simulationCamera->GetForward() * input.move.z) * velocity);
+    } else {
+        glm::vec3 position = simulationCamera->GetPosition();
+        glm::quat rotation = simulationCamera->GetRotation();
+        cameraPath.SampleCamera(simulationTime, position, rotation);
+        simulationCamera->SetPosition(position);
+        simulationCamera->SetRotation(rotation);
+    }
+    out.cameraPosition = simulationCamera->GetPosition();
+    out.cameraRotation = simulationCamera->GetRotation();
+
+    float t = simulationTime;
+    unsigned int index = 0;
+    out.lights.clear();
+    registry.Each<PointLightComponent>([this, t, &index, &out](Entity, PointLightComponent &c) {
+        glm::vec3 position(cos(t * c.orbitSpeed) * c.orbitRadius, 3, sin(t * c.orbitSpeed) * c.orbitRadius);
+        cameraPath.SampleLight(index++, t, position);
+        out.lights.push_back({c.light, position});
+    });
+
+    // the job system belongs to the render thread, a threaded tick updates serially
+    transformStore.Update(simulation->IsThreaded() ? nullptr : jobSystem);
+    out.objects.clear();
+    registry.Each<MeshRenderer, TransformComponent, MaterialComponent>([this, &out](Entity, MeshRenderer &mesh, TransformComponent &transform, MaterialComponent &material) {
+        out.objects.push_back({mesh.renderObject, mesh.vao, mesh.vertexCount, material.material, mesh.cullFace, mesh.occluder, transformStore.GetWorldMatrix(transform.handle)});
+    });
+}
+
+void RenderingEngine::applySnapshot(const SceneSnapshot &snapshot) {
+    if (snapshot.tick == appliedTick) return;
+    PROFILE_SCOPE("apply snapshot");
+    appliedTick = snapshot.tick;
+
+    cameraTrans->SetPosition(snapshot.cameraPosition);
+    cameraTrans->SetRotation(snapshot.cameraRotation);
+    for (const LightSnapshot &light : snapshot.lights) {
+        light.light->GetTransform()->SetPosition(light.position);
+    }
+    // render proxies follow their entity, bounds only when the matrix changed
+    for (const ObjectSnapshot &object : snapshot.objects) {
+        RenderObject &obj = renderObjects[object.renderObject];
+        if (obj.material != object.material) {
+            obj.material = object.material;
+            obj.materialId = materialTable.GetId(object.material);
+        }
+        obj.vao = object.vao;
+        obj.vertexCount = object.vertexCount;
+        obj.cullFace = object.cullFace;
+        obj.occluder = object.occluder;
+        if (obj.model != object.model) setModelMatrix(object.renderObject, object.model);
+    }
 }
 
 void RenderingEngine::renderFrame() {
+    applySnapshot(simulation->Acquire());
+    sceneBvh.Commit();
+    occlusionQuery->BeginFrame(frameIndex);
+    sun->Update(camera, frameIndex);
+    for (int c = 0; c < DirectionalLight::CascadeCount; c++) {
+        cascadeActive[c] = sun->ShouldUpdateCascade(c);
+    }
+    glm::mat4 viewProjection = camera->GetProjectionMatrix() * camera->GetWorldToCameraMatrix();
+    recordPasses(viewProjection);
+    requestTextures();
+
+    // 0. drawing geometry to the sun cascades
+    {
+        PROFILE_GPU_SCOPE(gpuTimer, "cascades");
+        renderCascades();
+    }
+
     // 1. drawing geometry to depth cube map
+    lightCasterCount = 0;
     for (int i = 0; i < lights.size(); i++) {
-        lights[i]->GetTransform()->SetPosition(glm::vec3(cos(time->ElapsedTime() * (0.5f * (i + 1))) * 5.f, 3, sin(time->ElapsedTime() * (0.5f * (i + 1))) * 5.f));
-        lights[i]->RenderToTexture(depth_cubemap_shader);
-        renderScene(depth_cubemap_shader);
+        if (!lights[i]->GetCastShadow()) continue;
+        unsigned int depth_shader = lights[i]->GetShadowFilterMode() == ShadowFilterMode::MOMENT ? depth_moment_shader : depth_cubemap_shader;
+        lightCasterCount += (int)lightCommands[i].Size();
+        PROFILE_GPU_SCOPE(gpuTimer, "point light", i);
+        lights[i]->RenderToTexture(depth_shader);
+        submit(depth_shader, lightCommands[i]);
+        lights[i]->FilterShadowMap(moment_blur_shader, quadVAO);
     }
 
     // 2. drawing to the hdr floating point framebuffer
-    glViewport(0, 0, width, height);
-    glBindFramebuffer(GL_FRAMEBUFFER, camera->GetHDRFBO());
-    glm::vec4 backgroundColor = camera->GetBackgroundColor();
-    glClearColor(backgroundColor.r, backgroundColor.g, backgroundColor.b, backgroundColor.a);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glUseProgram(shadow_cubemap_shader);
-    glUniformMatrix4fv(glGetUniformLocation(shadow_cubemap_shader, "projection"), 1, GL_FALSE, glm::value_ptr(camera->GetProjectionMatrix()));
-    glUniformMatrix4fv(glGetUniformLocation(shadow_cubemap_shader, "view"), 1, GL_FALSE, glm::value_ptr(camera->GetWorldToCameraMatrix()));
-    glUniform3fv(glGetUniformLocation(shadow_cubemap_shader, "viewPos"), 1, glm::value_ptr(cameraTrans->GetPosition()));
-    glUniform1f(glGetUniformLocation(shadow_cubemap_shader, "far_plane"), camera->GetFarClipPlane());
-    for (int i = 0; i < lights.size(); i++) {
-        lights[i]->BindUniform(shadow_cubemap_shader, i);
+    {
+        PROFILE_GPU_SCOPE(gpuTimer, "main");
+        glViewport_profile(0, 0, width, height);
+        glBindFramebuffer_profile(GL_FRAMEBUFFER, camera->GetHDRFBO());
+        glm::vec4 backgroundColor = camera->GetBackgroundColor();
+        glClearColor_profile(backgroundColor.r, backgroundColor.g, backgroundColor.b, backgroundColor.a);
+        glClear_profile(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // one program per litVariant, each needs the pass uniforms of its own
+        uint32_t litKey = litShaderKey(lights, nullptr);
+        bool used[LIT_VARIANTS] = {false, false, false};
+        for (const CommandBuffer *commands : {&cameraCommands, &queryCommands}) {
+            for (const CommandBuffer::Draw &draw : commands->GetDraws()) {
+                if (draw.material) used[litVariant(draw.material)] = true;
+            }
+        }
+        if (used[2]) materialTable.Bind();
+        unsigned int variants[LIT_VARIANTS] = {0, 0, 0};
+        unsigned int litShader = 0;
+        for (int v = 0; v < LIT_VARIANTS; v++) {
+            if (!used[v]) continue;
+            variants[v] = litShaders->Get(litKey | LIT_VARIANT_BITS[v]);
+            if (!variants[v]) continue;
+            litShader = variants[v];
+            glUseProgram_profile(litShader);
+            bindLitUniforms(litShader);
+        }
+        if (litShader) submit(litShader, cameraCommands, variants);
+        if (!queryObjects.empty()) {
+            occlusionQuery->BeginQueries(viewProjection, cameraTrans->GetWorldPosition());
+            for (unsigned int idx : queryObjects) {
+                occlusionQuery->Query(idx, renderObjects[idx].aabbMin, renderObjects[idx].aabbMax);
+            }
+            occlusionQuery->EndQueries();
+            if (litShader) {
+                glUseProgram_profile(litShader);
+                submit(litShader, queryCommands, variants);
+            }
+        }
+        glEnable_profile(GL_DEPTH_TEST);
+        glUseProgram_profile(normal_shader);
+        glBindVertexArray_profile(cubeVAO);
+        glUniformMatrix4fv_profile(glGetUniformLocation(normal_shader, "projection"), 1, GL_FALSE, glm::value_ptr(camera->GetProjectionMatrix()));
+        glUniformMatrix4fv_profile(glGetUniformLocation(normal_shader, "view"), 1, GL_FALSE, glm::value_ptr(camera->GetWorldToCameraMatrix()));
+        for (auto &light : lights) {
+            light->RenderLight(normal_shader);
+        }
+    }
+    {
+        PROFILE_GPU_SCOPE(gpuTimer, "hdr resolve");
+        camera->Render();
     }
-    renderScene(shadow_cubemap_shader);
-    glEnable(GL_DEPTH_TEST);
-    glUseProgram(normal_shader);
-    glBindVertexArray(cubeVAO);
-    glUniformMatrix4fv(glGetUniformLocation(normal_shader, "projection"), 1, GL_FALSE, glm::value_ptr(camera->GetProjectionMatrix()));
-    glUniformMatrix4fv(glGetUniformLocation(normal_shader, "view"), 1, GL_FALSE, glm::value_ptr(camera->GetWorldToCameraMatrix()));
-    for (auto &light : lights) {
-        light->RenderLight(normal_shader);
+    if (cascadeDebugLayer >= 0) {
+        glViewport_profile(width - 256, 0, 256, 256);
+        sun->RenderDebug(depth_visual_shader, quadVAO, cascadeDebugLayer);
+        glViewport_profile(0, 0, width, height);
     }
-    camera->Render();
+    frameIndex++;
+}
+
+void RenderingEngine::setTraceOutput(const std::string &path) {
+    tracePath = path;
+    exportTraceOnExit = true;
+}
+
+void RenderingEngine::setStatsOutput(const std::string &path) { statsPath = path; }
+
+void RenderingEngine::setCaptureOutput(const std::string &path, int frames) {
+    capturePath = path;
+    captureFrames = frames;
+}
+
+void RenderingEngine::setTextureBudget(size_t bytes) { TextureLoader::Get().SetBudget(bytes); }
+
+void RenderingEngine::setStressScene(const StressSceneDesc &desc) {
+    stressScene = desc;
+    stressScene.meshes = std::max(stressScene.meshes, 1);
+    stressScene.materials = std::max(stressScene.materials, 1);
+    // the forward shader has a fixed light array and the hud reads the first light
+    stressScene.lights = std::max(1, std::min(stressScene.lights, (int)MaxPointLights));
+    if (stressScene.lights != desc.lights) std::cout << "stress scene: " << desc.lights << " lights clamped to " << stressScene.lights << std::endl;
 }
 
 void RenderingEngine::Invalidate() { this->isInvalidate = true; }
@@ -399,26 +1401,22 @@ void RenderingEngine::mouseCallback(double x, double y) {
     lastMouseX = x;
     lastMouseY = y;
 
-    cameraTrans->Rotate(Transform::Up, float(-x_offset));
-    cameraTrans->Rotate(cameraTrans->GetRight(), float(y_offset));
+    mouseLook += glm::vec2(float(-x_offset), float(y_offset));
 }
 
 void RenderingEngine::keyboardCallback() {
-    float speed = 2.5f;
-    if (glfwGetKey(mWindow, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) speed = 7.5f;
-    float velocity = speed * time->GetDeltaTime();
-
     if (glfwGetKey(mWindow, GLFW_KEY_9) == GLFW_PRESS) std::cout << std::boolalpha << isFullscreen() << std::endl;
 
-    glm::vec3 forward = cameraTrans->GetForward();
-    glm::vec3 right = cameraTrans->GetRight();
-    glm::vec3 up = cameraTrans->GetUp();
-    if (glfwGetKey(mWindow, GLFW_KEY_W) == GLFW_PRESS) cameraTrans->Translate(forward * velocity);
-    if (glfwGetKey(mWindow, GLFW_KEY_S) == GLFW_PRESS) cameraTrans->Translate(-forward * velocity);
-    if (glfwGetKey(mWindow, GLFW_KEY_A) == GLFW_PRESS) cameraTrans->Translate(-right * velocity);
-    if (glfwGetKey(mWindow, GLFW_KEY_D) == GLFW_PRESS) cameraTrans->Translate(right * velocity);
-    if (glfwGetKey(mWindow, GLFW_KEY_Q) == GLFW_PRESS) cameraTrans->Translate(up * velocity);
-    if (glfwGetKey(mWindow, GLFW_KEY_E) == GLFW_PRESS) cameraTrans->Translate(-up * velocity);
+    // the camera moves on the simulation tick, this only samples the keys
+    glm::vec3 move(0.f);
+    if (glfwGetKey(mWindow, GLFW_KEY_W) == GLFW_PRESS) move.z += 1.f;
+    if (glfwGetKey(mWindow, GLFW_KEY_S) == GLFW_PRESS) move.z -= 1.f;
+    if (glfwGetKey(mWindow, GLFW_KEY_A) == GLFW_PRESS) move.x -= 1.f;
+    if (glfwGetKey(mWindow, GLFW_KEY_D) == GLFW_PRESS) move.x += 1.f;
+    if (glfwGetKey(mWindow, GLFW_KEY_Q) == GLFW_PRESS) move.y += 1.f;
+    if (glfwGetKey(mWindow, GLFW_KEY_E) == GLFW_PRESS) move.y -= 1.f;
+    simulation->AddInput(move, mouseLook, glfwGetKey(mWindow, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS);
+    mouseLook = glm::vec2(0.f);
 
     if (glfwGetKey(mWindow, GLFW_KEY_SPACE) == GLFW_PRESS && !hdrKeyPressed) {
         camera->SetHdr(!camera->IsHdr());
@@ -435,4 +1433,64 @@ void RenderingEngine::keyboardCallback() {
     if (glfwGetKey(mWindow, GLFW_KEY_TAB) == GLFW_RELEASE) {
         useNormalKeyPressed = false;
     }
+
+    if (glfwGetKey(mWindow, GLFW_KEY_M) == GLFW_PRESS && !shadowFilterKeyPressed) {
+        ShadowFilterMode mode = lights[0]->GetShadowFilterMode() == ShadowFilterMode::PCF ? ShadowFilterMode::MOMENT : ShadowFilterMode::PCF;
+        for (auto &light : lights) {
+            if (!light->SetShadowFilterMode(mode)) std::cout << "moment shadow map init failed" << std::endl;
+        }
+        shadowFilterKeyPressed = true;
+    }
+    if (glfwGetKey(mWindow, GLFW_KEY_M) == GLFW_RELEASE) {
+        shadowFilterKeyPressed = false;
+    }
+
+    if (glfwGetKey(mWindow, GLFW_KEY_C) == GLFW_PRESS && !cascadeDebugKeyPressed) {
+        cascadeDebugLayer = cascadeDebugLayer + 1 < DirectionalLight::CascadeCount ? cascadeDebugLayer + 1 : -1;
+        cascadeDebugKeyPressed = true;
+    }
+    if (glfwGetKey(mWindow, GLFW_KEY_C) == GLFW_RELEASE) {
+        cascadeDebugKeyPressed = false;
+    }
+
+    if (glfwGetKey(mWindow, GLFW_KEY_G) == GLFW_PRESS && !cascadeSkipKeyPressed) {
+        sun->SetUpdateDistantCascadesEveryOtherFrame(!sun->GetUpdateDistantCascadesEveryOtherFrame());
+        cascadeSkipKeyPressed = true;
+    }
+    if (glfwGetKey(mWindow, GLFW_KEY_G) == GLFW_RELEASE) {
+        cascadeSkipKeyPressed = false;
+    }
+
+    if (glfwGetKey(mWindow, GLFW_KEY_O) == GLFW_PRESS && !occlusionKeyPressed) {
+        camera->SetUseOcclusionCulling(!camera->GetUseOcclusionCulling());
+        occlusionKeyPressed = true;
+    }
+    if (glfwGetKey(mWindow, GLFW_KEY_O) == GLFW_RELEASE) {
+        occlusionKeyPressed = false;
+    }
+
+    if (glfwGetKey(mWindow, GLFW_KEY_P) == GLFW_PRESS && !traceKeyPressed) {
+        Profiler::Get().ExportChromeTrace(tracePath);
+        traceKeyPressed = true;
+    }
+    if (glfwGetKey(mWindow, GLFW_KEY_P) == GLFW_RELEASE) {
+        traceKeyPressed = false;
+    }
+
+    if (glfwGetKey(mWindow, GLFW_KEY_U) == GLFW_PRESS && !occlusionQueryKeyPressed) {
+        useOcclusionQueries = !useOcclusionQueries;
+        occlusionQueryKeyPressed = true;
+    }
+    if (glfwGetKey(mWindow, GLFW_KEY_U) == GLFW_RELEASE) {
+        occlusionQueryKeyPressed = false;
+    }
+
+    // the cursor drives the camera, so picking shoots through the screen center
+    if (glfwGetMouseButton(mWindow, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && !pickButtonPressed) {
+        pickObject();
+        pickButtonPressed = true;
+    }
+    if (glfwGetMouseButton(mWindow, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE) {
+        pickButtonPressed = false;
+    }
 }
\ No newline at end of file
@@ -8,7 +8,18 @@
 #include <string>
 #include <vector>
 
+#include "Bvh.h"
+#include "CameraPath.h"
+#include "CommandBuffer.h"
+#include "MaterialTable.h"
+#include "Simulation.h"
+#include "StressScene.h"
+#include "Culling.h"
+#include "TransformStore.h"
+#include "components/DirectionalLight.h"
 #include "components/PointLight.h"
+#include "ecs/Components.h"
+#include "ecs/Registry.h"
 
 struct GLFWwindow;
 struct GLFWmonitor;
@@ -17,18 +28,59 @@ class Camera;
 class Transform;
 class Time;
 class Material;
+class JobSystem;
+class OcclusionCulling;
+class OcclusionQuery;
+class GpuTimer;
+class GlReplay;
+class ShaderPermutations;
+namespace obj_parser {
+    struct Bounds;
+}
+
+struct RenderObject {
+    unsigned int vao;
+    int vertexCount;
+    Material* material;
+    unsigned int materialId;  // MaterialTable id
+    glm::mat4 model;
+    glm::vec3 center;  // world space bounding sphere
+    float radius;
+    glm::vec3 aabbMin, aabbMax;  // world space
+    glm::vec3 localMin, localMax, localCenter;
+    float localRadius;
+    float uvDensity;  // uv units per local unit, 0 without uvs
+    unsigned int bvhProxy;
+    bool cullFace;
+    const std::vector<glm::vec3>* occluder;  // simplified triangles for the software occlusion buffer, null if it hides nothing
+    bool queryOcclusion;                     // expensive enough to sit behind a hardware occlusion query
+};
+
 class RenderingEngine {
   public:
-    RenderingEngine();
+    // lit shader variants are built for the exact light count, which has 4 bits of the variant key
+    static const unsigned int MaxPointLights = 8;
+
+    // simulationRate is the fixed tick in Hz, 0 simulates inline once per frame
+    explicit RenderingEngine(unsigned int workers = 0, float simulationRate = 120.f);
     ~RenderingEngine();
 
     bool initWindow(const std::string& title, int w, int h);
+#ifdef DEFERRED_HEADLESS
+    bool initHeadless(int w, int h);
+#endif
     void initVertex();
     bool initShader();
     bool isFullscreen();
     int render();
+    // replays a camera path for a fixed number of frames at a fixed step and prints a summary
+    int runBenchmark(const std::string& pathFile, int frames, bool printHash);
+    // re-issues the frames of a gl capture in a loop for a fixed number of frames, in place of initShader and initVertex
+    int runReplay(GlReplay& replay, int frames);
     void renderFont();
     void renderScene(unsigned int shader);
+    void renderScene(unsigned int shader, const std::vector<unsigned int>& objects);
+    void setModelMatrix(unsigned int object, const glm::mat4& model);
     void renderFrame();
 
     static RenderingEngine* GetInstance() { return instance; }
@@ -36,29 +88,109 @@ class RenderingEngine {
     int GetWidth() const { return width; }
     int GetHeight() const { return height; }
     void Invalidate();
+    // P writes the trace at any time, with an output set it is also written on exit
+    void setTraceOutput(const std::string& path);
+    // per pass statistics are written here on exit, csv or json by extension
+    void setStatsOutput(const std::string& path);
+    // replaces the demo scene with a generated one, before initWindow since the lights and materials are made there
+    void setStressScene(const StressSceneDesc& desc);
+    // records every gl call from context creation to the end of the given frame, before initWindow
+    void setCaptureOutput(const std::string& path, int frames);
+    // gpu bytes streamed textures may take, before initWindow
+    void setTextureBudget(size_t bytes);
 
   private:
+    bool initResources();
+    void initStressScene();
+    void beginFrameLoop();
+    void endFrameLoop();
     void mouseCallback(double xpos, double ypos);
     void keyboardCallback();
+    Entity createMeshEntity(unsigned int vao, int vertexCount, Material* material, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale,
+                            const obj_parser::Bounds& localBounds, bool cullFace, const std::vector<glm::vec3>* occluder);
+    void placeMeshEntities();
+    void addRenderObject(unsigned int vao, int vertexCount, Material* material, const glm::mat4& model, const obj_parser::Bounds& localBounds, bool cullFace,
+                         const std::vector<glm::vec3>* occluder);
+    void bindMaterial(unsigned int shader, const Material* material);
+    void updateWorldBounds(RenderObject& obj);
+    void cullObjects(const glm::mat4& viewProjection, std::vector<unsigned int>& visible);
+    void occludeObjects(const glm::mat4& viewProjection, std::vector<unsigned int>& visible);
+    void pickObject();
+    void recordScene(CommandBuffer& commands, const std::vector<unsigned int>& objects, bool bindMaterials, const glm::mat4* viewProjection, bool conditional) const;
+    void recordPasses(const glm::mat4& viewProjection);
+    // with variants, indexed by litVariant of the material, the program follows the material
+    void submit(unsigned int shader, const CommandBuffer& commands, const unsigned int* variants = nullptr);
+    void bindLitUniforms(unsigned int shader);
+    // texture streaming demand of what the camera sees, from distance and mesh uv density
+    void estimateTextureDemand(const std::vector<unsigned int>& objects);
+    void requestTextures();
+    void renderCascades();
+    void simulate(float dt, const SimulationInput& input, SceneSnapshot& out);
+    void applySnapshot(const SceneSnapshot& snapshot);
 
   private:
     static RenderingEngine* instance;
 
-    unsigned int normal_shader, depth_cubemap_shader, shadow_cubemap_shader;
-    unsigned int cubeVAO, cubeVBO, planeVAO, planeVBO, dragonVAO, dragonVBO;
-    unsigned int gpuTimeProfileQuery, timeElapsed;
+    unsigned int normal_shader, depth_cubemap_shader, depth_moment_shader, moment_blur_shader, cascade_depth_shader, depth_visual_shader;
+    ShaderPermutations* litShaders;  // shaders/point_shadow/shadow_vs and shadow_fs
+    unsigned int cubeVAO, cubeVBO, planeVAO, planeVBO, dragonVAO, dragonVBO, quadVAO, quadVBO;
     int width, height;
     double MouseSensitivity, lastMouseX, lastMouseY;
-    bool hdrKeyPressed, useNormalKeyPressed;
+    glm::vec2 mouseLook;  // yaw and pitch since the last input handed to the simulation
+    bool hdrKeyPressed, useNormalKeyPressed, shadowFilterKeyPressed, cascadeDebugKeyPressed, cascadeSkipKeyPressed, pickButtonPressed, occlusionKeyPressed, occlusionQueryKeyPressed, traceKeyPressed;
+    unsigned long frameIndex;
+    int cascadeDebugLayer;  // -1 when the cascade preview is hidden
+    int cascadeUpdates, cascadeDrawCalls;
+    int cascadeCasters[DirectionalLight::CascadeCount];
+    bool cascadeActive[DirectionalLight::CascadeCount];
 
     GLFWwindow* mWindow;
+    GLFWwindow* compileWindow;                         // hidden, shares objects with mWindow for the shader compile worker
+    void *eglDisplay, *eglContext, *eglCompileContext;  // headless only
+    unsigned int offscreenFBO, offscreenColor, offscreenDepth;
     GLFWmonitor* mMonitor;
     FontRenderer* fontRenderer;
     Camera* camera;
     Transform* cameraTrans;
     Time* time;
     Material *cube1_material, *cube2_material;
+    StressSceneDesc stressScene;  // objects == 0 for the demo scene
+    std::vector<Material*> stressMaterials;
+    std::vector<unsigned int> stressVAOs, stressVBOs;
     std::vector<PointLight*> lights;
+    DirectionalLight* sun;
+    Registry registry;
+    TransformStore transformStore;
+    std::vector<RenderObject> renderObjects;
+    std::vector<unsigned int> allObjects, visibleObjects;
+    MaterialTable materialTable;
+    std::vector<float> materialDemand;  // uv units per pixel on the nearest visible object of each material id
+    // recorded in parallel each frame, replayed on this thread
+    CommandBuffer cascadeCommands[DirectionalLight::CascadeCount];
+    std::vector<CommandBuffer> lightCommands;
+    CommandBuffer cameraCommands, queryCommands;
+    CullingSet objectBounds;
+    Bvh sceneBvh;
+    JobSystem* jobSystem;  // declared before everything that is handed it
+    Simulation* simulation;
+    // owned by the simulation thread once it runs
+    Transform* simulationCamera;
+    float simulationTime;
+    unsigned long appliedTick;
+    CameraPath cameraPath;  // drives camera and lights instead of input when loaded
+    OcclusionCulling* occlusionCulling;
+    OcclusionQuery* occlusionQuery;
+    GpuTimer* gpuTimer;
+    std::string tracePath;
+    bool exportTraceOnExit;
+    std::string statsPath;
+    std::string capturePath;
+    int captureFrames;
+    bool useOcclusionQueries;
+    std::vector<unsigned int> queryObjects;
+    std::vector<glm::vec3> cubeOccluder, planeOccluder;
+    int visibleCount, culledCount, occludedCount, lightCasterCount, pickedObject;
+    float pickedDistance;
     bool isInvalidate;
 };
 
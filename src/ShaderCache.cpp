@@ -0,0 +1,155 @@
+#include "ShaderCache.h"
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "GlCapture.h"
+
+struct ShaderCacheHeader {
+    char magic[4];  // DPGC
+    uint32_t version;
+    uint64_t driver;
+    uint32_t entries;
+    uint32_t reserved;
+};
+
+struct ShaderCacheEntry {
+    uint64_t key;
+    uint32_t format;
+    uint32_t size;
+    float compileMs;
+    uint32_t reserved;
+};
+
+ShaderCache& ShaderCache::Get() {
+    static ShaderCache shaderCache;
+    return shaderCache;
+}
+
+uint64_t ShaderCache::Hash(const void* data, size_t size, uint64_t hash) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+ShaderCache::ShaderCache() : path(), driver(0), enabled(false), dirty(false), entries(), hits(0), misses(0), loadMs(0.0), compileMs(0.0), savedMs(0.0) {}
+
+void ShaderCache::Open(const std::string& path) {
+    this->path = path;
+    entries.clear();
+    GLint formats = 0;
+    if (GLEW_ARB_get_program_binary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    enabled = formats > 0;
+    if (!enabled) {
+        std::cout << "shader cache: no program binary formats, compiling every program" << std::endl;
+        return;
+    }
+    driver = HashSeed;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        const char* text = reinterpret_cast<const char*>(glGetString(name));
+        if (text) driver = Hash(text, std::strlen(text), driver);
+    }
+
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) return;
+    fseek(fp, 0, SEEK_END);
+    long fileSize = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    ShaderCacheHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 || std::memcmp(header.magic, "DPGC", 4) != 0 || header.version != Version) {
+        std::cout << "shader cache: " << path << " is not a version " << Version << " cache, rebuilding" << std::endl;
+    } else if (header.driver != driver) {
+        std::cout << "shader cache: driver changed, rebuilding" << std::endl;
+    } else {
+        for (uint32_t i = 0; i < header.entries; i++) {
+            ShaderCacheEntry e;
+            if (fread(&e, sizeof(e), 1, fp) != 1) break;
+            // a size past the end of the file is a truncated or corrupt cache, not something to allocate
+            long left = fileSize - ftell(fp);
+            if (left < 0 || e.size > (uint64_t)left) {
+                dirty = true;
+                break;
+            }
+            // nothing to load, the program is compiled and stored again
+            if (e.size == 0) continue;
+            Entry& entry = entries[e.key];
+            entry.format = e.format;
+            entry.compileMs = e.compileMs;
+            entry.binary.resize(e.size);
+            if (fread(entry.binary.data(), e.size, 1, fp) != 1) {
+                entries.erase(e.key);
+                dirty = true;
+                break;
+            }
+        }
+    }
+    fclose(fp);
+}
+
+unsigned int ShaderCache::Load(uint64_t key) {
+    // a capture has to see the sources, a replay may well run on another driver
+    if (!enabled || GlCapture::Get().IsActive()) return 0;
+    auto it = entries.find(key);
+    if (it == entries.end()) return 0;
+
+    auto start = std::chrono::steady_clock::now();
+    const Entry& entry = it->second;
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, entry.format, entry.binary.data(), (GLsizei)entry.binary.size());
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glDeleteProgram(program);
+        entries.erase(it);
+        dirty = true;
+        return 0;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    hits++;
+    loadMs += ms;
+    savedMs += entry.compileMs - ms;
+    return program;
+}
+
+void ShaderCache::Store(uint64_t key, unsigned int program, double compileMs) {
+    misses++;
+    this->compileMs += compileMs;
+    if (!enabled) return;
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0) return;
+    Entry& entry = entries[key];
+    entry.compileMs = (float)compileMs;
+    entry.binary.resize(size);
+    GLenum format = 0;
+    glGetProgramBinary(program, size, nullptr, &format, entry.binary.data());
+    entry.format = format;
+    dirty = true;
+}
+
+void ShaderCache::Save() {
+    if (!enabled || !dirty) return;
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+        std::cout << "shader cache: cannot write " << path << std::endl;
+        return;
+    }
+    ShaderCacheHeader header = {{'D', 'P', 'G', 'C'}, Version, driver, (uint32_t)entries.size(), 0};
+    fwrite(&header, sizeof(header), 1, fp);
+    for (const auto& it : entries) {
+        ShaderCacheEntry e = {it.first, it.second.format, (uint32_t)it.second.binary.size(), it.second.compileMs, 0};
+        fwrite(&e, sizeof(e), 1, fp);
+        fwrite(it.second.binary.data(), it.second.binary.size(), 1, fp);
+    }
+    fclose(fp);
+    dirty = false;
+}
+
+void ShaderCache::PrintSummary() const {
+    std::cout << "shader cache: " << hits << " of " << hits + misses << " programs from " << path << " in " << loadMs << " ms, " << savedMs << " ms of compiling saved, "
+              << compileMs << " ms compiling the rest" << std::endl;
+}
@@ -0,0 +1,50 @@
+#ifndef DEFERRED_SHADERCACHE_H
+#define DEFERRED_SHADERCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// linked program binaries from glGetProgramBinary, kept in one file across runs so a launch on the same driver
+// skips compiling. an entry is keyed by a hash of every stage's final source, defines included; the file also
+// carries a hash of vendor, renderer and version and is dropped whole when the driver differs.
+// a binary the driver rejects anyway is compiled again and replaced.
+class ShaderCache {
+  public:
+    static const uint32_t Version = 1;
+    static const uint64_t HashSeed = 14695981039346656037ull;  // fnv-1a
+
+    static ShaderCache& Get();
+    static uint64_t Hash(const void* data, size_t size, uint64_t hash = HashSeed);
+
+    // after the context is made. without program binary support, or while a gl capture runs, every program is compiled
+    void Open(const std::string& path);
+    bool IsEnabled() const { return enabled; }
+    // a linked program or 0
+    unsigned int Load(uint64_t key);
+    // link with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set, compileMs is what a later hit saves
+    void Store(uint64_t key, unsigned int program, double compileMs);
+    void Save();
+    // hits and misses since Open, and the compile time the hits saved
+    void PrintSummary() const;
+
+  private:
+    struct Entry {
+        uint32_t format;
+        float compileMs;
+        std::vector<uint8_t> binary;
+    };
+
+    ShaderCache();
+
+  private:
+    std::string path;
+    uint64_t driver;
+    bool enabled, dirty;
+    std::unordered_map<uint64_t, Entry> entries;
+    int hits, misses;
+    double loadMs, compileMs, savedMs;
+};
+
+#endif  // DEFERRED_SHADERCACHE_H
@@ -0,0 +1,349 @@
+#include "ShaderCompiler.h"
+
+#include <algorithm>
+#include <future>
+#include <iostream>
+
+#include "GlCapture.h"
+#include "Profiler.h"
+#include "ShaderCache.h"
+#include "util.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+ShaderCompiler& ShaderCompiler::Get() {
+    static ShaderCompiler shaderCompiler;
+    return shaderCompiler;
+}
+
+bool ShaderCompiler::NeedsWorkerContext() { return !GlCapture::Get().IsActive() && !GLEW_KHR_parallel_shader_compile && !GLEW_ARB_parallel_shader_compile; }
+
+ShaderCompiler::ShaderCompiler()
+    : mode(Mode::Immediate), generation(0), jobs(), watches(), worker(), mutex(), queued(), finished(), queue(), stopping(false), notify(-1), directories() {}
+
+ShaderCompiler::~ShaderCompiler() { Shutdown(); }
+
+void ShaderCompiler::Init(const WorkerContextFn& workerContext) {
+    if (GlCapture::Get().IsActive()) {
+        // the capture hooks are plain globals, gl calls from another thread would interleave with the render thread's
+        mode = Mode::Immediate;
+    } else if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        mode = Mode::Parallel;
+    } else if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        mode = Mode::Parallel;
+    } else if (workerContext) {
+        std::promise<bool> bound;
+        std::future<bool> result = bound.get_future();
+        stopping = false;
+        worker = std::thread([this, workerContext, &bound]() {
+            bool current = workerContext(true);
+            bound.set_value(current);
+            if (current) WorkerLoop(workerContext);
+        });
+        if (result.get()) {
+            mode = Mode::Worker;
+        } else {
+            worker.join();
+            mode = Mode::Immediate;
+        }
+    }
+    const char* names[] = {"on the render thread", "on driver threads", "on a worker thread"};
+    std::cout << "shaders build " << names[(int)mode] << std::endl;
+
+#ifdef __linux__
+    notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notify < 0) std::cout << "inotify unavailable, shaders won't reload" << std::endl;
+#endif
+}
+
+void ShaderCompiler::Shutdown() {
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queued.notify_all();
+        worker.join();
+    }
+    for (Job* job : jobs) {
+        for (Stage& stage : job->stages) glDeleteShader(stage.shader);
+        glDeleteProgram(job->program);
+        delete job;
+    }
+    jobs.clear();
+    queue.clear();
+    watches.clear();
+#ifdef __linux__
+    if (notify >= 0) close(notify);
+#endif
+    notify = -1;
+    directories.clear();
+    mode = Mode::Immediate;
+}
+
+void ShaderCompiler::Build(unsigned int* program, const std::string& vs, const std::string& gs, const std::string& fs, const std::string& defines) {
+    Watch& watch = watches[program];
+    watch.vs = vs;
+    watch.gs = gs;
+    watch.fs = fs;
+    watch.defines = defines;
+    watch.files = {vs, gs, fs};
+    Submit(program, watch);
+}
+
+void ShaderCompiler::Release(unsigned int* program) { watches.erase(program); }
+
+bool ShaderCompiler::IsPending(const unsigned int* program) const {
+    for (const Job* job : jobs) {
+        if (job->target == program) return true;
+    }
+    return false;
+}
+
+bool ShaderCompiler::Wait(unsigned int* program) {
+    for (size_t i = 0; i < jobs.size();) {
+        Job* job = jobs[i];
+        if (job->target != program) {
+            i++;
+            continue;
+        }
+        WaitFor(job);
+        jobs.erase(jobs.begin() + i);
+        Finish(job);
+    }
+    return *program != 0;
+}
+
+bool ShaderCompiler::WaitAll() {
+    while (!jobs.empty()) {
+        Job* job = jobs.front();
+        WaitFor(job);
+        jobs.erase(jobs.begin());
+        Finish(job);
+    }
+    for (auto& it : watches) {
+        if (!*it.first) return false;
+    }
+    return true;
+}
+
+void ShaderCompiler::Update() {
+    bool finishedAny = false;
+    for (size_t i = 0; i < jobs.size();) {
+        Job* job = jobs[i];
+        if (!IsFinished(job)) {
+            i++;
+            continue;
+        }
+        jobs.erase(jobs.begin() + i);
+        Finish(job);
+        finishedAny = true;
+    }
+    // once a batch is through, so background variants and reloads are cached without rewriting the file per program
+    if (finishedAny && jobs.empty()) ShaderCache::Get().Save();
+    PollFiles();
+}
+
+void ShaderCompiler::Submit(unsigned int* program, Watch& watch) {
+    Job* job = new Job();
+    job->target = program;
+    job->generation = watch.generation = ++generation;
+    const std::string* names[] = {&watch.vs, &watch.gs, &watch.fs};
+    const GLenum types[] = {GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER};
+    std::vector<std::string> files;
+    for (int i = 0; i < 3; i++) {
+        if (names[i]->empty()) continue;
+        job->stages.push_back({types[i], *names[i], "", 0});
+        if (!loadShaderSource(*names[i], watch.defines, job->stages.back().source, &files)) {
+            // the files of the last good read stay watched, fixing the one that failed brings the program back
+            delete job;
+            return;
+        }
+    }
+    watch.files = files;
+    WatchFiles(files);
+
+    ShaderCache& cache = ShaderCache::Get();
+    job->key = ShaderCache::HashSeed;
+    for (const Stage& stage : job->stages) {
+        job->key = ShaderCache::Hash(&stage.type, sizeof(GLenum), job->key);
+        job->key = ShaderCache::Hash(stage.source.data(), stage.source.size(), job->key);
+    }
+    job->program = cache.Load(job->key);
+    job->retrievable = cache.IsEnabled();
+    job->done = job->linked = job->program != 0;
+    job->start = std::chrono::steady_clock::now();
+    if (job->done) {
+        Finish(job);
+        return;
+    }
+
+    switch (mode) {
+        case Mode::Immediate:
+            Compile(job);
+            job->linked = Check(job);
+            Finish(job);
+            return;
+        case Mode::Parallel:
+            // status queries would block until the driver threads are done, IsFinished polls instead
+            Compile(job);
+            break;
+        case Mode::Worker: {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(job);
+            queued.notify_one();
+            break;
+        }
+    }
+    jobs.push_back(job);
+}
+
+void ShaderCompiler::Compile(Job* job) {
+    job->program = glCreateProgram();
+    if (job->retrievable) glProgramParameteri(job->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    for (Stage& stage : job->stages) {
+        stage.shader = glCreateShader(stage.type);
+        const char* source = stage.source.c_str();
+        glShaderSource(stage.shader, 1, &source, NULL);
+        glCompileShader(stage.shader);
+        glAttachShader(job->program, stage.shader);
+    }
+    glLinkProgram(job->program);
+}
+
+bool ShaderCompiler::Check(Job* job) {
+    int success;
+    char infoLog[512];
+    // check for shader compile errors
+    for (const Stage& stage : job->stages) {
+        glGetShaderiv(stage.shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(stage.shader, 512, NULL, infoLog);
+            job->log += "shader compile error in " + stage.name + "\n" + infoLog + "\n";
+        }
+    }
+    if (!job->log.empty()) return false;
+    // check for linking errors
+    glGetProgramiv(job->program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(job->program, 512, NULL, infoLog);
+        job->log += "program linking error with " + job->stages[0].name;
+        for (size_t i = 1; i < job->stages.size(); i++) job->log += " and " + job->stages[i].name;
+        job->log += "\n" + std::string(infoLog) + "\n";
+    }
+    return success != 0;
+}
+
+bool ShaderCompiler::IsFinished(Job* job) {
+    if (mode == Mode::Parallel) {
+        int complete = 0;
+        glGetProgramiv(job->program, GL_COMPLETION_STATUS_KHR, &complete);
+        if (!complete) return false;
+        job->linked = Check(job);
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    return job->done;
+}
+
+void ShaderCompiler::WaitFor(Job* job) {
+    if (mode == Mode::Parallel) {
+        job->linked = Check(job);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [job]() { return job->done; });
+}
+
+void ShaderCompiler::Finish(Job* job) {
+    PROFILE_SCOPE("finish shader build");
+    for (Stage& stage : job->stages) glDeleteShader(stage.shader);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job->start).count();
+    auto it = watches.find(job->target);
+    bool current = it != watches.end() && it->second.generation == job->generation;
+    if (!job->linked) {
+        std::cout << job->log;
+        if (current && *job->target) std::cout << "keeping the previous program" << std::endl;
+        glDeleteProgram(job->program);
+    } else if (!current) {
+        // released, or a newer build of the same program was submitted meanwhile
+        glDeleteProgram(job->program);
+    } else {
+        // compiled rather than loaded from the cache
+        if (job->stages[0].shader) ShaderCache::Get().Store(job->key, job->program, ms);
+        if (*job->target) {
+            std::cout << "reloaded " << job->stages.back().name << " in " << ms << " ms" << std::endl;
+            glDeleteProgram(*job->target);
+        }
+        *job->target = job->program;
+    }
+    delete job;
+}
+
+void ShaderCompiler::WorkerLoop(WorkerContextFn workerContext) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        queued.wait(lock, [this]() { return stopping || !queue.empty(); });
+        if (stopping) break;
+        Job* job = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        Compile(job);
+        bool linked = Check(job);
+        // objects are shared, but the render context only sees a finished program
+        glFinish();
+        lock.lock();
+        job->linked = linked;
+        job->done = true;
+        finished.notify_all();
+    }
+    lock.unlock();
+    workerContext(false);
+}
+
+void ShaderCompiler::WatchFiles(const std::vector<std::string>& files) {
+#ifdef __linux__
+    if (notify < 0) return;
+    for (const std::string& file : files) {
+        if (file.empty()) continue;
+        std::string directory = file.substr(0, file.find_last_of('/') + 1);
+        bool watched = false;
+        for (auto& it : directories) watched = watched || it.second == directory;
+        if (watched) continue;
+        // editors that save by renaming a temporary file show up as IN_MOVED_TO
+        int wd = inotify_add_watch(notify, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd >= 0) directories[wd] = directory;
+    }
+#endif
+}
+
+void ShaderCompiler::PollFiles() {
+#ifdef __linux__
+    if (notify < 0) return;
+    std::vector<std::string> changed;
+    alignas(inotify_event) char buffer[4096];
+    ssize_t size;
+    while ((size = read(notify, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + size;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            auto it = directories.find(event->wd);
+            if (event->len && it != directories.end()) changed.push_back(it->second + event->name);
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+    if (changed.empty()) return;
+    // one rebuild per program however many of its files were saved this frame
+    for (auto& it : watches) {
+        for (const std::string& file : it.second.files) {
+            if (std::find(changed.begin(), changed.end(), file) == changed.end()) continue;
+            Submit(it.first, it.second);
+            break;
+        }
+    }
+#endif
+}
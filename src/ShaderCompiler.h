@@ -0,0 +1,106 @@
+#ifndef DEFERRED_SHADERCOMPILER_H
+#define DEFERRED_SHADERCOMPILER_H
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// program builds off the render thread's critical path. with GL_KHR/ARB_parallel_shader_compile the driver compiles
+// on its own threads and completion is polled, otherwise a worker thread with a shared context builds them; without
+// either (or while a gl capture runs) a build finishes inside Build. a program handed to Build is written once its
+// build links and keeps its previous value until then, so a failed rebuild leaves the old program in use. every file
+// a program reads, includes too, is watched (inotify) and only the programs that read a changed file are rebuilt.
+class ShaderCompiler {
+  public:
+    enum class Mode { Immediate, Parallel, Worker };
+    // makes the context that shares objects with the render context current on the calling thread (true), or
+    // releases it again (false)
+    typedef std::function<bool(bool current)> WorkerContextFn;
+
+    static ShaderCompiler& Get();
+    // whether Init would use a worker, so the engine only makes the shared context when it is needed
+    static bool NeedsWorkerContext();
+
+    // after the context is made and GlCapture started, before the first Build
+    void Init(const WorkerContextFn& workerContext);
+    // joins the worker and drops the builds still running, before the context goes
+    void Shutdown();
+    Mode GetMode() const { return mode; }
+
+    // gs may be empty. *program must stay at the same address until Release
+    void Build(unsigned int* program, const std::string& vs, const std::string& gs, const std::string& fs, const std::string& defines = "");
+    // stops watching, a build still running for it is dropped when it finishes. the program itself stays the caller's
+    void Release(unsigned int* program);
+    bool IsPending(const unsigned int* program) const;
+    // blocks until the builds of *program finished, false when it has no program
+    bool Wait(unsigned int* program);
+    // every build, false when any program has none
+    bool WaitAll();
+    // render thread, once a frame: finished builds are swapped in and programs reading a changed file rebuilt.
+    // new binaries are saved to the shader cache whenever no build is left running
+    void Update();
+
+  private:
+    struct Stage {
+        GLenum type;
+        std::string name;
+        std::string source;
+        unsigned int shader;
+    };
+
+    struct Job {
+        unsigned int* target;
+        uint64_t generation;
+        uint64_t key;
+        std::vector<Stage> stages;
+        unsigned int program;
+        bool retrievable;
+        bool done, linked;  // set by the worker
+        std::string log;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    struct Watch {
+        std::string vs, gs, fs, defines;
+        std::vector<std::string> files;  // read by the last build
+        uint64_t generation;             // of the last build submitted, older ones are dropped
+    };
+
+    ShaderCompiler();
+    ~ShaderCompiler();
+    void Submit(unsigned int* program, Watch& watch);
+    static void Compile(Job* job);
+    static bool Check(Job* job);
+    bool IsFinished(Job* job);
+    void WaitFor(Job* job);
+    void Finish(Job* job);
+    void WorkerLoop(WorkerContextFn workerContext);
+    void WatchFiles(const std::vector<std::string>& files);
+    void PollFiles();
+
+  private:
+    Mode mode;
+    uint64_t generation;
+    std::vector<Job*> jobs;  // submitted and not finished yet, in order
+    std::unordered_map<unsigned int*, Watch> watches;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable queued, finished;
+    std::deque<Job*> queue;
+    bool stopping;
+
+    int notify;                                       // inotify descriptor, -1 without file watching
+    std::unordered_map<int, std::string> directories;  // watch descriptor to directory, with its trailing /
+};
+
+#endif  // DEFERRED_SHADERCOMPILER_H
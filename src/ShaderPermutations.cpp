@@ -0,0 +1,52 @@
+#include "ShaderPermutations.h"
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <iostream>
+
+#include "ShaderCompiler.h"
+
+ShaderPermutations::ShaderPermutations(const std::string& vs_name, const std::string& fs_name, DefinesFn defines)
+    : vs_name(vs_name), fs_name(fs_name), defines(defines), programs(), stalled(), failed() {}
+
+ShaderPermutations::~ShaderPermutations() {
+    for (auto& it : programs) {
+        ShaderCompiler::Get().Release(&it.second);
+        glDeleteProgram(it.second);
+    }
+}
+
+unsigned int ShaderPermutations::Get(uint32_t key) {
+    auto it = programs.find(key);
+    if (it == programs.end() || (!it->second && ShaderCompiler::Get().IsPending(&it->second))) {
+        // not built yet, this frame pays for it
+        auto start = std::chrono::steady_clock::now();
+        Request(key);
+        Wait(key);
+        // said once per variant, a variant that keeps failing on reload would stall every frame otherwise
+        if (stalled.insert(key).second) {
+            std::cout << "shader variant " << std::hex << key << std::dec << " of " << fs_name << " waited for "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+        }
+    }
+    // a failed build is kept as 0 so it is not retried every frame, and reported once
+    unsigned int program = programs[key];
+    if (!program && failed.insert(key).second) std::cout << "shader variant " << std::hex << key << std::dec << " of " << fs_name << " failed to build, its draws are skipped" << std::endl;
+    return program;
+}
+
+bool ShaderPermutations::IsReady(uint32_t key) const {
+    auto it = programs.find(key);
+    return it != programs.end() && it->second != 0;
+}
+
+void ShaderPermutations::Request(uint32_t key) {
+    if (programs.count(key)) return;
+    ShaderCompiler::Get().Build(&programs[key], vs_name, "", fs_name, defines(key));
+}
+
+bool ShaderPermutations::Wait(uint32_t key) {
+    auto it = programs.find(key);
+    return it != programs.end() && ShaderCompiler::Get().Wait(&it->second);
+}
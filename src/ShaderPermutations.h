@@ -0,0 +1,36 @@
+#ifndef DEFERRED_SHADERPERMUTATIONS_H
+#define DEFERRED_SHADERPERMUTATIONS_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// specialized programs of one vertex/fragment pair. a key packs the features a draw needs, defines() turns it into
+// the #define block the sources are built with, so the shader branches on constants the compiler folds away.
+// variants expected soon are requested and built by the ShaderCompiler in the background, a variant asked for
+// before its build finished is waited for.
+class ShaderPermutations {
+  public:
+    typedef std::string (*DefinesFn)(uint32_t key);
+
+    ShaderPermutations(const std::string& vs_name, const std::string& fs_name, DefinesFn defines);
+    ~ShaderPermutations();
+
+    // 0 when the variant fails to build, the caller skips what it would draw
+    unsigned int Get(uint32_t key);
+    bool IsReady(uint32_t key) const;
+    void Request(uint32_t key);
+    // blocks until the variant is built, false when it failed
+    bool Wait(uint32_t key);
+    int GetVariantCount() const { return (int)programs.size(); }
+
+  private:
+    std::string vs_name, fs_name;
+    DefinesFn defines;
+    // the compiler writes into these, the elements of an unordered_map stay put
+    std::unordered_map<uint32_t, unsigned int> programs;
+    std::unordered_set<uint32_t> stalled, failed;  // variants already logged
+};
+
+#endif  // DEFERRED_SHADERPERMUTATIONS_H
@@ -0,0 +1,72 @@
+#include "Simulation.h"
+
+#include <chrono>
+
+#include "Profiler.h"
+
+Simulation::Simulation(float tickRate)
+    : tickRate(tickRate), tick(), snapshots(), writeIndex(0), readIndex(2), latest(1), inputMutex(), pendingInput(), tickCount(0), running(false), thread() {}
+
+Simulation::~Simulation() { Stop(); }
+
+void Simulation::Start(TickFunction func) {
+    tick = func;
+    Tick(IsThreaded() ? 1.f / tickRate : 0.f);
+    if (IsThreaded()) {
+        running = true;
+        thread = std::thread(&Simulation::ThreadLoop, this);
+    }
+}
+
+void Simulation::Stop() {
+    running = false;
+    if (thread.joinable()) thread.join();
+}
+
+void Simulation::Step(float dt) {
+    if (!IsThreaded()) Tick(dt);
+}
+
+void Simulation::AddInput(const glm::vec3& move, const glm::vec2& look, bool fast) {
+    std::lock_guard<std::mutex> lock(inputMutex);
+    pendingInput.move = move;
+    pendingInput.look += look;
+    pendingInput.fast = fast;
+}
+
+const SceneSnapshot& Simulation::Acquire() {
+    if (latest.load(std::memory_order_relaxed) & NEW_BIT) {
+        readIndex = latest.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+    return snapshots[readIndex];
+}
+
+void Simulation::ThreadLoop() {
+    Profiler::Get().SetThreadName("simulation");
+    typedef std::chrono::steady_clock Clock;
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / tickRate));
+    Clock::time_point next = Clock::now() + period;
+    while (running) {
+        std::this_thread::sleep_until(next);
+        Tick(1.f / tickRate);
+        next += period;
+        // after a stall start over instead of running a burst of catch up ticks
+        if (Clock::now() > next + period * 4) next = Clock::now() + period;
+    }
+}
+
+void Simulation::Tick(float dt) {
+    PROFILE_SCOPE("simulation tick");
+    SimulationInput input;
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        input = pendingInput;
+        pendingInput.look = glm::vec2(0.f);
+    }
+    SceneSnapshot& out = snapshots[writeIndex];
+    unsigned long ticks = tickCount.load(std::memory_order_relaxed) + 1;
+    out.tick = ticks;
+    tick(dt, input, out);
+    writeIndex = latest.exchange(writeIndex | NEW_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    tickCount.store(ticks, std::memory_order_relaxed);
+}
@@ -0,0 +1,96 @@
+#ifndef DEFERRED_SIMULATION_H
+#define DEFERRED_SIMULATION_H
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <atomic>
+#include <functional>
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Material;
+class PointLight;
+
+// what the window saw since the last tick, sampled on the main thread
+struct SimulationInput {
+    SimulationInput() : move(0.f), look(0.f), fast(false) {}
+    glm::vec3 move;  // right, up, forward in -1..1
+    glm::vec2 look;  // accumulated yaw and pitch in radians
+    bool fast;
+};
+
+struct ObjectSnapshot {
+    unsigned int renderObject;
+    unsigned int vao;
+    int vertexCount;
+    Material* material;
+    bool cullFace;
+    const std::vector<glm::vec3>* occluder;
+    glm::mat4 model;
+};
+
+struct LightSnapshot {
+    PointLight* light;
+    glm::vec3 position;
+};
+
+// everything the renderer needs from one simulation tick. it is never written once published
+struct SceneSnapshot {
+    SceneSnapshot() : tick(0), time(0.f), cameraPosition(0.f), cameraRotation(1.f, 0.f, 0.f, 0.f), lights(), objects() {}
+    unsigned long tick;
+    float time;  // simulated seconds
+    glm::vec3 cameraPosition;
+    glm::quat cameraRotation;
+    std::vector<LightSnapshot> lights;
+    std::vector<ObjectSnapshot> objects;
+};
+
+// runs the scene update on its own thread at a fixed tick and hands the renderer the newest finished snapshot.
+// snapshots are triple buffered: the simulation always has a slot to write, the renderer keeps the one it reads and
+// the third holds the latest published tick, so neither side ever waits for the other.
+// with a tick rate of 0 there is no thread and Step runs one tick per frame with the frame delta.
+class Simulation {
+  public:
+    typedef std::function<void(float dt, const SimulationInput& input, SceneSnapshot& out)> TickFunction;
+
+    static constexpr int BufferCount = 3;
+
+    explicit Simulation(float tickRate);
+    ~Simulation();
+
+    // runs the first tick inline so a snapshot exists before the first frame
+    void Start(TickFunction func);
+    void Stop();
+    void Step(float dt);
+
+    // input accumulates until the next tick consumes it
+    void AddInput(const glm::vec3& move, const glm::vec2& look, bool fast);
+    // the snapshot stays valid and unchanged until the next Acquire
+    const SceneSnapshot& Acquire();
+
+    bool IsThreaded() const { return tickRate > 0.f; }
+    float GetTickRate() const { return tickRate; }
+    unsigned long GetTickCount() const { return tickCount.load(std::memory_order_relaxed); }
+
+  private:
+    enum : unsigned int { INDEX_MASK = 3, NEW_BIT = 4 };
+
+    void ThreadLoop();
+    void Tick(float dt);
+
+  private:
+    float tickRate;
+    TickFunction tick;
+    SceneSnapshot snapshots[BufferCount];
+    unsigned int writeIndex, readIndex;  // owned by the simulation and the renderer
+    std::atomic<unsigned int> latest;    // index of the newest snapshot, NEW_BIT until the renderer takes it
+    std::mutex inputMutex;
+    SimulationInput pendingInput;
+    std::atomic<unsigned long> tickCount;
+    std::atomic<bool> running;
+    std::thread thread;
+};
+
+#endif  // DEFERRED_SIMULATION_H
@@ -0,0 +1,122 @@
+#include "StressScene.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <sstream>
+
+namespace stress_scene {
+    StressSceneDesc defaults() { return {1000, 8, 3, 1.f, 8, 1}; }
+
+    bool parse(const std::string& spec, StressSceneDesc& desc) {
+        std::istringstream in(spec);
+        std::string item;
+        while (std::getline(in, item, ',')) {
+            if (item.empty()) continue;
+            size_t eq = item.find('=');
+            if (eq == std::string::npos) {
+                std::cout << "stress scene: expected key=value, got " << item << std::endl;
+                return false;
+            }
+            std::string key = item.substr(0, eq);
+            const char* value = item.c_str() + eq + 1;
+            char* end = nullptr;
+            double number = std::strtod(value, &end);
+            if (end == value || *end != '\0' || number < 0.0) {
+                std::cout << "stress scene: bad value for " << key << ": " << value << std::endl;
+                return false;
+            }
+            if (key == "objects") {
+                desc.objects = (int)number;
+            } else if (key == "meshes") {
+                desc.meshes = (int)number;
+            } else if (key == "lights") {
+                desc.lights = (int)number;
+            } else if (key == "shadowed") {
+                desc.shadowedFraction = glm::clamp((float)number, 0.f, 1.f);
+            } else if (key == "materials") {
+                desc.materials = (int)number;
+            } else if (key == "seed") {
+                desc.seed = (unsigned int)number;
+            } else {
+                std::cout << "stress scene: unknown key " << key << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string toString(const StressSceneDesc& desc) {
+        char text[128];
+        snprintf(text, sizeof(text), "objects=%d,meshes=%d,lights=%d,shadowed=%.2f,materials=%d,seed=%u", desc.objects, desc.meshes, desc.lights, desc.shadowedFraction,
+                 desc.materials, desc.seed);
+        return text;
+    }
+
+    static void addVertex(std::vector<float>& vertices, const glm::vec3& position, const glm::vec3& normal, const glm::vec2& uv, const glm::vec3& tangent) {
+        const float v[VERTEX_STRIDE] = {position.x, position.y, position.z, normal.x, normal.y, normal.z, uv.x, uv.y, tangent.x, tangent.y, tangent.z};
+        vertices.insert(vertices.end(), v, v + VERTEX_STRIDE);
+    }
+
+    static void addTriangle(std::vector<float>& vertices, const glm::vec3* p, const glm::vec2* uv) {
+        glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+        if (glm::dot(normal, normal) < 1e-12f) return;  // collapsed at a pole
+        normal = glm::normalize(normal);
+        glm::vec3 tangent = glm::cross(glm::vec3(0.f, 1.f, 0.f), normal);
+        tangent = glm::dot(tangent, tangent) > 1e-6f ? glm::normalize(tangent) : glm::vec3(1.f, 0.f, 0.f);
+        for (int i = 0; i < 3; i++) addVertex(vertices, p[i], normal, uv[i], tangent);
+    }
+
+    void generateMesh(int variant, std::vector<float>& vertices) {
+        const float PI = 3.14159265358979f;
+        const int rings = 6 + (variant * 5) % 19;
+        const int segments = rings * 2;
+        const float frequency = (float)(2 + variant % 5);
+        const float amplitude = 0.08f + 0.04f * (float)(variant % 3);
+
+        auto point = [&](int ring, int segment) {
+            float theta = PI * ring / rings;
+            float phi = 2.f * PI * segment / segments;
+            float r = 1.f + amplitude * std::sin(frequency * theta) * std::cos(frequency * phi);
+            return glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)) * r;
+        };
+        auto texcoord = [&](int ring, int segment) { return glm::vec2((float)segment / segments, (float)ring / rings); };
+
+        vertices.clear();
+        vertices.reserve((size_t)rings * segments * 6 * VERTEX_STRIDE);
+        for (int i = 0; i < rings; i++) {
+            for (int j = 0; j < segments; j++) {
+                // counter clockwise seen from outside, like the obj meshes
+                glm::vec3 a = point(i, j), b = point(i + 1, j), c = point(i + 1, j + 1), d = point(i, j + 1);
+                glm::vec2 ta = texcoord(i, j), tb = texcoord(i + 1, j), tc = texcoord(i + 1, j + 1), td = texcoord(i, j + 1);
+                const glm::vec3 first[3] = {a, c, b};
+                const glm::vec2 firstUv[3] = {ta, tc, tb};
+                const glm::vec3 second[3] = {a, d, c};
+                const glm::vec2 secondUv[3] = {ta, td, tc};
+                addTriangle(vertices, first, firstUv);
+                addTriangle(vertices, second, secondUv);
+            }
+        }
+    }
+
+    void generateTexture(int variant, std::vector<unsigned char>& rgba) {
+        // golden ratio steps spread the hues of neighbouring variants
+        float hue = std::fmod(0.61803398875f * (float)variant, 1.f) * 6.f;
+        glm::vec3 color = glm::clamp(glm::vec3(std::fabs(hue - 3.f) - 1.f, 2.f - std::fabs(hue - 2.f), 2.f - std::fabs(hue - 4.f)), 0.f, 1.f);
+        color = glm::mix(glm::vec3(1.f), color, 0.7f);
+
+        rgba.resize((size_t)TEXTURE_SIZE * TEXTURE_SIZE * 4);
+        for (int y = 0; y < TEXTURE_SIZE; y++) {
+            for (int x = 0; x < TEXTURE_SIZE; x++) {
+                float shade = ((x / 8 + y / 8) & 1) ? 1.f : 0.6f;
+                unsigned char* texel = &rgba[((size_t)y * TEXTURE_SIZE + x) * 4];
+                texel[0] = (unsigned char)(255.f * color.r * shade);
+                texel[1] = (unsigned char)(255.f * color.g * shade);
+                texel[2] = (unsigned char)(255.f * color.b * shade);
+                texel[3] = 255;
+            }
+        }
+    }
+}  // namespace stress_scene
@@ -0,0 +1,35 @@
+#ifndef DEFERRED_STRESSSCENE_H
+#define DEFERRED_STRESSSCENE_H
+
+#include <string>
+#include <vector>
+
+// a procedurally generated scene for scalability runs, scattered over the floor from a fixed seed so the same
+// parameters always give the same scene. objects == 0 keeps the hand built demo scene.
+struct StressSceneDesc {
+    int objects;
+    int meshes;              // unique vaos the objects are spread over
+    int lights;              // point lights, at most RenderingEngine::MaxPointLights
+    float shadowedFraction;  // of the point lights that render a shadow cubemap
+    int materials;           // unique diffuse textures
+    unsigned int seed;
+};
+
+namespace stress_scene {
+    // interleaved like the obj meshes: position, normal, uv, tangent
+    const int VERTEX_STRIDE = 11;
+    const int TEXTURE_SIZE = 64;
+
+    StressSceneDesc defaults();
+    // comma separated key=value, e.g. "objects=4000,meshes=16,lights=4,shadowed=0.5,materials=32,seed=7".
+    // keys left out keep their current value
+    bool parse(const std::string& spec, StressSceneDesc& desc);
+    std::string toString(const StressSceneDesc& desc);
+
+    // a bumped sphere, the variant picks tessellation and bump frequency so every mesh differs in size and shape
+    void generateMesh(int variant, std::vector<float>& vertices);
+    // rgba8 checker in a color of its own
+    void generateTexture(int variant, std::vector<unsigned char>& rgba);
+}  // namespace stress_scene
+
+#endif  // DEFERRED_STRESSSCENE_H
@@ -0,0 +1,344 @@
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace texture_cooker {
+    static const float PI = 3.14159265358979f;
+
+    struct Tap {
+        int index;
+        float weight;
+    };
+
+    static float srgbToLinear(float c) { return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f); }
+
+    static float linearToSrgb(float c) { return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f; }
+
+    static float support(MipFilter filter) { return filter == MipFilter::Box ? 0.5f : 2.f; }
+
+    // x in destination texels
+    static float kernel(MipFilter filter, float x) {
+        x = std::fabs(x);
+        if (filter == MipFilter::Box) return x < 0.5f ? 1.f : x == 0.5f ? 0.5f : 0.f;
+        if (x < 1e-5f) return 1.f;
+        if (x >= 2.f) return 0.f;
+        float px = PI * x;
+        return 2.f * std::sin(px) * std::sin(px * 0.5f) / (px * px);
+    }
+
+    // the source texels each destination texel of one axis reads, weights summing to 1
+    static void buildTaps(int length, int outLength, MipFilter filter, std::vector<std::vector<Tap>>& taps) {
+        float scale = (float)length / outLength;
+        float radius = support(filter) * scale;
+        taps.assign(outLength, {});
+        for (int i = 0; i < outLength; i++) {
+            float center = (i + 0.5f) * scale;
+            float sum = 0.f;
+            for (int j = (int)std::floor(center - radius); j < (int)std::ceil(center + radius); j++) {
+                float weight = kernel(filter, (j + 0.5f - center) / scale);
+                if (weight == 0.f) continue;
+                taps[i].push_back({((j % length) + length) % length, weight});
+                sum += weight;
+            }
+            for (Tap& tap : taps[i]) tap.weight /= sum;
+        }
+    }
+
+    static void resample(const std::vector<float>& in, int width, int height, int stride, int outWidth, int outHeight, MipFilter filter, std::vector<float>& out) {
+        std::vector<std::vector<Tap>> taps;
+        std::vector<float> rows((size_t)outWidth * height * stride, 0.f);
+        buildTaps(width, outWidth, filter, taps);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < outWidth; x++) {
+                float* dst = &rows[((size_t)y * outWidth + x) * stride];
+                for (const Tap& tap : taps[x]) {
+                    const float* src = &in[((size_t)y * width + tap.index) * stride];
+                    for (int c = 0; c < stride; c++) dst[c] += src[c] * tap.weight;
+                }
+            }
+        }
+        out.assign((size_t)outWidth * outHeight * stride, 0.f);
+        buildTaps(height, outHeight, filter, taps);
+        for (int y = 0; y < outHeight; y++) {
+            float* dst = &out[(size_t)y * outWidth * stride];
+            for (const Tap& tap : taps[y]) {
+                const float* src = &rows[(size_t)tap.index * outWidth * stride];
+                for (size_t i = 0; i < (size_t)outWidth * stride; i++) dst[i] += src[i] * tap.weight;
+            }
+        }
+    }
+
+    // what the filter averages: linear light for srgb, vectors in [-1, 1] for normal maps
+    static void decodeLevel(const unsigned char* texels, size_t count, int stride, TextureUsage usage, std::vector<float>& out) {
+        out.resize(count * stride);
+        for (size_t i = 0; i < count * stride; i++) {
+            float value = texels[i] / 255.f;
+            bool color = stride == 1 || i % stride < 3;
+            if (usage == TextureUsage::Srgb && color) value = srgbToLinear(value);
+            if (usage == TextureUsage::Normal && color) value = value * 2.f - 1.f;
+            out[i] = value;
+        }
+    }
+
+    // normals are renormalized in place, the next level is filtered from them
+    static void encodeLevel(std::vector<float>& values, int stride, TextureUsage usage, std::vector<unsigned char>& out) {
+        if (usage == TextureUsage::Normal && stride == 4) {
+            for (size_t i = 0; i < values.size(); i += 4) {
+                float length = std::sqrt(values[i] * values[i] + values[i + 1] * values[i + 1] + values[i + 2] * values[i + 2]);
+                for (int c = 0; c < 3; c++) values[i + c] = length > 1e-6f ? values[i + c] / length : (c == 2 ? 1.f : 0.f);
+            }
+        }
+        out.resize(values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            float value = values[i];
+            bool color = stride == 1 || i % stride < 3;
+            if (usage == TextureUsage::Srgb && color) value = linearToSrgb(std::max(value, 0.f));
+            if (usage == TextureUsage::Normal && color) value = value * 0.5f + 0.5f;
+            // lanczos lobes overshoot
+            out[i] = (unsigned char)(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+        }
+    }
+
+    int expand(const unsigned char* texels, int width, int height, int channels, std::vector<unsigned char>& out) {
+        size_t count = (size_t)width * height;
+        if (channels == 1 || channels == 4) {
+            out.assign(texels, texels + count * channels);
+            return channels;
+        }
+        // rgba rows never need an unpack alignment, and grey with alpha has no gl format of its own
+        out.resize(count * 4);
+        for (size_t i = 0; i < count; i++) {
+            const unsigned char* in = texels + i * channels;
+            unsigned char* texel = &out[i * 4];
+            texel[0] = in[0];
+            texel[1] = channels == 2 ? in[0] : in[1];
+            texel[2] = channels == 2 ? in[0] : in[2];
+            texel[3] = channels == 2 ? in[1] : 255;
+        }
+        return 4;
+    }
+
+    void buildMips(const unsigned char* texels, int width, int height, int stride, TextureUsage usage, MipFilter filter, std::vector<CookedLevel>& levels) {
+        levels.clear();
+        levels.push_back({width, height, std::vector<unsigned char>(texels, texels + (size_t)width * height * stride)});
+        std::vector<float> values, next;
+        decodeLevel(texels, (size_t)width * height, stride, usage, values);
+        while (width > 1 || height > 1) {
+            int levelWidth = std::max(1, width / 2), levelHeight = std::max(1, height / 2);
+            resample(values, width, height, stride, levelWidth, levelHeight, filter, next);
+            values.swap(next);
+            levels.push_back({levelWidth, levelHeight, {}});
+            encodeLevel(values, stride, usage, levels.back().data);
+            width = levelWidth;
+            height = levelHeight;
+        }
+    }
+
+    static uint16_t packColor(const float* rgb) {
+        int r = (int)std::lround(std::min(std::max(rgb[0], 0.f), 255.f) * 31.f / 255.f);
+        int g = (int)std::lround(std::min(std::max(rgb[1], 0.f), 255.f) * 63.f / 255.f);
+        int b = (int)std::lround(std::min(std::max(rgb[2], 0.f), 255.f) * 31.f / 255.f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    static void unpackColor(uint16_t color, int* rgb) {
+        int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    // endpoints at the ends of the block's principal axis, four colors between them
+    static void encodeColorBlock(const unsigned char (*texels)[4], unsigned char* out) {
+        float mean[3] = {0.f, 0.f, 0.f};
+        for (int i = 0; i < 16; i++) {
+            for (int c = 0; c < 3; c++) mean[c] += texels[i][c] / 16.f;
+        }
+        float cov[6] = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};  // rr rg rb gg gb bb
+        for (int i = 0; i < 16; i++) {
+            float d[3] = {texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2]};
+            cov[0] += d[0] * d[0];
+            cov[1] += d[0] * d[1];
+            cov[2] += d[0] * d[2];
+            cov[3] += d[1] * d[1];
+            cov[4] += d[1] * d[2];
+            cov[5] += d[2] * d[2];
+        }
+        float axis[3] = {1.f, 1.f, 1.f};
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float v[3] = {cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2], cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                          cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]};
+            float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            if (length < 1e-6f) break;
+            for (int c = 0; c < 3; c++) axis[c] = v[c] / length;
+        }
+        float lo = 0.f, hi = 0.f;
+        for (int i = 0; i < 16; i++) {
+            float t = (texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] + (texels[i][2] - mean[2]) * axis[2];
+            lo = std::min(lo, t);
+            hi = std::max(hi, t);
+        }
+        float e0[3], e1[3];
+        for (int c = 0; c < 3; c++) {
+            e0[c] = mean[c] + axis[c] * hi;
+            e1[c] = mean[c] + axis[c] * lo;
+        }
+        uint16_t c0 = packColor(e0), c1 = packColor(e1);
+        // c0 > c1 selects four colors in BC1, BC3 always has four
+        if (c0 < c1) std::swap(c0, c1);
+        int palette[4][3];
+        unpackColor(c0, palette[0]);
+        unpackColor(c1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        uint32_t indices = 0;
+        for (int i = 0; i < 16 && c0 != c1; i++) {
+            int best = 0, bestDistance = 1 << 30;
+            for (int p = 0; p < 4; p++) {
+                int distance = 0;
+                for (int c = 0; c < 3; c++) distance += (texels[i][c] - palette[p][c]) * (texels[i][c] - palette[p][c]);
+                if (distance < bestDistance) {
+                    best = p;
+                    bestDistance = distance;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+        out[0] = (unsigned char)(c0 & 0xff);
+        out[1] = (unsigned char)(c0 >> 8);
+        out[2] = (unsigned char)(c1 & 0xff);
+        out[3] = (unsigned char)(c1 >> 8);
+        for (int i = 0; i < 4; i++) out[4 + i] = (unsigned char)(indices >> (8 * i));
+    }
+
+    // one channel between its min and max in eight steps, the BC4 block inside BC3 and BC5
+    static void encodeChannelBlock(const unsigned char (*texels)[4], int channel, unsigned char* out) {
+        int a0 = 0, a1 = 255;
+        for (int i = 0; i < 16; i++) {
+            a0 = std::max(a0, (int)texels[i][channel]);
+            a1 = std::min(a1, (int)texels[i][channel]);
+        }
+        int palette[8] = {a0, a1};
+        for (int k = 1; k <= 6; k++) palette[k + 1] = ((7 - k) * a0 + k * a1 + 3) / 7;
+        uint64_t indices = 0;
+        for (int i = 0; i < 16 && a0 != a1; i++) {
+            int best = 0, bestDistance = 256;
+            for (int p = 0; p < 8; p++) {
+                int distance = std::abs(texels[i][channel] - palette[p]);
+                if (distance < bestDistance) {
+                    best = p;
+                    bestDistance = distance;
+                }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+        out[0] = (unsigned char)a0;
+        out[1] = (unsigned char)a1;
+        for (int i = 0; i < 6; i++) out[2 + i] = (unsigned char)(indices >> (8 * i));
+    }
+
+    void compress(const CookedLevel& level, TextureFormat format, CookedLevel& out) {
+        int blocksX = (level.width + 3) / 4, blocksY = (level.height + 3) / 4;
+        size_t size = blockBytes(format);
+        out.width = level.width;
+        out.height = level.height;
+        out.data.assign((size_t)blocksX * blocksY * size, 0);
+        unsigned char texels[16][4];
+        for (int by = 0; by < blocksY; by++) {
+            for (int bx = 0; bx < blocksX; bx++) {
+                for (int i = 0; i < 16; i++) {
+                    int x = std::min(bx * 4 + i % 4, level.width - 1), y = std::min(by * 4 + i / 4, level.height - 1);
+                    std::memcpy(texels[i], &level.data[((size_t)y * level.width + x) * 4], 4);
+                }
+                unsigned char* block = &out.data[((size_t)by * blocksX + bx) * size];
+                switch (format) {
+                    case TextureFormat::BC1:
+                        encodeColorBlock(texels, block);
+                        break;
+                    case TextureFormat::BC3:
+                        encodeChannelBlock(texels, 3, block);
+                        encodeColorBlock(texels, block + 8);
+                        break;
+                    case TextureFormat::BC5:
+                        encodeChannelBlock(texels, 0, block);
+                        encodeChannelBlock(texels, 1, block + 8);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    size_t blockBytes(TextureFormat format) { return format == TextureFormat::BC1 ? 8 : 16; }
+
+    bool isCompressed(TextureFormat format) { return format == TextureFormat::BC1 || format == TextureFormat::BC3 || format == TextureFormat::BC5; }
+
+    static uint64_t align(uint64_t offset) { return (offset + 15) & ~(uint64_t)15; }
+
+    bool write(const std::string& path, TextureFormat format, TextureUsage usage, const std::vector<CookedLevel>& levels) {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cout << "texture cooker: can't write " << path << std::endl;
+            return false;
+        }
+        TextureFileHeader header = {{'D', 'T', 'E', 'X'}, VERSION, format, usage, (uint32_t)levels[0].width, (uint32_t)levels[0].height, (uint32_t)levels.size(), 0};
+        std::vector<TextureFileLevel> table(levels.size());
+        uint64_t offset = align(sizeof(header) + table.size() * sizeof(TextureFileLevel));
+        for (size_t i = 0; i < levels.size(); i++) {
+            table[i] = {offset, levels[i].data.size(), (uint32_t)levels[i].width, (uint32_t)levels[i].height};
+            offset = align(offset + levels[i].data.size());
+        }
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(table.data(), sizeof(TextureFileLevel), table.size(), file) == table.size();
+        const unsigned char padding[16] = {};
+        for (size_t i = 0; i < levels.size() && ok; i++) {
+            long position = ftell(file);
+            ok = fwrite(padding, 1, table[i].offset - position, file) == table[i].offset - position;
+            ok = ok && fwrite(levels[i].data.data(), 1, levels[i].data.size(), file) == levels[i].data.size();
+        }
+        ok = fclose(file) == 0 && ok;
+        if (!ok) std::cout << "texture cooker: writing " << path << " failed" << std::endl;
+        return ok;
+    }
+
+    // bytes gl reads for a level of this format and size
+    static uint64_t levelBytes(TextureFormat format, uint32_t width, uint32_t height) {
+        if (isCompressed(format)) return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+        return (uint64_t)width * height * (format == TextureFormat::R8 ? 1 : 4);
+    }
+
+    bool validate(const void* file, size_t size, const TextureFileHeader*& header, const TextureFileLevel*& levels) {
+        header = static_cast<const TextureFileHeader*>(file);
+        if (size < sizeof(TextureFileHeader) || std::memcmp(header->magic, "DTEX", 4) != 0 || header->version != VERSION) return false;
+        if ((uint32_t)header->format > (uint32_t)TextureFormat::BC5 || (uint32_t)header->usage > (uint32_t)TextureUsage::Normal) return false;
+        if (header->width == 0 || header->height == 0 || header->levels == 0 || header->levels > 32) return false;
+        const uint64_t table = sizeof(TextureFileHeader) + (uint64_t)header->levels * sizeof(TextureFileLevel);
+        if (table > size) return false;
+        levels = reinterpret_cast<const TextureFileLevel*>(header + 1);
+        // the loader takes the levels as one range from the first: they have to follow each other in order, each
+        // holding exactly what gl reads for it, half the size of the one before
+        uint64_t end = table;
+        for (uint32_t i = 0; i < header->levels; i++) {
+            const TextureFileLevel& level = levels[i];
+            uint32_t width = i == 0 ? header->width : std::max(levels[i - 1].width / 2, 1u);
+            uint32_t height = i == 0 ? header->height : std::max(levels[i - 1].height / 2, 1u);
+            if (level.width != width || level.height != height) return false;
+            if (level.offset < end || level.offset > size || level.size != levelBytes(header->format, width, height) || level.size > size - level.offset) return false;
+            end = level.offset + level.size;
+        }
+        return true;
+    }
+
+    std::string cookedPath(const std::string& image) {
+        size_t slash = image.find_last_of('/');
+        size_t dot = image.find_last_of('.');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return image + ".dtex";
+        return image.substr(0, dot) + ".dtex";
+    }
+}  // namespace texture_cooker
@@ -0,0 +1,64 @@
+#ifndef DEFERRED_TEXTURECOOKER_H
+#define DEFERRED_TEXTURECOOKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// what a texture holds, picks the placeholder, the color space mips are filtered in and the internal format
+enum class TextureUsage : uint32_t { Color, Srgb, Normal };
+
+// level data as the gpu takes it. BC1/BC3/BC5 are 4x4 blocks of 8, 16 and 16 bytes
+enum class TextureFormat : uint32_t { R8, RGBA8, BC1, BC3, BC5 };
+
+// a .dtex file: the header, one TextureFileLevel per mip level, then the levels largest first, each 16 byte aligned.
+// a loader maps the file and hands the levels to gl as they are
+struct TextureFileHeader {
+    char magic[4];  // DTEX
+    uint32_t version;
+    TextureFormat format;
+    TextureUsage usage;
+    uint32_t width, height;
+    uint32_t levels;
+    uint32_t reserved;
+};
+
+struct TextureFileLevel {
+    uint64_t offset, size;  // from the start of the file
+    uint32_t width, height;
+};
+
+struct CookedLevel {
+    int width, height;
+    std::vector<unsigned char> data;
+};
+
+// building full mip chains and the .dtex container, shared by the runtime loader and tools/texture_cooker
+namespace texture_cooker {
+    const uint32_t VERSION = 1;
+
+    enum class MipFilter {
+        Box,      // 2x2 average, what the loader affords per image at runtime
+        Lanczos,  // lanczos2, sharper, for cooking offline
+    };
+
+    // 1 channel stays r8, anything else becomes rgba8. returns the stride, 1 or 4
+    int expand(const unsigned char* texels, int width, int height, int channels, std::vector<unsigned char>& out);
+    // every level down to 1x1 from a level 0 of the given stride. edges wrap like the repeating sampler. srgb
+    // textures are filtered in linear space, normal maps (xyz in rgb) are renormalized on every level
+    void buildMips(const unsigned char* texels, int width, int height, int stride, TextureUsage usage, MipFilter filter, std::vector<CookedLevel>& levels);
+    // rgba8 level into BC1, BC3 or BC5 (red and green of a normal map) blocks. edge blocks repeat the last texel
+    void compress(const CookedLevel& level, TextureFormat format, CookedLevel& out);
+    size_t blockBytes(TextureFormat format);
+    bool isCompressed(TextureFormat format);
+
+    bool write(const std::string& path, TextureFormat format, TextureUsage usage, const std::vector<CookedLevel>& levels);
+    // checks the header, and that the levels follow each other inside the file, halve in size and hold exactly
+    // the bytes their format and size take
+    bool validate(const void* file, size_t size, const TextureFileHeader*& header, const TextureFileLevel*& levels);
+    // where the cooked version of an image lives: the same name with .dtex as extension
+    std::string cookedPath(const std::string& image);
+}  // namespace texture_cooker
+
+#endif  // DEFERRED_TEXTURECOOKER_H
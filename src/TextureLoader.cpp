@@ -0,0 +1,501 @@
+#include "TextureLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "GlCapture.h"
+#include "Profiler.h"
+#include "util.h"
+
+#include <sys/stat.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static const unsigned char COLOR_PLACEHOLDER[4] = {128, 128, 128, 255};
+static const unsigned char NORMAL_PLACEHOLDER[4] = {128, 128, 255, 255};  // flat
+
+TextureLoader& TextureLoader::Get() {
+    static TextureLoader textureLoader;
+    return textureLoader;
+}
+
+TextureLoader::TextureLoader()
+    : decoders(),
+      mutex(),
+      queued(),
+      decoded(),
+      queue(),
+      finished(),
+      stopping(false),
+      uploads(),
+      ring(),
+      nextSlot(0),
+      pending(0),
+      loaded(0),
+      loadStart(),
+      streamed(),
+      streaming(true),
+      budget(DefaultBudget),
+      residentBytes(0),
+      frame(0),
+      streamingCount(0) {}
+
+TextureLoader::~TextureLoader() { Shutdown(); }
+
+void TextureLoader::Init() {
+    stopping = false;
+    streaming = true;
+    for (Slot& slot : ring) {
+        glGenBuffers(1, &slot.buffer);
+        slot.capacity = 0;
+        slot.fence = nullptr;
+    }
+    for (int i = 0; i < DecoderThreads; i++) decoders.emplace_back(&TextureLoader::DecoderLoop, this);
+}
+
+void TextureLoader::Shutdown() {
+    if (decoders.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queued.notify_all();
+    for (std::thread& decoder : decoders) decoder.join();
+    decoders.clear();
+    for (Image* image : queue) Release(image);
+    for (Image* image : finished) Release(image);
+    for (Image* image : uploads) Release(image);
+    for (auto& it : streamed) Release(it.second);
+    queue.clear();
+    finished.clear();
+    uploads.clear();
+    streamed.clear();
+    for (Slot& slot : ring) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        glDeleteBuffers(1, &slot.buffer);
+        slot = {0, 0, nullptr};
+    }
+    pending = 0;
+    residentBytes = 0;
+    streamingCount = 0;
+}
+
+unsigned int TextureLoader::Load(const std::string& path, TextureUsage usage) {
+    Image* image = new Image();
+    image->path = path;
+    image->usage = usage;
+    return Submit(image);
+}
+
+unsigned int TextureLoader::Create(const unsigned char* rgba, int width, int height, TextureUsage usage) {
+    Image* image = new Image();
+    image->usage = usage;
+    image->format = TextureFormat::RGBA8;
+    image->width = width;
+    image->height = height;
+    image->texels.assign(rgba, rgba + (size_t)width * height * 4);
+    return Submit(image);
+}
+
+unsigned int TextureLoader::Submit(Image* image) {
+    glGenTextures_profile(1, &image->texture);
+    glBindTexture_profile(GL_TEXTURE_2D, image->texture);
+    const unsigned char* placeholder = image->usage == TextureUsage::Normal ? NORMAL_PLACEHOLDER : COLOR_PLACEHOLDER;
+    glTexImage2D_profile(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    glTexParameteri_profile(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri_profile(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri_profile(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri_profile(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if (pending++ == 0) {
+        loadStart = std::chrono::steady_clock::now();
+        loaded = 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(image);
+    }
+    queued.notify_one();
+    return image->texture;
+}
+
+void TextureLoader::DecoderLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        queued.wait(lock, [this]() { return stopping || !queue.empty(); });
+        if (stopping) break;
+        Image* image = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        Decode(image);
+        lock.lock();
+        finished.push_back(image);
+        decoded.notify_all();
+    }
+}
+
+void TextureLoader::Decode(Image* image) {
+    if (!image->path.empty()) {
+        if (MapCooked(image)) return;
+        int channels;
+        unsigned char* data = stbi_load(image->path.c_str(), &image->width, &image->height, &channels, 0);
+        if (!data) {
+            image->failed = true;
+            return;
+        }
+        int stride = texture_cooker::expand(data, image->width, image->height, channels, image->texels);
+        image->format = stride == 1 ? TextureFormat::R8 : TextureFormat::RGBA8;
+        stbi_image_free(data);
+    }
+
+    // what glGenerateMipmap would do on the gpu, but filtered in linear space for srgb and renormalized for normal maps
+    std::vector<CookedLevel> levels;
+    texture_cooker::buildMips(image->texels.data(), image->width, image->height, image->format == TextureFormat::R8 ? 1 : 4, image->usage, texture_cooker::MipFilter::Box,
+                              levels);
+    image->size = 0;
+    for (const CookedLevel& level : levels) {
+        image->levels.push_back({image->size, level.data.size(), level.width, level.height});
+        image->size += level.data.size();
+    }
+    image->texels.resize(image->size);
+    for (size_t i = 1; i < levels.size(); i++) memcpy(&image->texels[image->levels[i].offset], levels[i].data.data(), levels[i].data.size());
+    image->data = image->texels.data();
+}
+
+static bool isSupported(TextureFormat format, TextureUsage usage) {
+    switch (format) {
+        case TextureFormat::BC1:
+        case TextureFormat::BC3:
+            return GLEW_EXT_texture_compression_s3tc && (usage != TextureUsage::Srgb || GLEW_EXT_texture_sRGB);
+        default:
+            // rgtc is core since 3.0
+            return true;
+    }
+}
+
+bool TextureLoader::MapCooked(Image* image) {
+    const std::string path = texture_cooker::cookedPath(image->path);
+    struct stat cooked, source;
+    if (stat(path.c_str(), &cooked) != 0) return false;
+    if (stat(image->path.c_str(), &source) == 0 && source.st_mtime > cooked.st_mtime) {
+        std::cout << path << " is older than " << image->path << ", cook it again" << std::endl;
+        return false;
+    }
+    const size_t size = (size_t)cooked.st_size;
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    void* mapping = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+    image->mapping = mapping;
+    image->mappingSize = size;
+    const unsigned char* file = static_cast<const unsigned char*>(mapping);
+#else
+    FILE* in = fopen(path.c_str(), "rb");
+    if (!in) return false;
+    image->texels.resize(size);
+    bool read = fread(image->texels.data(), 1, size, in) == size;
+    fclose(in);
+    if (!read) return false;
+    const unsigned char* file = image->texels.data();
+#endif
+
+    const TextureFileHeader* header;
+    const TextureFileLevel* levels;
+    const char* problem = nullptr;
+    if (!texture_cooker::validate(file, size, header, levels)) {
+        problem = "is not a valid cooked texture";
+    } else if (header->usage != image->usage) {
+        problem = "was cooked for another usage";
+    } else if (!isSupported(header->format, header->usage)) {
+        problem = "holds a compressed format the driver doesn't take";
+    }
+    if (problem) {
+        std::cout << path << " " << problem << ", decoding " << image->path << std::endl;
+        Release(image, false);
+        return false;
+    }
+
+    image->format = header->format;
+    image->width = (int)header->width;
+    image->height = (int)header->height;
+    // the levels are contiguous apart from alignment, one copy into the unpack buffer takes them all
+    image->data = file + levels[0].offset;
+    image->size = levels[header->levels - 1].offset + levels[header->levels - 1].size - levels[0].offset;
+    for (uint32_t i = 0; i < header->levels; i++) {
+        image->levels.push_back({(size_t)(levels[i].offset - levels[0].offset), (size_t)levels[i].size, (int)levels[i].width, (int)levels[i].height});
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    // fault the pages in here instead of in the upload's memcpy on the render thread
+    madvise(image->mapping, size, MADV_WILLNEED);
+    volatile unsigned char touch = 0;
+    for (size_t offset = 0; offset < image->size; offset += 4096) touch ^= image->data[offset];
+#endif
+    return true;
+}
+
+void TextureLoader::Release(Image* image, bool destroy) {
+#if defined(__unix__) || defined(__APPLE__)
+    if (image->mapping) munmap(image->mapping, image->mappingSize);
+#endif
+    image->mapping = nullptr;
+    image->mappingSize = 0;
+    image->texels.clear();
+    if (destroy) delete image;
+}
+
+void TextureLoader::Request(unsigned int texture, float uvPerPixel) {
+    auto it = streamed.find(texture);
+    if (it == streamed.end()) return;
+    Image* image = it->second;
+    if (image->requested != frame || uvPerPixel < image->uvPerPixel) image->uvPerPixel = uvPerPixel;
+    image->requested = frame;
+}
+
+void TextureLoader::Update() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uploads.insert(uploads.end(), finished.begin(), finished.end());
+        finished.clear();
+    }
+    if (uploads.empty() && streamed.empty()) return;
+    PROFILE_SCOPE("texture uploads");
+    size_t uploaded = 0;
+    while (!uploads.empty()) {
+        Image* image = uploads.front();
+        if (!image->failed) {
+            const int first = GetResidentLevel(image), last = (int)image->levels.size() - 1;
+            const size_t size = image->levels[last].offset + image->levels[last].size - image->levels[first].offset;
+            if (uploaded > 0 && uploaded + size > UploadBudget) break;
+            if (!Upload(image, first, last, false)) break;
+            uploaded += size;
+            residentBytes += LevelBytes(image, first, last);
+            SetResident(image, first);
+        }
+        Complete();
+    }
+    Stream(uploaded);
+    frame++;
+}
+
+void TextureLoader::Stream(size_t uploaded) {
+    // blurriest first, the most recently asked for among equals
+    std::vector<Image*> wanting;
+    for (auto& it : streamed) {
+        Image* image = it.second;
+        image->wanted = GetResidentLevel(image);
+        if (image->requested == frame) {
+            // lod of the base level, finer than it is a waste
+            float lod = std::log2(std::max(image->uvPerPixel * std::max(image->width, image->height), 1.f));
+            image->wanted = std::min(image->wanted, (int)lod);
+        }
+        if (image->wanted < image->resident) wanting.push_back(image);
+    }
+    streamingCount = (int)wanting.size();
+    std::sort(wanting.begin(), wanting.end(), [](const Image* a, const Image* b) {
+        if (a->resident - a->wanted != b->resident - b->wanted) return a->resident - a->wanted > b->resident - b->wanted;
+        return a->requested > b->requested;
+    });
+    for (Image* image : wanting) {
+        const int level = image->resident - 1;
+        const size_t size = image->levels[level].size;
+        if (uploaded > 0 && uploaded + size > UploadBudget) break;
+        if (!MakeRoom(size, image)) continue;
+        if (!Upload(image, level, level, false)) break;
+        uploaded += size;
+        residentBytes += size;
+        SetResident(image, level);
+    }
+}
+
+bool TextureLoader::MakeRoom(size_t bytes, const Image* incoming) {
+    const int need = incoming->resident - incoming->wanted;
+    if (residentBytes + bytes <= budget) return true;
+    // nothing goes unless enough can go, or a victim would come back next frame for nothing
+    size_t evictable = 0;
+    for (auto& it : streamed) {
+        const Image* image = it.second;
+        if (image == incoming) continue;
+        // dropping a level makes its texture need the next one more
+        for (int level = image->resident; level < GetResidentLevel(image) && (level - image->wanted + 1 <= 0 || level - image->wanted + 1 < need); level++) {
+            evictable += image->levels[level].size;
+        }
+    }
+    if (residentBytes + bytes > budget + evictable) return false;
+    while (residentBytes + bytes > budget) {
+        // the texture with the most levels finer than asked for goes first, those not seen this frame want none.
+        // a level that is needed only goes for one that is needed more, or both would swap back and forth
+        Image* victim = nullptr;
+        int victimNeed = 0;
+        for (auto& it : streamed) {
+            Image* image = it.second;
+            if (image == incoming || image->resident >= GetResidentLevel(image)) continue;
+            int imageNeed = image->resident - image->wanted + 1;
+            if (imageNeed > 0 && imageNeed >= need) continue;
+            if (!victim || imageNeed < victimNeed || (imageNeed == victimNeed && image->requested < victim->requested)) {
+                victim = image;
+                victimNeed = imageNeed;
+            }
+        }
+        if (!victim) return false;
+        const int level = victim->resident;
+        glBindTexture_profile(GL_TEXTURE_2D, victim->texture);
+        glTexParameteri_profile(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+        // an empty image frees the storage, levels below the base don't count for completeness
+        glTexImage2D_profile(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        victim->resident = level + 1;
+        residentBytes -= victim->levels[level].size;
+    }
+    return true;
+}
+
+void TextureLoader::Finish() {
+    streaming = false;
+    while (pending > 0) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (uploads.empty()) decoded.wait(lock, [this]() { return !finished.empty(); });
+            uploads.insert(uploads.end(), finished.begin(), finished.end());
+            finished.clear();
+        }
+        while (!uploads.empty()) {
+            Image* image = uploads.front();
+            if (!image->failed) {
+                Upload(image, 0, (int)image->levels.size() - 1, true);
+                residentBytes += LevelBytes(image, 0, (int)image->levels.size() - 1);
+                SetResident(image, 0);
+            }
+            Complete();
+        }
+    }
+    for (auto& it : streamed) {
+        Image* image = it.second;
+        if (image->resident > 0) {
+            Upload(image, 0, image->resident - 1, true);
+            residentBytes += LevelBytes(image, 0, image->resident - 1);
+            SetResident(image, 0);
+        }
+        Release(image);
+    }
+    streamed.clear();
+    streamingCount = 0;
+}
+
+size_t TextureLoader::LevelBytes(const Image* image, int first, int last) {
+    size_t size = 0;
+    for (int i = first; i <= last; i++) size += image->levels[i].size;
+    return size;
+}
+
+int TextureLoader::GetResidentLevel(const Image* image) const {
+    if (!streaming) return 0;
+    int level = 0;
+    while (level + 1 < (int)image->levels.size() && std::max(image->levels[level].width, image->levels[level].height) > ResidentSize) level++;
+    return level;
+}
+
+static void glFormats(TextureFormat textureFormat, TextureUsage usage, GLenum& internalFormat, GLenum& format) {
+    const bool srgb = usage == TextureUsage::Srgb;
+    format = GL_RGBA;
+    switch (textureFormat) {
+        case TextureFormat::R8:
+            internalFormat = GL_R8;
+            format = GL_RED;
+            break;
+        case TextureFormat::RGBA8:
+            internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+            break;
+        case TextureFormat::BC1:
+            internalFormat = srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            break;
+        case TextureFormat::BC3:
+            internalFormat = srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            break;
+        case TextureFormat::BC5:
+            internalFormat = GL_COMPRESSED_RG_RGTC2;
+            break;
+    }
+}
+
+bool TextureLoader::Upload(Image* image, int first, int last, bool wait) {
+    const size_t start = image->levels[first].offset;
+    const size_t size = image->levels[last].offset + image->levels[last].size - start;
+    Slot& slot = ring[nextSlot];
+    bool buffered = !GlCapture::Get().IsActive();
+    if (buffered && slot.fence) {
+        GLenum status;
+        do {
+            status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000ull : 0);
+        } while (wait && status == GL_TIMEOUT_EXPIRED);
+        if (status == GL_TIMEOUT_EXPIRED) return false;
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+    if (buffered) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        if (slot.capacity < size) {
+            glBufferData_profile(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+            slot.capacity = size;
+        }
+        // the fence says the gpu is done with the old contents, nothing to synchronize
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (mapped) {
+            memcpy(mapped, image->data + start, size);
+            buffered = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+            bufferUploadBytes += size;
+        } else {
+            buffered = false;
+        }
+        if (!buffered) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    GLenum internalFormat, format;
+    glFormats(image->format, image->usage, internalFormat, format);
+    glBindTexture_profile(GL_TEXTURE_2D, image->texture);
+    glPixelStorei_profile(GL_UNPACK_ALIGNMENT, 1);
+    for (int i = first; i <= last; i++) {
+        const Level& level = image->levels[i];
+        const void* pixels = buffered ? reinterpret_cast<const void*>(level.offset - start) : image->data + level.offset;
+        if (texture_cooker::isCompressed(image->format)) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height, 0, (GLsizei)level.size, pixels);
+        } else {
+            glTexImage2D_profile(GL_TEXTURE_2D, i, (GLint)internalFormat, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+        }
+    }
+    glPixelStorei_profile(GL_UNPACK_ALIGNMENT, 4);
+    if (buffered) {
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        nextSlot = (nextSlot + 1) % RingSize;
+    }
+    return true;
+}
+
+void TextureLoader::SetResident(Image* image, int level) {
+    image->resident = level;
+    glBindTexture_profile(GL_TEXTURE_2D, image->texture);
+    glTexParameteri_profile(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+}
+
+void TextureLoader::Complete() {
+    Image* image = uploads.front();
+    uploads.pop_front();
+    // keeps the placeholder
+    if (image->failed) std::cout << "Texture failed to load at path: " << image->path << std::endl;
+    if (!image->failed && image->resident > 0) {
+        streamed[image->texture] = image;
+    } else {
+        Release(image);
+    }
+    loaded++;
+    if (--pending == 0) {
+        std::cout << "textures: " << loaded << " loaded in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count() << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,139 @@
+#ifndef DEFERRED_TEXTURELOADER_H
+#define DEFERRED_TEXTURELOADER_H
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "TextureCooker.h"
+
+// textures that load without blocking the render thread. Load and Create hand back a texture holding a 1x1
+// placeholder right away; decoder threads map the cooked .dtex next to the image when there is an up to date one
+// (tools/texture_cooker), else read the image (stb_image), expand it to rgba and box filter the mip chain, and
+// Update streams finished ones into the same texture name through a ring of pixel unpack buffers, each reused only
+// once its fence signaled. while a gl capture runs the texels go straight from memory, the capture doesn't see what
+// is written into a mapped buffer.
+//
+// textures are streamed: at first only the levels of ResidentSize and smaller go up, and the image (or its mapped
+// .dtex) is kept to upload finer levels from. each frame the engine Requests the screen space density a texture is
+// seen at, and Update sharpens the blurriest ones a level at a time. when that would pass the budget, levels finer
+// than their texture was asked for are dropped again, and those of textures that weren't seen this frame first.
+class TextureLoader {
+  public:
+    static const int DecoderThreads = 2;
+    static const int RingSize = 4;
+    static const size_t UploadBudget = 16 << 20;  // bytes a frame, a bigger image still goes alone
+    static const int ResidentSize = 64;           // levels this size and smaller are never evicted
+    static const size_t DefaultBudget = 256 << 20;
+
+    static TextureLoader& Get();
+
+    // after the context is made
+    void Init();
+    // drops whatever is still loading, before the context goes
+    void Shutdown();
+
+    unsigned int Load(const std::string& path, TextureUsage usage);
+    // rgba8 texels, copied
+    unsigned int Create(const unsigned char* rgba, int width, int height, TextureUsage usage);
+    // how many uv units one screen pixel covers where the texture is seen this frame, the smallest request wins.
+    // the loader turns it into a mip level with the texture's size
+    void Request(unsigned int texture, float uvPerPixel);
+    // render thread, once a frame
+    void Update();
+    // blocks until every texture is uploaded with all its levels and stops streaming, for runs that have to see the
+    // same texels every time
+    void Finish();
+    // bytes of every level on the gpu, the never evicted ones included
+    void SetBudget(size_t bytes) { budget = bytes; }
+    size_t GetBudget() const { return budget; }
+    size_t GetResidentBytes() const { return residentBytes; }
+    int GetPendingCount() const { return pending; }
+    // streamed textures that have less than they were asked for
+    int GetStreamingCount() const { return streamingCount; }
+
+  private:
+    struct Level {
+        size_t offset, size;  // from data
+        int width, height;
+    };
+
+    struct Image {
+        unsigned int texture;
+        std::string path;  // empty when the texels were handed in
+        TextureUsage usage;
+        TextureFormat format;
+        int width, height;
+        std::vector<unsigned char> texels;  // every mip level back to back, unless the cooked file is mapped
+        std::vector<Level> levels;
+        const unsigned char* data;  // level 0, in texels or the mapping
+        size_t size;                // of all levels from data
+        void* mapping;
+        size_t mappingSize;
+        bool failed;
+        // streaming, render thread only
+        int resident;  // finest level on the gpu
+        int wanted;    // finest level asked for
+        float uvPerPixel;
+        unsigned long requested;  // frame of the last request
+    };
+
+    struct Slot {
+        GLuint buffer;
+        size_t capacity;
+        GLsync fence;
+    };
+
+    TextureLoader();
+    ~TextureLoader();
+    unsigned int Submit(Image* image);
+    void DecoderLoop();
+    static void Decode(Image* image);
+    // false when there is no usable cooked file, the image is decoded then
+    static bool MapCooked(Image* image);
+    // unmaps the cooked file, then deletes the image unless destroy is off
+    static void Release(Image* image, bool destroy = true);
+    // what levels first to last take on the gpu, without the padding between them in a mapped file
+    static size_t LevelBytes(const Image* image, int first, int last);
+    // the first level that is never evicted, 0 when not streaming
+    int GetResidentLevel(const Image* image) const;
+    // levels first to last in one copy. false while the next ring slot is still read by the gpu and wait is off
+    bool Upload(Image* image, int first, int last, bool wait);
+    void SetResident(Image* image, int level);
+    // the front of uploads is done with, streamed ones stay around
+    void Complete();
+    void Stream(size_t uploaded);
+    // false when no level is left that isn't needed more than the one that is coming
+    bool MakeRoom(size_t bytes, const Image* incoming);
+
+  private:
+    std::vector<std::thread> decoders;
+    std::mutex mutex;
+    std::condition_variable queued, decoded;
+    std::deque<Image*> queue;     // waiting for a decoder
+    std::deque<Image*> finished;  // decoded, waiting for the render thread
+    bool stopping;
+
+    std::deque<Image*> uploads;  // render thread only
+    Slot ring[RingSize];
+    int nextSlot;
+    int pending;  // loaded and not uploaded yet
+    int loaded;
+    std::chrono::steady_clock::time_point loadStart;
+
+    std::unordered_map<unsigned int, Image*> streamed;  // by texture, while finer levels are left to upload
+    bool streaming;
+    size_t budget, residentBytes;
+    unsigned long frame;
+    int streamingCount;
+};
+
+#endif  // DEFERRED_TEXTURELOADER_H
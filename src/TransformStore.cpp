@@ -0,0 +1,267 @@
+#include "TransformStore.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "JobSystem.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define TRANSFORM_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORM_SSE 1
+#endif
+
+#if defined(TRANSFORM_AVX)
+typedef __m256 Lane;
+const unsigned int TransformStore::BatchSize = 8;
+static inline Lane LaneLoad(const float* p) { return _mm256_loadu_ps(p); }
+static inline void LaneStore(float* p, Lane a) { _mm256_storeu_ps(p, a); }
+static inline Lane LaneSet(float a) { return _mm256_set1_ps(a); }
+static inline Lane LaneAdd(Lane a, Lane b) { return _mm256_add_ps(a, b); }
+static inline Lane LaneSub(Lane a, Lane b) { return _mm256_sub_ps(a, b); }
+static inline Lane LaneMul(Lane a, Lane b) { return _mm256_mul_ps(a, b); }
+#elif defined(TRANSFORM_SSE)
+typedef __m128 Lane;
+const unsigned int TransformStore::BatchSize = 4;
+static inline Lane LaneLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline void LaneStore(float* p, Lane a) { _mm_storeu_ps(p, a); }
+static inline Lane LaneSet(float a) { return _mm_set1_ps(a); }
+static inline Lane LaneAdd(Lane a, Lane b) { return _mm_add_ps(a, b); }
+static inline Lane LaneSub(Lane a, Lane b) { return _mm_sub_ps(a, b); }
+static inline Lane LaneMul(Lane a, Lane b) { return _mm_mul_ps(a, b); }
+#else
+typedef float Lane;
+const unsigned int TransformStore::BatchSize = 1;
+static inline Lane LaneLoad(const float* p) { return *p; }
+static inline void LaneStore(float* p, Lane a) { *p = a; }
+static inline Lane LaneSet(float a) { return a; }
+static inline Lane LaneAdd(Lane a, Lane b) { return a + b; }
+static inline Lane LaneSub(Lane a, Lane b) { return a - b; }
+static inline Lane LaneMul(Lane a, Lane b) { return a * b; }
+#endif
+
+static const unsigned int PADDING = 8;
+static const unsigned int INVALID_SLOT = ~0u;
+// below this many transforms a job costs more than the math
+static const unsigned int TRANSFORMS_PER_JOB = 8192;
+
+TransformStore::TransformStore()
+    : positionX(),
+      positionY(),
+      positionZ(),
+      rotationX(),
+      rotationY(),
+      rotationZ(),
+      rotationW(),
+      scaleX(),
+      scaleY(),
+      scaleZ(),
+      worldMatrices(),
+      dirty(),
+      owners(),
+      slots(),
+      generations(),
+      freeIndices(),
+      count(0),
+      dirtyCount(0) {}
+
+TransformHandle TransformStore::Create(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    TransformHandle handle;
+    if (!freeIndices.empty()) {
+        handle.index = freeIndices.back();
+        freeIndices.pop_back();
+    } else {
+        handle.index = (unsigned int)slots.size();
+        slots.push_back(INVALID_SLOT);
+        generations.push_back(0);
+    }
+    handle.generation = generations[handle.index];
+
+    unsigned int slot = count;
+    Reserve(count + 1);
+    count++;
+    slots[handle.index] = slot;
+    owners[slot] = handle.index;
+    dirty[slot] = 0;
+    SetPosition(handle, position);
+    SetRotation(handle, rotation);
+    SetScale(handle, scale);
+    return handle;
+}
+
+void TransformStore::Destroy(TransformHandle handle) {
+    if (!IsValid(handle)) return;
+    unsigned int slot = Slot(handle);
+    unsigned int last = count - 1;
+    if (dirty[slot]) dirtyCount--;
+    // move the last transform into the hole to keep the arrays dense
+    if (slot != last) {
+        positionX[slot] = positionX[last];
+        positionY[slot] = positionY[last];
+        positionZ[slot] = positionZ[last];
+        rotationX[slot] = rotationX[last];
+        rotationY[slot] = rotationY[last];
+        rotationZ[slot] = rotationZ[last];
+        rotationW[slot] = rotationW[last];
+        scaleX[slot] = scaleX[last];
+        scaleY[slot] = scaleY[last];
+        scaleZ[slot] = scaleZ[last];
+        worldMatrices[slot] = worldMatrices[last];
+        dirty[slot] = dirty[last];
+        owners[slot] = owners[last];
+        slots[owners[slot]] = slot;
+    }
+    dirty[last] = 0;
+    count--;
+    slots[handle.index] = INVALID_SLOT;
+    generations[handle.index]++;
+    freeIndices.push_back(handle.index);
+}
+
+bool TransformStore::IsValid(TransformHandle handle) const {
+    return handle.index < slots.size() && generations[handle.index] == handle.generation && slots[handle.index] != INVALID_SLOT;
+}
+
+void TransformStore::Clear() {
+    for (unsigned int slot = 0; slot < count; slot++) {
+        unsigned int index = owners[slot];
+        slots[index] = INVALID_SLOT;
+        generations[index]++;
+        freeIndices.push_back(index);
+        dirty[slot] = 0;
+    }
+    count = 0;
+    dirtyCount = 0;
+}
+
+glm::vec3 TransformStore::GetPosition(TransformHandle handle) const {
+    unsigned int slot = Slot(handle);
+    return glm::vec3(positionX[slot], positionY[slot], positionZ[slot]);
+}
+
+glm::quat TransformStore::GetRotation(TransformHandle handle) const {
+    unsigned int slot = Slot(handle);
+    return glm::quat(rotationW[slot], rotationX[slot], rotationY[slot], rotationZ[slot]);
+}
+
+glm::vec3 TransformStore::GetScale(TransformHandle handle) const {
+    unsigned int slot = Slot(handle);
+    return glm::vec3(scaleX[slot], scaleY[slot], scaleZ[slot]);
+}
+
+const glm::mat4& TransformStore::GetWorldMatrix(TransformHandle handle) const { return worldMatrices[Slot(handle)]; }
+
+void TransformStore::SetPosition(TransformHandle handle, const glm::vec3& position) {
+    assert(IsValid(handle));
+    unsigned int slot = Slot(handle);
+    positionX[slot] = position.x;
+    positionY[slot] = position.y;
+    positionZ[slot] = position.z;
+    MarkDirty(slot);
+}
+
+void TransformStore::SetRotation(TransformHandle handle, const glm::quat& rotation) {
+    assert(IsValid(handle));
+    unsigned int slot = Slot(handle);
+    glm::quat q = glm::normalize(rotation);
+    rotationX[slot] = q.x;
+    rotationY[slot] = q.y;
+    rotationZ[slot] = q.z;
+    rotationW[slot] = q.w;
+    MarkDirty(slot);
+}
+
+void TransformStore::SetScale(TransformHandle handle, const glm::vec3& scale) {
+    assert(IsValid(handle));
+    unsigned int slot = Slot(handle);
+    scaleX[slot] = scale.x;
+    scaleY[slot] = scale.y;
+    scaleZ[slot] = scale.z;
+    MarkDirty(slot);
+}
+
+void TransformStore::MarkDirty(unsigned int slot) {
+    if (dirty[slot]) return;
+    dirty[slot] = 1;
+    dirtyCount++;
+}
+
+void TransformStore::Reserve(unsigned int n) {
+    unsigned int padded = (n + PADDING - 1) / PADDING * PADDING;
+    if (padded <= positionX.size()) return;
+    positionX.resize(padded, 0.f);
+    positionY.resize(padded, 0.f);
+    positionZ.resize(padded, 0.f);
+    rotationX.resize(padded, 0.f);
+    rotationY.resize(padded, 0.f);
+    rotationZ.resize(padded, 0.f);
+    rotationW.resize(padded, 1.f);
+    scaleX.resize(padded, 1.f);
+    scaleY.resize(padded, 1.f);
+    scaleZ.resize(padded, 1.f);
+    worldMatrices.resize(padded, glm::mat4(1.f));
+    dirty.resize(padded, 0);
+    owners.resize(padded, 0);
+}
+
+unsigned int TransformStore::Update(JobSystem* jobs) {
+    unsigned int rebuilt = dirtyCount;
+    if (rebuilt == 0) return 0;
+
+    unsigned int batches = (count + BatchSize - 1) / BatchSize;
+    if (!jobs || jobs->GetWorkerCount() == 1 || rebuilt < TRANSFORMS_PER_JOB) {
+        ComposeRange(0, batches * BatchSize);
+    } else {
+        // whole batches per job, no two jobs touch the same matrix
+        jobs->ParallelFor("transform update", batches, TRANSFORMS_PER_JOB / BatchSize,
+                          [this](unsigned int begin, unsigned int end) { ComposeRange(begin * BatchSize, end * BatchSize); });
+    }
+    dirtyCount = 0;
+    return rebuilt;
+}
+
+void TransformStore::ComposeRange(unsigned int begin, unsigned int end) {
+    const Lane one = LaneSet(1.f);
+    const Lane two = LaneSet(2.f);
+    float columns[12][PADDING];
+    for (unsigned int i = begin; i < end; i += BatchSize) {
+        bool any = false;
+        for (unsigned int k = 0; k < BatchSize; k++) {
+            any |= dirty[i + k] != 0;
+        }
+        if (!any) continue;
+
+        // rotation matrix from the quaternion, scaled per column, same as translate * toMat4 * scale
+        Lane x = LaneLoad(&rotationX[i]), y = LaneLoad(&rotationY[i]), z = LaneLoad(&rotationZ[i]), w = LaneLoad(&rotationW[i]);
+        Lane sx = LaneLoad(&scaleX[i]), sy = LaneLoad(&scaleY[i]), sz = LaneLoad(&scaleZ[i]);
+        Lane xx = LaneMul(x, x), yy = LaneMul(y, y), zz = LaneMul(z, z);
+        Lane xy = LaneMul(x, y), xz = LaneMul(x, z), yz = LaneMul(y, z);
+        Lane wx = LaneMul(w, x), wy = LaneMul(w, y), wz = LaneMul(w, z);
+        LaneStore(columns[0], LaneMul(LaneSub(one, LaneMul(two, LaneAdd(yy, zz))), sx));
+        LaneStore(columns[1], LaneMul(LaneMul(two, LaneAdd(xy, wz)), sx));
+        LaneStore(columns[2], LaneMul(LaneMul(two, LaneSub(xz, wy)), sx));
+        LaneStore(columns[3], LaneMul(LaneMul(two, LaneSub(xy, wz)), sy));
+        LaneStore(columns[4], LaneMul(LaneSub(one, LaneMul(two, LaneAdd(xx, zz))), sy));
+        LaneStore(columns[5], LaneMul(LaneMul(two, LaneAdd(yz, wx)), sy));
+        LaneStore(columns[6], LaneMul(LaneMul(two, LaneAdd(xz, wy)), sz));
+        LaneStore(columns[7], LaneMul(LaneMul(two, LaneSub(yz, wx)), sz));
+        LaneStore(columns[8], LaneMul(LaneSub(one, LaneMul(two, LaneAdd(xx, yy))), sz));
+        LaneStore(columns[9], LaneLoad(&positionX[i]));
+        LaneStore(columns[10], LaneLoad(&positionY[i]));
+        LaneStore(columns[11], LaneLoad(&positionZ[i]));
+
+        // scatter the lanes back into column major matrices
+        unsigned int lanes = std::min(BatchSize, count > i ? count - i : 0u);
+        for (unsigned int k = 0; k < lanes; k++) {
+            if (!dirty[i + k]) continue;
+            glm::mat4& m = worldMatrices[i + k];
+            m[0] = glm::vec4(columns[0][k], columns[1][k], columns[2][k], 0.f);
+            m[1] = glm::vec4(columns[3][k], columns[4][k], columns[5][k], 0.f);
+            m[2] = glm::vec4(columns[6][k], columns[7][k], columns[8][k], 0.f);
+            m[3] = glm::vec4(columns[9][k], columns[10][k], columns[11][k], 1.f);
+            dirty[i + k] = 0;
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef DEFERRED_TRANSFORMSTORE_H
+#define DEFERRED_TRANSFORMSTORE_H
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <vector>
+
+class JobSystem;
+
+// handles stay valid while the dense arrays are compacted, the generation catches use after Destroy
+struct TransformHandle {
+    unsigned int index;
+    unsigned int generation;
+};
+
+// flat (parentless) transforms kept as structure of arrays.
+// Update rebuilds the world matrix of every dirty transform 4 (SSE) or 8 (AVX) at a time and splits large
+// batches into parallel jobs. Use Transform for hierarchies, this is for many independent objects.
+class TransformStore {
+  public:
+    TransformStore();
+
+    TransformHandle Create(const glm::vec3& position, const glm::quat& rotation = glm::quat(1.f, 0.f, 0.f, 0.f), const glm::vec3& scale = glm::vec3(1.f));
+    void Destroy(TransformHandle handle);
+    bool IsValid(TransformHandle handle) const;
+    void Clear();
+
+    glm::vec3 GetPosition(TransformHandle handle) const;
+    glm::quat GetRotation(TransformHandle handle) const;
+    glm::vec3 GetScale(TransformHandle handle) const;
+    const glm::mat4& GetWorldMatrix(TransformHandle handle) const;
+    void SetPosition(TransformHandle handle, const glm::vec3& position);
+    void SetRotation(TransformHandle handle, const glm::quat& rotation);
+    void SetScale(TransformHandle handle, const glm::vec3& scale);
+
+    unsigned int Update(JobSystem* jobs = nullptr);
+    unsigned int Size() const { return count; }
+
+    static const unsigned int BatchSize;
+
+  private:
+    unsigned int Slot(TransformHandle handle) const { return slots[handle.index]; }
+    void MarkDirty(unsigned int slot);
+    void Reserve(unsigned int n);
+    void ComposeRange(unsigned int begin, unsigned int end);
+
+  private:
+    // dense, padded to a multiple of 8 with identity transforms
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+    std::vector<glm::mat4> worldMatrices;
+    std::vector<unsigned char> dirty;
+    std::vector<unsigned int> owners;  // dense slot -> handle index
+
+    // handle index -> dense slot
+    std::vector<unsigned int> slots;
+    std::vector<unsigned int> generations;
+    std::vector<unsigned int> freeIndices;
+
+    unsigned int count, dirtyCount;
+};
+
+#endif  // DEFERRED_TRANSFORMSTORE_H
@@ -3,6 +3,9 @@
 #include <GL/glew.h>
 
 #include "../RenderingEngine.h"
+#include "../ShaderCompiler.h"
+
+static const unsigned long NO_VERSION = ~0ul;
 
 Camera::Camera()
     : transform(),
@@ -21,6 +24,10 @@ Camera::Camera()
       worldToCameraMatrix(),
       cameraToWorldMatrix(),
       projectionMatrix(),
+      viewVersion(NO_VERSION),
+      inverseViewVersion(NO_VERSION),
+      projectionVersion(0),
+      projectionDirty(true),
       quadVAO(0),
       quadVBO(0),
       hdrFBO(0),
@@ -45,6 +52,10 @@ Camera::Camera(const glm::vec3& pos)
       worldToCameraMatrix(),
       cameraToWorldMatrix(),
       projectionMatrix(),
+      viewVersion(NO_VERSION),
+      inverseViewVersion(NO_VERSION),
+      projectionVersion(0),
+      projectionDirty(true),
       quadVAO(0),
       quadVBO(0),
       hdrFBO(0),
@@ -56,8 +67,9 @@ Camera::~Camera() {
     glDeleteVertexArrays(1, &quadVAO);
     glDeleteBuffers(1, &quadVBO);
     glDeleteFramebuffers(1, &hdrFBO);
-    glDeleteTextures(1, &hdrColorTexture);
+    glDeleteTextures_profile(1, &hdrColorTexture);
     glDeleteRenderbuffers(1, &hdrRboDepth);
+    ShaderCompiler::Get().Release(&hdrShader);
     glDeleteProgram(hdrShader);
 }
 
@@ -67,31 +79,32 @@ bool Camera::Init() {
 
     glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
+    glBindVertexArray_profile(quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(utils::quadVertices), &utils::quadVertices, GL_STATIC_DRAW);
+    glBufferData_profile(GL_ARRAY_BUFFER, sizeof(utils::quadVertices), &utils::quadVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)nullptr);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 
-    glGenTextures(1, &hdrColorTexture);
-    glBindTexture(GL_TEXTURE_2D, hdrColorTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, pixelRect.w, pixelRect.h, 0, GL_RGBA, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glGenTextures_profile(1, &hdrColorTexture);
+    glBindTexture_profile(GL_TEXTURE_2D, hdrColorTexture);
+    glTexImage2D_profile(GL_TEXTURE_2D, 0, GL_RGBA16F, pixelRect.w, pixelRect.h, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexParameteri_profile(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri_profile(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, hdrFBO);
     glGenRenderbuffers(1, &hdrRboDepth);
     glBindRenderbuffer(GL_RENDERBUFFER, hdrRboDepth);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, pixelRect.w, pixelRect.h);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, hdrRboDepth);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, hdrColorTexture, 0);
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) return false;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, 0);
 
-    hdrShader = loadShaderFromFile("../shaders/hdr/hdr_vs.shader", "../shaders/hdr/hdr_fs.shader");
-    return hdrShader != 0;
+    // checked with the engine's other programs, see ShaderCompiler::WaitAll
+    ShaderCompiler::Get().Build(&hdrShader, "../shaders/hdr/hdr_vs.shader", "", "../shaders/hdr/hdr_fs.shader");
+    return true;
 }
 
 Transform* Camera::GetTransform() { return &transform; }
@@ -112,41 +125,54 @@ bool Camera::IsHdr() const { return hdr; }
 
 bool Camera::IsOrthographic() const { return orthographic; }
 
+bool Camera::GetUseOcclusionCulling() const { return useOcclusionCulling; }
+
 Rect<unsigned int> Camera::GetPixelRect() const { return pixelRect; }
 
 glm::mat4 Camera::GetWorldToCameraMatrix() {
-    glm::vec3 pos = transform.GetPosition();
-    worldToCameraMatrix = glm::lookAt(pos, pos + transform.GetForward(), transform.GetUp());
+    if (viewVersion != transform.GetVersion()) {
+        glm::vec3 pos = transform.GetWorldPosition();
+        worldToCameraMatrix = glm::lookAt(pos, pos + transform.GetForward(), transform.GetUp());
+        viewVersion = transform.GetVersion();
+    }
     return worldToCameraMatrix;
 }
 
 glm::mat4 Camera::GetCameraToWorldMatrix() {
-    cameraToWorldMatrix = glm::inverse(GetWorldToCameraMatrix());
+    if (inverseViewVersion != transform.GetVersion()) {
+        cameraToWorldMatrix = glm::inverse(GetWorldToCameraMatrix());
+        inverseViewVersion = transform.GetVersion();
+    }
     return cameraToWorldMatrix;
 }
 
 glm::mat4 Camera::GetProjectionMatrix() {
-    if (orthographic) {
-        projectionMatrix = glm::ortho(-10.f, 10.f, -10.f, 10.f, nearClipPlane, farClipPlane);
-    } else {
-        projectionMatrix = glm::perspective(fieldOfView, (float)pixelRect.w / (float)pixelRect.h, nearClipPlane, farClipPlane);
+    if (projectionDirty) {
+        projectionMatrix = GetProjectionMatrix(nearClipPlane, farClipPlane);
+        projectionDirty = false;
     }
-
     return projectionMatrix;
 }
 
+glm::mat4 Camera::GetProjectionMatrix(float near, float far) const {
+    if (orthographic) {
+        return glm::ortho(-10.f, 10.f, -10.f, 10.f, near, far);
+    }
+    return glm::perspective(fieldOfView, (float)pixelRect.w / (float)pixelRect.h, near, far);
+}
+
 void Camera::Render() {
-    glViewport(pixelRect.x, pixelRect.y, pixelRect.w, pixelRect.h);
-    glBindFramebuffer(GL_FRAMEBUFFER, targetTexture);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glUseProgram(hdrShader);
+    glViewport_profile(pixelRect.x, pixelRect.y, pixelRect.w, pixelRect.h);
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, targetTexture);
+    glClear_profile(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glUseProgram_profile(hdrShader);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, hdrColorTexture);
-    glUniform1i(glGetUniformLocation(hdrShader, "hdr"), hdr);
-    glUniform1f(glGetUniformLocation(hdrShader, "exposure"), exposure);
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
+    glBindTexture_profile(GL_TEXTURE_2D, hdrColorTexture);
+    glUniform1i_profile(glGetUniformLocation(hdrShader, "hdr"), hdr);
+    glUniform1f_profile(glGetUniformLocation(hdrShader, "exposure"), exposure);
+    glBindVertexArray_profile(quadVAO);
+    glDrawArrays_profile(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray_profile(0);
 }
 
 void Camera::SetPixelRect(const Rect<unsigned int>& r) {
@@ -158,22 +184,52 @@ void Camera::SetPixelRect(const Rect<unsigned int>& r) {
     normalizedRect.y = (float)pixelRect.y / (float)pixelRect.h;
     normalizedRect.w = (float)pixelRect.w / (float)pixelRect.w;
     normalizedRect.h = (float)pixelRect.h / (float)pixelRect.h;
+    SetProjectionDirty();
 }
 
 void Camera::SetHdr(bool f) { hdr = f; }
 
-void Camera::SetOrthographic(bool f) { orthographic = f; }
+void Camera::SetOrthographic(bool f) {
+    orthographic = f;
+    SetProjectionDirty();
+}
 
-void Camera::SetFieldOfView(float degree) { fieldOfView = glm::radians(degree); }
+void Camera::SetUseOcclusionCulling(bool f) { useOcclusionCulling = f; }
+
+void Camera::SetFieldOfView(float degree) {
+    fieldOfView = glm::radians(degree);
+    SetProjectionDirty();
+}
 
 void Camera::SetBackgroundColor(const glm::vec4 color) { backgroundColor = color; }
 
-void Camera::SetNearClipPlane(float near) { nearClipPlane = near; }
+void Camera::SetNearClipPlane(float near) {
+    nearClipPlane = near;
+    SetProjectionDirty();
+}
 
-void Camera::SetFarClipPlane(float far) { farClipPlane = far; }
+void Camera::SetFarClipPlane(float far) {
+    farClipPlane = far;
+    SetProjectionDirty();
+}
 
-void Camera::SetAspectRatio(int w, int h) { aspectRatio = (float)w / (float)h; }
+void Camera::SetAspectRatio(int w, int h) {
+    aspectRatio = (float)w / (float)h;
+    SetProjectionDirty();
+}
 
 void Camera::SetHdrExposure(float e) { exposure = e; }
 
 unsigned int Camera::GetHDRFBO() const { return hdrFBO; }
+
+unsigned int Camera::GetTargetFramebuffer() const { return targetTexture; }
+
+void Camera::SetTargetFramebuffer(unsigned int fbo) { targetTexture = fbo; }
+
+// both counters only grow, so the sum changes whenever the view or the projection does
+unsigned long Camera::GetVersion() const { return transform.GetVersion() + projectionVersion; }
+
+void Camera::SetProjectionDirty() {
+    projectionDirty = true;
+    projectionVersion++;
+}
@@ -22,23 +22,32 @@ class Camera {
     float GetHdrExposure() const;
     bool IsHdr() const;
     bool IsOrthographic() const;
+    bool GetUseOcclusionCulling() const;
     Rect<unsigned int> GetPixelRect() const;
     glm::mat4 GetWorldToCameraMatrix();
     glm::mat4 GetCameraToWorldMatrix();
     glm::mat4 GetProjectionMatrix();
+    glm::mat4 GetProjectionMatrix(float near, float far) const;
     unsigned int GetHDRFBO() const;
+    unsigned int GetTargetFramebuffer() const;
+    unsigned long GetVersion() const;
 
     void Render();
 
     void SetPixelRect(const Rect<unsigned int>& r);
     void SetHdr(bool f);
     void SetOrthographic(bool f);
+    void SetUseOcclusionCulling(bool f);
     void SetFieldOfView(float degree);
     void SetBackgroundColor(glm::vec4 color);
     void SetNearClipPlane(float near);
     void SetFarClipPlane(float far);
     void SetAspectRatio(int w, int h);
     void SetHdrExposure(float e);
+    void SetTargetFramebuffer(unsigned int fbo);
+
+  private:
+    void SetProjectionDirty();
 
   private:
     Transform transform;
@@ -51,9 +60,12 @@ class Camera {
     float nearClipPlane, farClipPlane;
     float aspectRatio;
     float exposure;
-    unsigned int targetTexture;  // @TODO
-    bool useOcclusionCulling;    // @TODO
+    unsigned int targetTexture;  // framebuffer the hdr image resolves into, 0 is the window
+    bool useOcclusionCulling;
     glm::mat4 worldToCameraMatrix, cameraToWorldMatrix, projectionMatrix;
+    unsigned long viewVersion, inverseViewVersion;  // transform version the cached view matrices were built from
+    unsigned long projectionVersion;
+    bool projectionDirty;
     unsigned int quadVAO, quadVBO, hdrFBO, hdrColorTexture, hdrRboDepth, hdrShader;
 };
 
@@ -0,0 +1,207 @@
+#include "DirectionalLight.h"
+
+#include <GL/glew.h>
+
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <string>
+
+#include "Camera.h"
+
+static const unsigned long NO_VERSION = ~0ul;
+
+DirectionalLight::DirectionalLight(const glm::vec3& dir, const glm::vec3& lightColor)
+    : direction(),
+      color(lightColor),
+      intensity(0.3f),
+      shadowBias(0.0015f),
+      shadowDistance(50.f),
+      splitLambda(0.75f),
+      casterExtension(30.f),
+      castShadow(true),
+      updateDistantEveryOtherFrame(false),
+      shadowMapResolution(1024),
+      currentFrame(0),
+      fittedCameraVersion(NO_VERSION),
+      lightView(),
+      cascadeArray(0),
+      cascadeFBO(0) {
+    for (int i = 0; i < CascadeCount; i++) {
+        cascadeRendered[i] = false;
+        cascadeSplits[i] = 0.f;
+        cascadeRadius[i] = 0.f;
+        cascadeCenter[i] = glm::vec3(0.f);
+        fittedMatrices[i] = glm::mat4(1.f);
+        lightSpaceMatrices[i] = glm::mat4(1.f);
+    }
+    SetDirection(dir);
+}
+
+DirectionalLight::~DirectionalLight() {
+    glDeleteFramebuffers(1, &cascadeFBO);
+    glDeleteTextures_profile(1, &cascadeArray);
+}
+
+bool DirectionalLight::Init() {
+    glGenTextures_profile(1, &cascadeArray);
+    glBindTexture_profile(GL_TEXTURE_2D_ARRAY, cascadeArray);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, shadowMapResolution, shadowMapResolution, CascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri_profile(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri_profile(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri_profile(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri_profile(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    float borderColor[] = {1.f, 1.f, 1.f, 1.f};
+    glTexParameterfv_profile(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+    // hardware 2x2 pcf on every tap
+    glTexParameteri_profile(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri_profile(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    glGenFramebuffers(1, &cascadeFBO);
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, cascadeFBO);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cascadeArray, 0, 0);
+    // only for using depth infomation buffer
+    glDrawBuffer_profile(GL_NONE);
+    glReadBuffer_profile(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) return false;
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, 0);
+    return true;
+}
+
+void DirectionalLight::Update(Camera* camera, unsigned long frame) {
+    currentFrame = frame;
+    // the fit only depends on the camera, the light direction and the shadow distance
+    if (fittedCameraVersion == camera->GetVersion()) return;
+    fittedCameraVersion = camera->GetVersion();
+    float nearPlane = camera->GetNearClipPlane();
+    float farPlane = glm::min(shadowDistance, camera->GetFarClipPlane());
+    glm::mat4 view = camera->GetWorldToCameraMatrix();
+
+    // practical split scheme, blend of logarithmic and uniform splits
+    float prevSplit = nearPlane;
+    for (int i = 0; i < CascadeCount; i++) {
+        float p = (float)(i + 1) / (float)CascadeCount;
+        float logSplit = nearPlane * std::pow(farPlane / nearPlane, p);
+        float uniformSplit = nearPlane + (farPlane - nearPlane) * p;
+        cascadeSplits[i] = splitLambda * logSplit + (1.f - splitLambda) * uniformSplit;
+        FitCascade(i, camera->GetProjectionMatrix(prevSplit, cascadeSplits[i]) * view);
+        prevSplit = cascadeSplits[i];
+    }
+}
+
+bool DirectionalLight::ShouldUpdateCascade(int cascade) const {
+    if (!castShadow) return false;
+    if (!cascadeRendered[cascade] || !updateDistantEveryOtherFrame || cascade < 2) return true;
+    // far cascades alternate so only one of them is redrawn per frame
+    return (currentFrame + cascade) % 2 == 0;
+}
+
+bool DirectionalLight::IsCaster(int cascade, const glm::vec3& center, float radius) const {
+    glm::vec3 p = glm::vec3(lightView * glm::vec4(center, 1.f));
+    glm::vec3 c = cascadeCenter[cascade];
+    float extent = cascadeRadius[cascade] + radius;
+    if (std::abs(p.x - c.x) > extent || std::abs(p.y - c.y) > extent) return false;
+    // anything between the light and the cascade still casts into it
+    return p.z - radius <= c.z + cascadeRadius[cascade] + casterExtension && p.z + radius >= c.z - cascadeRadius[cascade];
+}
+
+void DirectionalLight::RenderToTexture(unsigned int shader, int cascade) {
+    lightSpaceMatrices[cascade] = fittedMatrices[cascade];
+    cascadeRendered[cascade] = true;
+    glEnable_profile(GL_DEPTH_TEST);
+    glViewport_profile(0, 0, shadowMapResolution, shadowMapResolution);
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, cascadeFBO);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cascadeArray, 0, cascade);
+    glClear_profile(GL_DEPTH_BUFFER_BIT);
+    glUseProgram_profile(shader);
+    glUniformMatrix4fv_profile(glGetUniformLocation(shader, "lightSpaceMatrix"), 1, GL_FALSE, glm::value_ptr(lightSpaceMatrices[cascade]));
+}
+
+void DirectionalLight::RenderDebug(unsigned int shader, unsigned int quadVAO, int cascade) const {
+    glDisable_profile(GL_DEPTH_TEST);
+    glUseProgram_profile(shader);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture_profile(GL_TEXTURE_2D_ARRAY, cascadeArray);
+    // raw depth read, comparison would return 0 or 1
+    glTexParameteri_profile(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    glUniform1i_profile(glGetUniformLocation(shader, "depthMap"), 0);
+    glUniform1i_profile(glGetUniformLocation(shader, "layer"), cascade);
+    glBindVertexArray_profile(quadVAO);
+    glDrawArrays_profile(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray_profile(0);
+    glTexParameteri_profile(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glEnable_profile(GL_DEPTH_TEST);
+}
+
+void DirectionalLight::BindUniform(unsigned int shader) const {
+    glUniform3fv_profile(glGetUniformLocation(shader, "dirLight.direction"), 1, glm::value_ptr(direction));
+    glUniform3fv_profile(glGetUniformLocation(shader, "dirLight.color"), 1, glm::value_ptr(color));
+    glUniform1f_profile(glGetUniformLocation(shader, "dirLight.intensity"), intensity);
+    glUniform1f_profile(glGetUniformLocation(shader, "dirLight.shadowBias"), shadowBias);
+    glUniform1f_profile(glGetUniformLocation(shader, "dirLight.castShadow"), castShadow);
+    for (int i = 0; i < CascadeCount; i++) {
+        glUniformMatrix4fv_profile(glGetUniformLocation(shader, ("cascadeMatrices[" + std::to_string(i) + "]").c_str()), 1, GL_FALSE, glm::value_ptr(lightSpaceMatrices[i]));
+        glUniform1f_profile(glGetUniformLocation(shader, ("cascadeSplits[" + std::to_string(i) + "]").c_str()), cascadeSplits[i]);
+    }
+}
+
+void DirectionalLight::BindShadowMap(unsigned int shader, unsigned int unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture_profile(GL_TEXTURE_2D_ARRAY, cascadeArray);
+    glUniform1i_profile(glGetUniformLocation(shader, "cascadeMap"), unit);
+}
+
+glm::vec3 DirectionalLight::GetDirection() const { return direction; }
+
+float DirectionalLight::GetCascadeSplit(int cascade) const { return cascadeSplits[cascade]; }
+
+float DirectionalLight::GetCascadeCoverage(int cascade) const { return cascadeRadius[cascade] * 2.f; }
+
+bool DirectionalLight::GetUpdateDistantCascadesEveryOtherFrame() const { return updateDistantEveryOtherFrame; }
+
+void DirectionalLight::SetDirection(const glm::vec3& dir) {
+    direction = glm::normalize(dir);
+    // the light rotation stays fixed between frames, only the ortho window moves in texel steps
+    glm::vec3 up = std::abs(glm::dot(direction, glm::vec3(0.f, 1.f, 0.f))) > 0.99f ? glm::vec3(0.f, 0.f, -1.f) : glm::vec3(0.f, 1.f, 0.f);
+    lightView = glm::lookAt(glm::vec3(0.f), direction, up);
+    fittedCameraVersion = NO_VERSION;
+}
+
+void DirectionalLight::SetShadowDistance(float distance) {
+    shadowDistance = distance;
+    fittedCameraVersion = NO_VERSION;
+}
+
+void DirectionalLight::SetUpdateDistantCascadesEveryOtherFrame(bool f) { updateDistantEveryOtherFrame = f; }
+
+void DirectionalLight::FitCascade(int cascade, const glm::mat4& cameraViewProj) {
+    // slice corners in world space
+    glm::mat4 inv = glm::inverse(cameraViewProj);
+    glm::vec3 corners[8];
+    glm::vec3 center(0.f);
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 corner = inv * glm::vec4((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f, (i & 4) ? 1.f : -1.f, 1.f);
+        corners[i] = glm::vec3(corner) / corner.w;
+        center += corners[i];
+    }
+    center /= 8.f;
+
+    // a bounding sphere keeps the ortho size constant while the camera rotates
+    float radius = 0.f;
+    for (const glm::vec3& corner : corners) {
+        radius = glm::max(radius, glm::length(corner - center));
+    }
+    radius = std::ceil(radius * 16.f) / 16.f;
+
+    // snap to whole shadow texels so the edges do not shimmer while the camera moves
+    float texelSize = (2.f * radius) / (float)shadowMapResolution;
+    glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.f));
+    lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+    lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+    cascadeCenter[cascade] = lightCenter;
+    cascadeRadius[cascade] = radius;
+
+    // light view looks down -z
+    glm::mat4 projection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius, lightCenter.y - radius, lightCenter.y + radius, -lightCenter.z - radius - casterExtension, -lightCenter.z + radius);
+    fittedMatrices[cascade] = projection * lightView;
+}
@@ -0,0 +1,58 @@
+#ifndef DEFERRED_DIRECTIONALLIGHT_H
+#define DEFERRED_DIRECTIONALLIGHT_H
+
+#include <glm/glm.hpp>
+
+class Camera;
+class DirectionalLight {
+  public:
+    static const int CascadeCount = 4;
+
+    DirectionalLight(const glm::vec3& direction, const glm::vec3& lightColor);
+    ~DirectionalLight();
+
+    bool Init();
+    void Update(Camera* camera, unsigned long frame);
+    bool ShouldUpdateCascade(int cascade) const;
+    bool IsCaster(int cascade, const glm::vec3& center, float radius) const;
+    void RenderToTexture(unsigned int shader, int cascade);
+    void RenderDebug(unsigned int shader, unsigned int quadVAO, int cascade) const;
+    void BindUniform(unsigned int shader) const;
+    void BindShadowMap(unsigned int shader, unsigned int unit) const;
+
+    glm::vec3 GetDirection() const;
+    float GetCascadeSplit(int cascade) const;
+    float GetCascadeCoverage(int cascade) const;
+    bool GetUpdateDistantCascadesEveryOtherFrame() const;
+    void SetDirection(const glm::vec3& dir);
+    void SetShadowDistance(float distance);
+    void SetUpdateDistantCascadesEveryOtherFrame(bool f);
+
+  private:
+    void FitCascade(int cascade, const glm::mat4& cameraViewProj);
+
+  private:
+    glm::vec3 direction;
+    glm::vec3 color;
+    float intensity;
+    float shadowBias;
+    float shadowDistance;
+    float splitLambda;
+    float casterExtension;  // how far behind a cascade casters are still rendered
+    bool castShadow;
+    bool updateDistantEveryOtherFrame;
+    int shadowMapResolution;  // immutable
+    unsigned long currentFrame;
+    unsigned long fittedCameraVersion;  // camera version the cascades were last fitted to
+    bool cascadeRendered[CascadeCount];
+    float cascadeSplits[CascadeCount];
+    float cascadeRadius[CascadeCount];
+    glm::vec3 cascadeCenter[CascadeCount];  // light view space, texel snapped
+    glm::mat4 lightView;
+    glm::mat4 fittedMatrices[CascadeCount];  // fitted this frame
+    glm::mat4 lightSpaceMatrices[CascadeCount];  // what the cascade layers were actually rendered with
+    unsigned int cascadeArray;
+    unsigned int cascadeFBO;
+};
+
+#endif  // DEFERRED_DIRECTIONALLIGHT_H
@@ -9,6 +9,7 @@
 #include <iostream>
 
 #include "../RenderingEngine.h"
+#include "../ShaderCompiler.h"
 #include "../util.h"
 #include FT_FREETYPE_H
 
@@ -16,12 +17,13 @@ FontRenderer::FontRenderer() : mScale(0.5f), mColor(glm::vec3(1.f)), mFontShader
 
 FontRenderer::~FontRenderer() {
     for (auto& i : mCharMap) {
-        glDeleteTextures(1, &i.second.TextureID);
+        glDeleteTextures_profile(1, &i.second.TextureID);
     }
     mCharMap.clear();
 
     glDeleteVertexArrays(1, &mFontVAO);
     glDeleteBuffers(1, &mFontVBO);
+    ShaderCompiler::Get().Release(&mFontShader);
     glDeleteProgram(mFontShader);
 }
 
@@ -42,7 +44,7 @@ bool FontRenderer::Init(const std::string& filename) {
     FT_Set_Pixel_Sizes(face, 0, 48);
 
     // Disable byte-alignment restriction
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei_profile(GL_UNPACK_ALIGNMENT, 1);
 
     // Load first 128 characters of ASCII set
     for (GLubyte c = 0; c < 128; c++) {
@@ -53,36 +55,34 @@ bool FontRenderer::Init(const std::string& filename) {
         }
         // Generate texture
         GLuint font_texture;
-        glGenTextures(1, &font_texture);
-        glBindTexture(GL_TEXTURE_2D, font_texture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, face->glyph->bitmap.width, face->glyph->bitmap.rows, 0, GL_RED, GL_UNSIGNED_BYTE, face->glyph->bitmap.buffer);
+        glGenTextures_profile(1, &font_texture);
+        glBindTexture_profile(GL_TEXTURE_2D, font_texture);
+        glTexImage2D_profile(GL_TEXTURE_2D, 0, GL_RED, face->glyph->bitmap.width, face->glyph->bitmap.rows, 0, GL_RED, GL_UNSIGNED_BYTE, face->glyph->bitmap.buffer);
         // Set texture options
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri_profile(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri_profile(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri_profile(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri_profile(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         // Now store character for later use
         Character character = {font_texture, c, glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows), glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top), face->glyph->advance.x};
         mCharMap.insert(std::pair<GLchar, Character>(c, character));
     }
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture_profile(GL_TEXTURE_2D, 0);
     FT_Done_Face(face);
     FT_Done_FreeType(ft);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei_profile(GL_UNPACK_ALIGNMENT, 4);
 
     glGenVertexArrays(1, &mFontVAO);
     glGenBuffers(1, &mFontVBO);
-    glBindVertexArray(mFontVAO);
+    glBindVertexArray_profile(mFontVAO);
     glBindBuffer(GL_ARRAY_BUFFER, mFontVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
+    glBufferData_profile(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    mFontShader = loadShaderFromFile("../shaders/font/font_vs.shader", "../shaders/font/font_fs.shader");
-    if (!mFontShader) return false;
+    glBindVertexArray_profile(0);
 
+    ShaderCompiler::Get().Build(&mFontShader, "../shaders/font/font_vs.shader", "", "../shaders/font/font_fs.shader");
     return true;
 }
 
@@ -124,15 +124,15 @@ void FontRenderer::PrintCodepoint(const char codepoint) {
 }
 
 void FontRenderer::DrawText(std::string text, glm::vec2 pos) {
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glUseProgram(mFontShader);
-    glUniform3f(glGetUniformLocation(mFontShader, "textColor"), mColor.x, mColor.y, mColor.z);
+    glDisable_profile(GL_DEPTH_TEST);
+    glEnable_profile(GL_BLEND);
+    glBlendFunc_profile(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram_profile(mFontShader);
+    glUniform3f_profile(glGetUniformLocation(mFontShader, "textColor"), mColor.x, mColor.y, mColor.z);
     glm::mat4 projection = glm::ortho(0.0f, static_cast<GLfloat>(RenderingEngine::GetInstance()->GetWidth()), 0.0f, static_cast<GLfloat>(RenderingEngine::GetInstance()->GetHeight()));
-    glUniformMatrix4fv(glGetUniformLocation(mFontShader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    glUniformMatrix4fv_profile(glGetUniformLocation(mFontShader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
     glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(mFontVAO);
+    glBindVertexArray_profile(mFontVAO);
 
     // Iterate through all characters
     std::string::const_iterator c;
@@ -148,16 +148,16 @@ void FontRenderer::DrawText(std::string text, glm::vec2 pos) {
         float vertices[6][4] = {{xpos, ypos + h, 0.0, 0.0}, {xpos, ypos, 0.0, 1.0},     {xpos + w, ypos, 1.0, 1.0},
 
                                 {xpos, ypos + h, 0.0, 0.0}, {xpos + w, ypos, 1.0, 1.0}, {xpos + w, ypos + h, 1.0, 0.0}};
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
+        glBindTexture_profile(GL_TEXTURE_2D, ch.TextureID);
         glBindBuffer(GL_ARRAY_BUFFER, mFontVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+        glBufferSubData_profile(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glDrawArrays_profile(GL_TRIANGLES, 0, 6);
         // Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
         pos.x += (ch.Advance >> 6) * mScale;  // Bitshift by 6 to get value in pixels (2^6 = 64 (divide amount of 1/64th pixels by 64 to get amount of pixels))
     }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glDisable(GL_BLEND);
+    glBindVertexArray_profile(0);
+    glBindTexture_profile(GL_TEXTURE_2D, 0);
+    glDisable_profile(GL_BLEND);
 }
\ No newline at end of file
@@ -10,6 +10,7 @@ class Material {
     ~Material();
 
     bool InitDiffuse(const std::string& filename);
+    bool InitDiffuse(const unsigned char* rgba, int width, int height);
     bool InitSpecular(const std::string& filename);
     bool InitNormal(const std::string& filename);
 
@@ -17,6 +18,10 @@ class Material {
     unsigned int GetSpecular() const;
     unsigned int GetNormal() const;
     float GetShininess() const;
+    // set by the MaterialTable holding the diffuse texels, array 0 for a material drawn from its own textures
+    void SetDiffuseLayer(unsigned int array, int layer);
+    unsigned int GetDiffuseArray() const;
+    int GetDiffuseLayer() const;
 
     bool GetUseNormal() const;
     void SetUseNormal(bool use);
@@ -25,6 +30,8 @@ class Material {
     unsigned int diffuse;
     unsigned int specular;
     unsigned int normal;
+    unsigned int diffuseArray;
+    int diffuseLayer;
     bool useNormal;
     float shininess;
 };
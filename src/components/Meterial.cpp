@@ -1,34 +1,40 @@
+#include "../TextureLoader.h"
 #include "../util.h"
 #include "Material.h"
 
-Material::Material() : diffuse(0), specular(0), normal(0), useNormal(false), shininess(128.f) {}
+Material::Material() : diffuse(0), specular(0), normal(0), diffuseArray(0), diffuseLayer(0), useNormal(false), shininess(128.f) {}
 
-Material::Material(float shin) : diffuse(0), specular(0), normal(0), useNormal(false), shininess(shin) {}
+Material::Material(float shin) : diffuse(0), specular(0), normal(0), diffuseArray(0), diffuseLayer(0), useNormal(false), shininess(shin) {}
 
 Material::~Material() {
-    if (!diffuse) {
-        glDeleteTextures(1, &diffuse);
+    if (diffuse) {
+        glDeleteTextures_profile(1, &diffuse);
     }
-    if (!specular) {
-        glDeleteTextures(1, &specular);
+    if (specular) {
+        glDeleteTextures_profile(1, &specular);
     }
-    if (!normal) {
-        glDeleteTextures(1, &normal);
+    if (normal) {
+        glDeleteTextures_profile(1, &normal);
     }
 }
 
 bool Material::InitDiffuse(const std::string &filename) {
-    diffuse = loadTexture(filename.c_str(), false);
+    diffuse = TextureLoader::Get().Load(filename, TextureUsage::Color);
+    return diffuse != 0;
+}
+
+bool Material::InitDiffuse(const unsigned char *rgba, int width, int height) {
+    diffuse = TextureLoader::Get().Create(rgba, width, height, TextureUsage::Color);
     return diffuse != 0;
 }
 
 bool Material::InitSpecular(const std::string &filename) {
-    specular = loadTexture(filename.c_str(), false);
+    specular = TextureLoader::Get().Load(filename, TextureUsage::Color);
     return specular != 0;
 }
 
 bool Material::InitNormal(const std::string &filename) {
-    normal = loadTexture(filename.c_str(), false);
+    normal = TextureLoader::Get().Load(filename, TextureUsage::Normal);
     return normal != 0;
 }
 
@@ -40,6 +46,15 @@ unsigned int Material::GetNormal() const { return normal; }
 
 float Material::GetShininess() const { return shininess; }
 
+void Material::SetDiffuseLayer(unsigned int array, int layer) {
+    diffuseArray = array;
+    diffuseLayer = layer;
+}
+
+unsigned int Material::GetDiffuseArray() const { return diffuseArray; }
+
+int Material::GetDiffuseLayer() const { return diffuseLayer; }
+
 bool Material::GetUseNormal() const { return useNormal; }
 
 void Material::SetUseNormal(bool use) { useNormal = use; }
@@ -2,6 +2,7 @@
 
 #include <GL/glew.h>
 
+#include <cmath>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Camera.h"
@@ -17,9 +18,16 @@ PointLight::PointLight(const glm::vec3& position, const glm::vec3& ambientColor)
       intensity(0.5f),
       castShadow(true),
       castTranslucentShadow(true),
+      shadowFilterMode(ShadowFilterMode::PCF),
+      momentMinVariance(0.00002f),
+      lightBleedReduction(0.3f),
       shadowMapResolution(glm::vec2(512.f, 512.f)),
       depthCubemap(0),
       depthCubemapFBO(0),
+      momentCubemap(0),
+      momentBlurCubemap(0),
+      momentFBO(0),
+      momentBlurFBO(0),
       transform(position) {
     normalizedResolution = shadowMapResolution.x / shadowMapResolution.y;
     transform.SetScale(glm::vec3(0.05f));
@@ -27,28 +35,63 @@ PointLight::PointLight(const glm::vec3& position, const glm::vec3& ambientColor)
 
 PointLight::~PointLight() {
     glDeleteFramebuffers(1, &depthCubemapFBO);
-    glDeleteTextures(1, &depthCubemap);
+    glDeleteTextures_profile(1, &depthCubemap);
+    glDeleteFramebuffers(1, &momentFBO);
+    glDeleteFramebuffers(1, &momentBlurFBO);
+    glDeleteTextures_profile(1, &momentCubemap);
+    glDeleteTextures_profile(1, &momentBlurCubemap);
 }
 
 bool PointLight::Init() {
-    glGenTextures(1, &depthCubemap);
+    glGenTextures_profile(1, &depthCubemap);
     glGenFramebuffers(1, &depthCubemapFBO);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
+    glBindTexture_profile(GL_TEXTURE_CUBE_MAP, depthCubemap);
     for (int i = 0; i < 6; ++i) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, shadowMapResolution.x, shadowMapResolution.y, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexImage2D_profile(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, shadowMapResolution.x, shadowMapResolution.y, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glBindFramebuffer(GL_FRAMEBUFFER, depthCubemapFBO);
+    glTexParameteri_profile(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri_profile(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri_profile(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri_profile(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri_profile(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, depthCubemapFBO);
     glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemap, 0);
     // only for using depth infomation buffer
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
+    glDrawBuffer_profile(GL_NONE);
+    glReadBuffer_profile(GL_NONE);
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) return false;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, 0);
+    return true;
+}
+
+bool PointLight::InitMomentMap() {
+    if (momentFBO) return true;
+
+    glGenTextures_profile(1, &momentCubemap);
+    glGenTextures_profile(1, &momentBlurCubemap);
+    unsigned int targets[2] = {momentCubemap, momentBlurCubemap};
+    for (unsigned int target : targets) {
+        glBindTexture_profile(GL_TEXTURE_CUBE_MAP, target);
+        for (int i = 0; i < 6; ++i) {
+            glTexImage2D_profile(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RG32F, shadowMapResolution.x, shadowMapResolution.y, 0, GL_RG, GL_FLOAT, NULL);
+        }
+        glTexParameteri_profile(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri_profile(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri_profile(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri_profile(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri_profile(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+
+    // moments are written to color while the existing depth cubemap keeps doing the depth test
+    glGenFramebuffers(1, &momentFBO);
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, momentFBO);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, momentCubemap, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemap, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) return false;
+
+    // face attachments of the blur target are switched per pass in FilterShadowMap
+    glGenFramebuffers(1, &momentBlurFBO);
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, 0);
     return true;
 }
 
@@ -56,7 +99,16 @@ Transform* PointLight::GetTransform() { return &transform; }
 
 glm::mat4 PointLight::GetPerspective() const { return glm::perspective(glm::radians(90.0f), normalizedResolution, nearPlane, farPlane); }
 
-glm::mat4 PointLight::GetLookAt(const glm::vec3& forawrdDir, const glm::vec3& upwardDir) const { return glm::lookAt(transform.GetPosition(), transform.GetPosition() + forawrdDir, upwardDir); }
+float PointLight::GetRange() const {
+    // distance where 1 / (1 + a * d^2) drops below 1/256
+    float a = glm::clamp(attenuation, 0.0001f, 1.f);
+    return glm::min(std::sqrt(255.f / a), farPlane);
+}
+
+glm::mat4 PointLight::GetLookAt(const glm::vec3& forawrdDir, const glm::vec3& upwardDir) const {
+    glm::vec3 position = transform.GetWorldPosition();
+    return glm::lookAt(position, position + forawrdDir, upwardDir);
+}
 
 std::vector<glm::mat4> PointLight::GetCubemapShadowMatrix() const {
     std::vector<glm::mat4> mats;
@@ -71,36 +123,93 @@ std::vector<glm::mat4> PointLight::GetCubemapShadowMatrix() const {
 }
 
 void PointLight::RenderLight(unsigned int shader) {
-    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(transform.GetLocalToWorldMatrix()));
-    glUniform4fv(glGetUniformLocation(shader, "LightColor"), 1, glm::value_ptr(color));
+    glUniformMatrix4fv_profile(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(transform.GetLocalToWorldMatrix()));
+    glUniform4fv_profile(glGetUniformLocation(shader, "LightColor"), 1, glm::value_ptr(color));
     glDrawArrays_profile(GL_TRIANGLES, 0, 36);
 }
 
 void PointLight::RenderToTexture(unsigned int shader) {
     std::vector<glm::mat4> shadowTransforms = GetCubemapShadowMatrix();
-    glEnable(GL_DEPTH_TEST);
-    glViewport(0, 0, shadowMapResolution.x, shadowMapResolution.y);
-    glBindFramebuffer(GL_FRAMEBUFFER, depthCubemapFBO);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glUseProgram(shader);
+    glEnable_profile(GL_DEPTH_TEST);
+    glViewport_profile(0, 0, shadowMapResolution.x, shadowMapResolution.y);
+    if (shadowFilterMode == ShadowFilterMode::MOMENT) {
+        glBindFramebuffer_profile(GL_FRAMEBUFFER, momentFBO);
+        // empty texels behave as if the occluder is at the far plane. the clear color is put back for the passes after
+        GLfloat clearColor[4];
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+        glClearColor_profile(1.f, 1.f, 0.f, 0.f);
+        glClear_profile(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glClearColor_profile(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    } else {
+        glBindFramebuffer_profile(GL_FRAMEBUFFER, depthCubemapFBO);
+        glClear_profile(GL_DEPTH_BUFFER_BIT);
+    }
+    glUseProgram_profile(shader);
     for (int i = 0; i < shadowTransforms.size(); ++i) {
-        glUniformMatrix4fv(glGetUniformLocation(shader, ("shadowMatrices[" + std::to_string(i) + "]").c_str()), 1, GL_FALSE, glm::value_ptr(shadowTransforms[i]));
+        glUniformMatrix4fv_profile(glGetUniformLocation(shader, ("shadowMatrices[" + std::to_string(i) + "]").c_str()), 1, GL_FALSE, glm::value_ptr(shadowTransforms[i]));
     }
-    glUniform1f(glGetUniformLocation(shader, "far_plane"), farPlane);
-    glUniform3fv(glGetUniformLocation(shader, "lightPos"), 1, glm::value_ptr(transform.GetPosition()));
+    glUniform1f_profile(glGetUniformLocation(shader, "far_plane"), farPlane);
+    glUniform3fv_profile(glGetUniformLocation(shader, "lightPos"), 1, glm::value_ptr(transform.GetWorldPosition()));
+}
+
+void PointLight::FilterShadowMap(unsigned int shader, unsigned int quadVAO) {
+    if (shadowFilterMode != ShadowFilterMode::MOMENT) return;
+
+    // separable gaussian, horizontal into the blur cubemap then vertical back into the moment cubemap
+    glDisable_profile(GL_DEPTH_TEST);
+    glViewport_profile(0, 0, shadowMapResolution.x, shadowMapResolution.y);
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, momentBlurFBO);
+    glUseProgram_profile(shader);
+    glUniform1i_profile(glGetUniformLocation(shader, "momentMap"), 0);
+    glUniform2f_profile(glGetUniformLocation(shader, "texelSize"), 1.f / shadowMapResolution.x, 1.f / shadowMapResolution.y);
+    glBindVertexArray_profile(quadVAO);
+    glActiveTexture(GL_TEXTURE0);
+    for (int pass = 0; pass < 2; ++pass) {
+        unsigned int src = pass == 0 ? momentCubemap : momentBlurCubemap;
+        unsigned int dst = pass == 0 ? momentBlurCubemap : momentCubemap;
+        glBindTexture_profile(GL_TEXTURE_CUBE_MAP, src);
+        glUniform2f_profile(glGetUniformLocation(shader, "direction"), pass == 0 ? 1.f : 0.f, pass == 0 ? 0.f : 1.f);
+        for (int face = 0; face < 6; ++face) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, dst, 0);
+            glUniform1i_profile(glGetUniformLocation(shader, "face"), face);
+            glDrawArrays_profile(GL_TRIANGLE_STRIP, 0, 4);
+        }
+    }
+    glBindVertexArray_profile(0);
+    glBindFramebuffer_profile(GL_FRAMEBUFFER, 0);
+    glEnable_profile(GL_DEPTH_TEST);
+}
+
+ShadowFilterMode PointLight::GetShadowFilterMode() const { return shadowFilterMode; }
+
+bool PointLight::SetShadowFilterMode(ShadowFilterMode mode) {
+    if (mode == ShadowFilterMode::MOMENT && !InitMomentMap()) return false;
+    shadowFilterMode = mode;
+    return true;
+}
+
+bool PointLight::GetCastShadow() const { return castShadow; }
+
+void PointLight::SetCastShadow(bool cast) { castShadow = cast; }
+
+ShadowSampling PointLight::GetShadowSampling(ShadowFilterMode mode) const {
+    if (!castShadow) return ShadowSampling::NONE;
+    if (mode == ShadowFilterMode::MOMENT) return ShadowSampling::MOMENT;
+    return castTranslucentShadow ? ShadowSampling::PCF : ShadowSampling::HARD;
 }
 
 void PointLight::BindUniform(unsigned int shader, unsigned int i) const {
-    glUniform3fv(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].position").c_str()), 1, glm::value_ptr(transform.GetPosition()));
-    glUniform3fv(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].color").c_str()), 1, glm::value_ptr(color));
-    glUniform1f(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].attenuation").c_str()), attenuation);
-    glUniform1f(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].shadowBias").c_str()), shadowBias);
-    glUniform1f(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].shadowFilterSharpen").c_str()), shadowFilterSharpen);
-    glUniform1f(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].shadowStrength").c_str()), shadowStrength);
-    glUniform1f(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].intensity").c_str()), intensity);
-    glUniform1f(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].castShadow").c_str()), castShadow);
-    glUniform1f(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].castTranslucentShadow").c_str()), castTranslucentShadow);
+    glUniform3fv_profile(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].position").c_str()), 1, glm::value_ptr(transform.GetWorldPosition()));
+    glUniform3fv_profile(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].color").c_str()), 1, glm::value_ptr(color));
+    glUniform1f_profile(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].attenuation").c_str()), attenuation);
+    glUniform1f_profile(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].shadowBias").c_str()), shadowBias);
+    glUniform1f_profile(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].shadowFilterSharpen").c_str()), shadowFilterSharpen);
+    glUniform1f_profile(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].shadowStrength").c_str()), shadowStrength);
+    glUniform1f_profile(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].intensity").c_str()), intensity);
+    glUniform1f_profile(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].momentMinVariance").c_str()), momentMinVariance);
+    glUniform1f_profile(glGetUniformLocation(shader, ("pointLights[" + std::to_string(i) + "].lightBleedReduction").c_str()), lightBleedReduction);
     glActiveTexture(GL_TEXTURE2 + i);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
-    glUniform1i(glGetUniformLocation(shader, ("depthMap[" + std::to_string(i) + "]").c_str()), 2 + i);
+    // both maps are sampled through the same samplerCube, the moment map just carries (d, d^2) in .rg
+    glBindTexture_profile(GL_TEXTURE_CUBE_MAP, shadowFilterMode == ShadowFilterMode::MOMENT ? momentCubemap : depthCubemap);
+    glUniform1i_profile(glGetUniformLocation(shader, ("depthMap[" + std::to_string(i) + "]").c_str()), 2 + i);
 }
@@ -6,6 +6,12 @@
 
 #include "Transform.h"
 
+// PCF takes 25 dependent cubemap fetches per fragment when castTranslucentShadow is on,
+// MOMENT stores (depth, depth^2) which is pre-blurred once per update and resolved with a single fetch.
+enum class ShadowFilterMode { PCF = 0, MOMENT = 1 };
+// how the lit shader samples a light's shadow, baked into its variant. SHADOW_* in shaders/point_shadow/lights.shader
+enum class ShadowSampling { NONE = 0, HARD = 1, PCF = 2, MOMENT = 3 };
+
 class PointLight {
   public:
     PointLight(const glm::vec3& position, const glm::vec3& ambientColor);
@@ -14,13 +20,23 @@ class PointLight {
     bool Init();
     Transform* GetTransform();
     glm::mat4 GetPerspective() const;
+    float GetRange() const;
     std::vector<glm::mat4> GetCubemapShadowMatrix() const;
     void RenderLight(unsigned int shader);
     void RenderToTexture(unsigned int shader);
+    void FilterShadowMap(unsigned int shader, unsigned int quadVAO);
     void BindUniform(unsigned int shader, unsigned int i) const;
+    ShadowFilterMode GetShadowFilterMode() const;
+    bool SetShadowFilterMode(ShadowFilterMode mode);
+    // a light without shadows still lights the scene but skips its cubemap pass
+    bool GetCastShadow() const;
+    void SetCastShadow(bool cast);
+    // in the given filter mode, the current one or one about to be switched to
+    ShadowSampling GetShadowSampling(ShadowFilterMode mode) const;
 
   private:
     glm::mat4 GetLookAt(const glm::vec3& forawrdDir, const glm::vec3& upwardDir) const;
+    bool InitMomentMap();
 
   private:
     glm::vec3 color;
@@ -33,9 +49,14 @@ class PointLight {
     float intensity;
     bool castShadow;
     bool castTranslucentShadow;
+    ShadowFilterMode shadowFilterMode;
+    float momentMinVariance;
+    float lightBleedReduction;
     glm::vec2 shadowMapResolution;  // immutable
     unsigned int depthCubemap;
     unsigned int depthCubemapFBO;
+    unsigned int momentCubemap, momentBlurCubemap;  // RG32F, only allocated once MOMENT mode is requested
+    unsigned int momentFBO, momentBlurFBO;
     Transform transform;
     float normalizedResolution;  // immutable
 };
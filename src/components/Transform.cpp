@@ -1,5 +1,6 @@
 #include "Transform.h"
 
+#include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
 
 const glm::vec3 Transform::Up = glm::vec3(0.f, 1.f, 0.f);
@@ -11,61 +12,183 @@ const glm::vec3 Transform::Backward = glm::vec3(0.f, 0.f, 1.f);
 const glm::vec3 Transform::One = glm::vec3(1.f, 1.f, 1.f);
 const glm::vec3 Transform::Zero = glm::vec3(0.f, 0.f, 0.f);
 
-Transform::Transform() : position(0.f), scale(1.f), rotation(), localToWorldMatrix(), worldToLocalMatrix() {
-    forward = rotation * Transform::Forward;
-    up = rotation * Transform::Up;
-    right = rotation * Transform::Right;
+static const unsigned int DIRTY_ALL = ~0u;
+
+Transform::Transform()
+    : position(0.f),
+      scale(1.f),
+      rotation(),
+      parent(nullptr),
+      children(),
+      version(0),
+      dirty(DIRTY_ALL),
+      forward(Transform::Forward),
+      up(Transform::Up),
+      right(Transform::Right),
+      worldRotation(),
+      localMatrix(1.f),
+      localToWorldMatrix(1.f),
+      worldToLocalMatrix(1.f) {}
+
+Transform::Transform(const glm::vec3& pos)
+    : position(pos),
+      scale(1.f),
+      rotation(),
+      parent(nullptr),
+      children(),
+      version(0),
+      dirty(DIRTY_ALL),
+      forward(Transform::Forward),
+      up(Transform::Up),
+      right(Transform::Right),
+      worldRotation(),
+      localMatrix(1.f),
+      localToWorldMatrix(1.f),
+      worldToLocalMatrix(1.f) {}
+
+Transform::~Transform() {
+    SetParent(nullptr);
+    for (Transform* child : children) {
+        child->parent = nullptr;
+        child->SetWorldDirty();
+    }
 }
 
-Transform::Transform(const glm::vec3& pos) : position(pos), scale(1.f), rotation(), localToWorldMatrix(), worldToLocalMatrix() {
-    forward = rotation * Transform::Forward;
-    up = rotation * Transform::Up;
-    right = rotation * Transform::Right;
+void Transform::Translate(const glm::vec3& pos) {
+    position += pos;
+    SetLocalDirty();
 }
 
-Transform::~Transform() {}
-
-void Transform::Translate(const glm::vec3& pos) { position += pos; }
-
-void Transform::Scale(const glm::vec3& s) { scale += s; }
+void Transform::Scale(const glm::vec3& s) {
+    scale += s;
+    SetLocalDirty();
+}
 
-void Transform::Rotate(const glm::vec3& axis, float angle) { rotation = glm::normalize(glm::angleAxis(angle, glm::normalize(axis)) * rotation); }
+void Transform::Rotate(const glm::vec3& axis, float angle) {
+    rotation = glm::normalize(glm::angleAxis(angle, glm::normalize(axis)) * rotation);
+    SetLocalDirty();
+}
 
 glm::vec3 Transform::GetPosition() const { return position; }
 
+glm::vec3 Transform::GetWorldPosition() const {
+    if (!parent) return position;
+    return glm::vec3(GetLocalToWorldMatrix()[3]);
+}
+
 glm::vec3 Transform::GetForward() const {
-    forward = GetRotation() * Transform::Forward;
-    return glm::normalize(forward);
+    if (dirty & DIRTY_AXES) UpdateAxes();
+    return forward;
 }
 
 glm::vec3 Transform::GetUp() const {
-    up = GetRotation() * Transform::Up;
-    return glm::normalize(up);
+    if (dirty & DIRTY_AXES) UpdateAxes();
+    return up;
 }
 
 glm::vec3 Transform::GetRight() const {
-    right = glm::cross(GetForward(), GetUp());
-    return glm::normalize(right);
+    if (dirty & DIRTY_AXES) UpdateAxes();
+    return right;
 }
 
 glm::vec3 Transform::GetScale() const { return scale; }
 
 glm::quat Transform::GetRotation() const { return rotation; }
 
-glm::mat4 Transform::GetLocalToWorldMatrix() {
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, position);
-    model = model * glm::toMat4(rotation);
-    model = glm::scale(model, scale);
-    localToWorldMatrix = model;
+glm::quat Transform::GetWorldRotation() const {
+    if (dirty & DIRTY_WORLD) UpdateWorld();
+    return worldRotation;
+}
+
+glm::mat4 Transform::GetLocalMatrix() const {
+    if (dirty & DIRTY_LOCAL) {
+        localMatrix = glm::translate(glm::mat4(1.0f), position);
+        localMatrix = localMatrix * glm::toMat4(rotation);
+        localMatrix = glm::scale(localMatrix, scale);
+        dirty &= ~DIRTY_LOCAL;
+    }
+    return localMatrix;
+}
+
+glm::mat4 Transform::GetLocalToWorldMatrix() const {
+    if (dirty & DIRTY_WORLD) UpdateWorld();
     return localToWorldMatrix;
 }
 
-glm::mat4 Transform::GetWorldToLocalMatrix() {
-    worldToLocalMatrix = glm::inverse(GetLocalToWorldMatrix());
+glm::mat4 Transform::GetWorldToLocalMatrix() const {
+    if (dirty & (DIRTY_WORLD | DIRTY_INVERSE)) {
+        worldToLocalMatrix = glm::inverse(GetLocalToWorldMatrix());
+        dirty &= ~DIRTY_INVERSE;
+    }
     return worldToLocalMatrix;
 }
 
-void Transform::SetPosition(const glm::vec3& pos) { position = pos; }
+Transform* Transform::GetParent() const { return parent; }
+
+unsigned int Transform::GetChildCount() const { return (unsigned int)children.size(); }
+
+Transform* Transform::GetChild(unsigned int index) const { return children[index]; }
+
+unsigned long Transform::GetVersion() const { return version; }
+
+void Transform::SetPosition(const glm::vec3& pos) {
+    position = pos;
+    SetLocalDirty();
+}
+
+void Transform::SetRotation(const glm::quat& q) {
+    rotation = glm::normalize(q);
+    SetLocalDirty();
+}
+
+void Transform::SetScale(const glm::vec3& s) {
+    scale = s;
+    SetLocalDirty();
+}
+
+void Transform::SetParent(Transform* p) {
+    if (p == parent) return;
+    // refuse cycles
+    for (Transform* t = p; t; t = t->parent) {
+        if (t == this) return;
+    }
+    if (parent) {
+        parent->children.erase(std::find(parent->children.begin(), parent->children.end(), this));
+    }
+    parent = p;
+    if (parent) parent->children.push_back(this);
+    SetWorldDirty();
+}
+
+void Transform::SetLocalDirty() {
+    dirty |= DIRTY_LOCAL;
+    SetWorldDirty();
+}
+
+void Transform::SetWorldDirty() {
+    // the whole subtree moves with this transform
+    dirty |= DIRTY_WORLD | DIRTY_INVERSE | DIRTY_AXES;
+    version++;
+    for (Transform* child : children) {
+        child->SetWorldDirty();
+    }
+}
 
-void Transform::SetScale(const glm::vec3& s) { scale = s; }
+void Transform::UpdateWorld() const {
+    if (parent) {
+        localToWorldMatrix = parent->GetLocalToWorldMatrix() * GetLocalMatrix();
+        worldRotation = parent->GetWorldRotation() * rotation;
+    } else {
+        localToWorldMatrix = GetLocalMatrix();
+        worldRotation = rotation;
+    }
+    dirty &= ~DIRTY_WORLD;
+}
+
+void Transform::UpdateAxes() const {
+    glm::quat r = GetWorldRotation();
+    forward = glm::normalize(r * Transform::Forward);
+    up = glm::normalize(r * Transform::Up);
+    right = glm::normalize(glm::cross(forward, up));
+    dirty &= ~DIRTY_AXES;
+}
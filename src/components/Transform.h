@@ -4,34 +4,63 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include <vector>
 
+// position, rotation and scale are local to the parent.
+// matrices and axes are cached and only rebuilt after a change marks them dirty,
+// GetVersion changes whenever the world matrix does so other caches can compare against it.
 class Transform {
   public:
     Transform();
     Transform(const glm::vec3& pos);
+    Transform(const Transform&) = delete;
+    Transform& operator=(const Transform&) = delete;
     ~Transform();
 
     void Translate(const glm::vec3& pos);
     void Scale(const glm::vec3& s);
     void Rotate(const glm::vec3& axis, float angle);
     glm::vec3 GetPosition() const;
+    glm::vec3 GetWorldPosition() const;
     glm::vec3 GetForward() const;
     glm::vec3 GetUp() const;
     glm::vec3 GetRight() const;
     glm::vec3 GetScale() const;
     glm::quat GetRotation() const;
-    glm::mat4 GetLocalToWorldMatrix();
-    glm::mat4 GetWorldToLocalMatrix();
+    glm::quat GetWorldRotation() const;
+    glm::mat4 GetLocalMatrix() const;
+    glm::mat4 GetLocalToWorldMatrix() const;
+    glm::mat4 GetWorldToLocalMatrix() const;
+    Transform* GetParent() const;
+    unsigned int GetChildCount() const;
+    Transform* GetChild(unsigned int index) const;
+    unsigned long GetVersion() const;
 
     void SetPosition(const glm::vec3& pos);
+    void SetRotation(const glm::quat& q);
     void SetScale(const glm::vec3& s);
+    void SetParent(Transform* p);
 
     static const glm::vec3 Up, Down, Left, Right, Forward, Backward, One, Zero;
 
   private:
-    mutable glm::vec3 position, scale, forward, up, right;
+    enum DirtyFlag : unsigned int { DIRTY_LOCAL = 1 << 0, DIRTY_WORLD = 1 << 1, DIRTY_INVERSE = 1 << 2, DIRTY_AXES = 1 << 3 };
+
+    void SetLocalDirty();
+    void SetWorldDirty();
+    void UpdateWorld() const;
+    void UpdateAxes() const;
+
+  private:
+    glm::vec3 position, scale;
     glm::quat rotation;
-    glm::mat4 localToWorldMatrix, worldToLocalMatrix;
+    Transform* parent;
+    std::vector<Transform*> children;
+    unsigned long version;
+    mutable unsigned int dirty;
+    mutable glm::vec3 forward, up, right;
+    mutable glm::quat worldRotation;
+    mutable glm::mat4 localMatrix, localToWorldMatrix, worldToLocalMatrix;
 };
 
 #endif  // TRANSFORM_H
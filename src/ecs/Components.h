@@ -0,0 +1,37 @@
+#ifndef DEFERRED_ECS_COMPONENTS_H
+#define DEFERRED_ECS_COMPONENTS_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "../TransformStore.h"
+
+class Material;
+class PointLight;
+
+// plain data only, systems in RenderingEngine do the work
+
+struct TransformComponent {
+    TransformHandle handle;
+};
+
+struct MeshRenderer {
+    unsigned int vao;
+    int vertexCount;
+    bool cullFace;
+    const std::vector<glm::vec3>* occluder;  // simplified triangles for occlusion culling, or null
+    unsigned int renderObject;               // proxy the culling and draw lists refer to
+};
+
+struct MaterialComponent {
+    Material* material;
+};
+
+// the light itself owns gl resources, the entity only refers to it
+struct PointLightComponent {
+    PointLight* light;
+    float orbitSpeed;
+    float orbitRadius;
+};
+
+#endif  // DEFERRED_ECS_COMPONENTS_H
@@ -0,0 +1,189 @@
+#ifndef DEFERRED_ECS_REGISTRY_H
+#define DEFERRED_ECS_REGISTRY_H
+
+#include <cassert>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// an entity is only an index plus a generation, components live in packed per type pools
+struct Entity {
+    unsigned int index;
+    unsigned int generation;
+
+    bool operator==(const Entity& o) const { return index == o.index && generation == o.generation; }
+    bool operator!=(const Entity& o) const { return !(*this == o); }
+};
+
+class PoolBase {
+  public:
+    virtual ~PoolBase() {}
+    virtual void Remove(Entity e) = 0;
+    virtual bool Has(Entity e) const = 0;
+    virtual unsigned int Size() const = 0;
+};
+
+// sparse set: sparse maps entity index -> dense slot, dense arrays hold the entities and their components side by side.
+// removal swaps the last element into the hole, so iteration is always over a contiguous array.
+template <typename T>
+class ComponentPool : public PoolBase {
+  public:
+    static constexpr unsigned int Invalid = ~0u;
+
+    template <typename... Args>
+    T& Add(Entity e, Args&&... args) {
+        assert(!Has(e));
+        if (e.index >= sparse.size()) sparse.resize(e.index + 1, Invalid);
+        sparse[e.index] = (unsigned int)entities.size();
+        entities.push_back(e);
+        components.push_back(T{std::forward<Args>(args)...});
+        return components.back();
+    }
+
+    void Remove(Entity e) override {
+        if (!Has(e)) return;
+        unsigned int slot = sparse[e.index];
+        unsigned int last = (unsigned int)entities.size() - 1;
+        if (slot != last) {
+            entities[slot] = entities[last];
+            components[slot] = std::move(components[last]);
+            sparse[entities[slot].index] = slot;
+        }
+        entities.pop_back();
+        components.pop_back();
+        sparse[e.index] = Invalid;
+    }
+
+    bool Has(Entity e) const override { return e.index < sparse.size() && sparse[e.index] != Invalid && entities[sparse[e.index]] == e; }
+    unsigned int Size() const override { return (unsigned int)entities.size(); }
+
+    T& Get(Entity e) { return components[sparse[e.index]]; }
+    const T& Get(Entity e) const { return components[sparse[e.index]]; }
+    T* TryGet(Entity e) { return Has(e) ? &components[sparse[e.index]] : nullptr; }
+
+    void Reserve(unsigned int n) {
+        entities.reserve(n);
+        components.reserve(n);
+    }
+
+    // dense views, index i of both belongs together
+    const std::vector<Entity>& GetEntities() const { return entities; }
+    std::vector<T>& GetComponents() { return components; }
+
+  private:
+    std::vector<unsigned int> sparse;
+    std::vector<Entity> entities;
+    std::vector<T> components;
+};
+
+class Registry {
+  public:
+    Registry() : generations(), freeIndices(), pools(), aliveCount(0) {}
+    Registry(const Registry&) = delete;
+    Registry& operator=(const Registry&) = delete;
+
+    Entity Create() {
+        Entity e;
+        if (!freeIndices.empty()) {
+            e.index = freeIndices.back();
+            freeIndices.pop_back();
+        } else {
+            e.index = (unsigned int)generations.size();
+            generations.push_back(0);
+        }
+        e.generation = generations[e.index];
+        aliveCount++;
+        return e;
+    }
+
+    void Destroy(Entity e) {
+        if (!IsAlive(e)) return;
+        for (auto& pool : pools) {
+            if (pool) pool->Remove(e);
+        }
+        generations[e.index]++;
+        freeIndices.push_back(e.index);
+        aliveCount--;
+    }
+
+    bool IsAlive(Entity e) const { return e.index < generations.size() && generations[e.index] == e.generation; }
+    unsigned int GetAliveCount() const { return aliveCount; }
+
+    void Reserve(unsigned int n) {
+        generations.reserve(n);
+        freeIndices.reserve(n);
+    }
+
+    template <typename T, typename... Args>
+    T& Add(Entity e, Args&&... args) {
+        assert(IsAlive(e));
+        return GetPool<T>().Add(e, std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    void Remove(Entity e) {
+        GetPool<T>().Remove(e);
+    }
+
+    template <typename T>
+    bool Has(Entity e) const {
+        const PoolBase* pool = FindPool(TypeId<T>());
+        return pool && pool->Has(e);
+    }
+
+    template <typename T>
+    T& Get(Entity e) {
+        return GetPool<T>().Get(e);
+    }
+
+    template <typename T>
+    ComponentPool<T>& GetPool() {
+        unsigned int id = TypeId<T>();
+        if (id >= pools.size()) pools.resize(id + 1);
+        if (!pools[id]) pools[id].reset(new ComponentPool<T>());
+        return *static_cast<ComponentPool<T>*>(pools[id].get());
+    }
+
+    // walks the dense array of the first component and skips entities missing any of the others
+    template <typename T, typename... Others, typename Func>
+    void Each(Func func) {
+        ComponentPool<T>& pool = GetPool<T>();
+        const std::vector<Entity>& entities = pool.GetEntities();
+        std::vector<T>& components = pool.GetComponents();
+        for (unsigned int i = 0; i < entities.size(); i++) {
+            Entity e = entities[i];
+            if (!HasAll<Others...>(e)) continue;
+            func(e, components[i], GetPool<Others>().Get(e)...);
+        }
+    }
+
+  private:
+    static unsigned int NextTypeId() {
+        static unsigned int next = 0;
+        return next++;
+    }
+
+    template <typename T>
+    static unsigned int TypeId() {
+        static const unsigned int id = NextTypeId();
+        return id;
+    }
+
+    const PoolBase* FindPool(unsigned int id) const { return id < pools.size() ? pools[id].get() : nullptr; }
+
+    template <typename... Ts>
+    bool HasAll(Entity e) const {
+        bool all = true;
+        bool results[] = {true, (all = all && Has<Ts>(e))...};
+        (void)results;
+        return all;
+    }
+
+  private:
+    std::vector<unsigned int> generations;
+    std::vector<unsigned int> freeIndices;
+    std::vector<std::unique_ptr<PoolBase>> pools;
+    unsigned int aliveCount;
+};
+
+#endif  // DEFERRED_ECS_REGISTRY_H
@@ -3,6 +3,8 @@
 
 #include <GL/glew.h>
 
+#include "util.h"
+
 enum class FramebufferTarget {
     FRAMEBUFFER = GL_FRAMEBUFFER,
     READ_FRAMEBUFFER = GL_READ_FRAMEBUFFER,
@@ -100,7 +102,7 @@ enum class AttachmentType { COLOR = GL_COLOR_ATTACHMENT0, DEPTH = GL_DEPTH_ATTAC
 class Texture {
   public:
     Texture() : id(0), textureTarget(TextureTarget::TEX_2D), sizedInternalFormat(InternalFormat::RGBA), baseInternalFormat(InternalFormat::RGBA), attachmentType(AttachmentType::COLOR) {
-        glGenTextures(1, &id);
+        glGenTextures_profile(1, &id);
     }
 
     Texture(InternalFormat sizedInternal, InternalFormat baseInternal, PixelDataType dataType, unsigned int w, unsigned int h)
@@ -112,39 +114,39 @@ class Texture {
           baseInternalFormat(baseInternal),
           pixelDataType(dataType),
           attachmentType(AttachmentType::COLOR) {
-        glGenTextures(1, &id);
+        glGenTextures_profile(1, &id);
         createEmpty();
     }
 
     Texture(InternalFormat sizedInternal, InternalFormat baseInternal, PixelDataType dataType, AttachmentType type, unsigned int w, unsigned int h)
         : id(0), width(w), height(h), textureTarget(TextureTarget::TEX_2D), sizedInternalFormat(sizedInternal), baseInternalFormat(baseInternal), pixelDataType(dataType), attachmentType(type) {
-        glGenTextures(1, &id);
+        glGenTextures_profile(1, &id);
         createEmpty();
     }
 
-    ~Texture() { glDeleteTextures(1, &id); }
+    ~Texture() { glDeleteTextures_profile(1, &id); }
 
     void createEmpty() { create(width, height, nullptr); }
 
     void create(unsigned int w, unsigned int h, void* ptr) {
-        glBindTexture(static_cast<GLenum>(textureTarget), id);
+        glBindTexture_profile(static_cast<GLenum>(textureTarget), id);
         // internalformat: Specifies the number of color components in the texture.
         // format: Specifies the format of the pixel data. (BaseInternalFormat)
         // type: Specifies the data type of the pixel data.
-        glTexImage2D(static_cast<GLenum>(textureTarget), 0, static_cast<GLenum>(sizedInternalFormat), w, h, 0, static_cast<GLenum>(baseInternalFormat), static_cast<GLenum>(pixelDataType), ptr);
-        glTexParameteri(static_cast<GLenum>(textureTarget), GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(static_cast<GLenum>(textureTarget), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(static_cast<GLenum>(textureTarget), GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(static_cast<GLenum>(textureTarget), GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glBindTexture(static_cast<GLenum>(textureTarget), 0);
+        glTexImage2D_profile(static_cast<GLenum>(textureTarget), 0, static_cast<GLenum>(sizedInternalFormat), w, h, 0, static_cast<GLenum>(baseInternalFormat), static_cast<GLenum>(pixelDataType), ptr);
+        glTexParameteri_profile(static_cast<GLenum>(textureTarget), GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri_profile(static_cast<GLenum>(textureTarget), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri_profile(static_cast<GLenum>(textureTarget), GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri_profile(static_cast<GLenum>(textureTarget), GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture_profile(static_cast<GLenum>(textureTarget), 0);
     }
 
     void bind() {
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(static_cast<GLenum>(textureTarget), id);
+        glBindTexture_profile(static_cast<GLenum>(textureTarget), id);
     }
 
-    void unbind() { glBindTexture(static_cast<GLenum>(textureTarget), 0); }
+    void unbind() { glBindTexture_profile(static_cast<GLenum>(textureTarget), 0); }
 
     unsigned int id, width, height;
     TextureTarget textureTarget;
@@ -193,8 +195,8 @@ class Framebuffer {
         } else {
             att_type = static_cast<GLenum>(tex.attachmentType);
             // depth and stencil is not rendering purpose
-            glDrawBuffer(GL_NONE);
-            glReadBuffer(GL_NONE);
+            glDrawBuffer_profile(GL_NONE);
+            glReadBuffer_profile(GL_NONE);
         }
         glFramebufferTexture2D(static_cast<GLenum>(target), att_type, static_cast<GLenum>(tex.textureTarget), tex.id, 0);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
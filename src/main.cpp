@@ -1,15 +1,89 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "GlReplay.h"
 #include "RenderingEngine.h"
 
-int main() {
-    RenderingEngine engine;
-    if (!engine.initWindow("Three point light shadow mapping example", 1280, 720)) {
+int main(int argc, char** argv) {
+    // --workers 1 runs every job inline on the main thread, in order
+    // --sim-rate 0 drops the simulation thread and ticks once per frame
+    // --trace file.json writes the profiler trace of the last frames on exit
+    // --stats file.csv (or .json) writes per pass statistics on exit
+    // --bench path.txt replays a camera path for --frames N frames and prints a summary, --hash adds an image hash
+    // --headless renders without any window, builds with DEFERRED_HEADLESS only
+    // --stress objects=N,meshes=N,lights=N,shadowed=0..1,materials=N,seed=N generates the scene, see StressScene.h
+    // --capture file.glc records every gl call up to the end of frame --capture-frames N (default 60)
+    // --replay file.glc re-issues a capture's frames for --frames N frames and prints a summary, no scene is loaded
+    // --texture-budget MB caps the gpu memory of streamed textures (default 256)
+    unsigned int workers = 0;
+    float simulationRate = 120.f;
+    const char* tracePath = nullptr;
+    const char* statsPath = nullptr;
+    const char* benchPath = nullptr;
+    const char* stressSpec = nullptr;
+    const char* capturePath = nullptr;
+    const char* replayPath = nullptr;
+    int benchFrames = 600, captureFrames = 60, textureBudget = 0;
+    bool hash = false, headless = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--hash") == 0) hash = true;
+        if (std::strcmp(argv[i], "--headless") == 0) headless = true;
+        if (i + 1 == argc) break;
+        if (std::strcmp(argv[i], "--workers") == 0) workers = (unsigned int)std::atoi(argv[i + 1]);
+        if (std::strcmp(argv[i], "--sim-rate") == 0) simulationRate = (float)std::atof(argv[i + 1]);
+        if (std::strcmp(argv[i], "--trace") == 0) tracePath = argv[i + 1];
+        if (std::strcmp(argv[i], "--stats") == 0) statsPath = argv[i + 1];
+        if (std::strcmp(argv[i], "--bench") == 0) benchPath = argv[i + 1];
+        if (std::strcmp(argv[i], "--frames") == 0) benchFrames = std::atoi(argv[i + 1]);
+        if (std::strcmp(argv[i], "--stress") == 0) stressSpec = argv[i + 1];
+        if (std::strcmp(argv[i], "--capture") == 0) capturePath = argv[i + 1];
+        if (std::strcmp(argv[i], "--capture-frames") == 0) captureFrames = std::atoi(argv[i + 1]);
+        if (std::strcmp(argv[i], "--replay") == 0) replayPath = argv[i + 1];
+        if (std::strcmp(argv[i], "--texture-budget") == 0) textureBudget = std::atoi(argv[i + 1]);
+    }
+    // a benchmark ticks inline so every run sees the same frames
+    RenderingEngine engine(workers, benchPath ? 0.f : simulationRate);
+    if (tracePath) engine.setTraceOutput(tracePath);
+    if (statsPath) engine.setStatsOutput(statsPath);
+    if (stressSpec) {
+        StressSceneDesc desc = stress_scene::defaults();
+        if (!stress_scene::parse(stressSpec, desc)) return -1;
+        engine.setStressScene(desc);
+    }
+    if (capturePath) engine.setCaptureOutput(capturePath, captureFrames);
+    if (textureBudget > 0) engine.setTextureBudget((size_t)textureBudget << 20);
+    // a replay renders at the size it was captured at
+    GlReplay replay;
+    int width = 1280, height = 720;
+    if (replayPath) {
+        if (!replay.Load(replayPath)) return -1;
+        width = replay.GetWidth();
+        height = replay.GetHeight();
+    }
+    if (headless) {
+#ifdef DEFERRED_HEADLESS
+        if (!engine.initHeadless(width, height)) {
+            std::cout << "headless init failed" << std::endl;
+            return -1;
+        }
+#else
+        std::cout << "headless mode needs a build with DEFERRED_HEADLESS" << std::endl;
+        return -1;
+#endif
+    } else if (!engine.initWindow("Three point light shadow mapping example", width, height)) {
         std::cout << "window init failed" << std::endl;
         return -1;
     }
+    if (replayPath) return engine.runReplay(replay, benchFrames);
     if (!engine.initShader()) {
         std::cout << "shader init failed" << std::endl;
         return -1;
     }
     engine.initVertex();
+    if (benchPath) return engine.runBenchmark(benchPath, benchFrames, hash);
+    if (headless) {
+        std::cout << "headless mode needs --bench" << std::endl;
+        return -1;
+    }
     return engine.render();
-}
\ No newline at end of file
+}
@@ -3,6 +3,8 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
 #include <cstring>
 #include <fstream>
 #include <glm/glm.hpp>
@@ -45,12 +47,22 @@ namespace obj_parser {
         std::vector<Face> faces;
     };
 
+    struct Bounds {
+        Bounds() : min(), max(), center(), radius(0.f), uvDensity(0.f) {}
+        vec3 min;
+        vec3 max;
+        vec3 center;  // bounding sphere centered on the aabb
+        float radius;
+        float uvDensity;  // uv units per local unit, what texture streaming picks mip levels with. 0 without uvs
+    };
+
     struct Mesh {
-        Mesh() : name(), vertices(), material_id(-1) { vertices.clear(); }
+        Mesh() : name(), vertices(), material_id(-1), bounds() { vertices.clear(); }
         std::string name;
         std::vector<Vertex> vertices;
         std::vector<unsigned int> indices;
         int material_id;
+        Bounds bounds;  // local space, filled in by loadObj
     };
 
     enum class TextureFace { TEX_2D, TEX_3D_SPHERE, TEX_3D_CUBE_TOP, TEX_3D_CUBE_BOTTOM, TEX_3D_CUBE_FRONT, TEX_3D_CUBE_BACK, TEX_3D_CUBE_LEFT, TEX_3D_CUBE_RIGHT };
@@ -180,6 +192,48 @@ namespace obj_parser {
         mesh.vertices[offset_start + 2] = v3;
     }
 
+    // positions are read as 3 floats every `stride` floats, uvs as 2 floats `uvOffset` floats after each position.
+    // the vertices are a triangle list when there are uvs
+    inline Bounds calcBounds(const float* positions, size_t count, size_t stride, int uvOffset = -1) {
+        Bounds bounds;
+        if (count == 0) {
+            return bounds;
+        }
+
+        bounds.min = vec3(positions[0], positions[1], positions[2]);
+        bounds.max = bounds.min;
+        for (size_t i = 1; i < count; i++) {
+            const float* p = positions + i * stride;
+            bounds.min = glm::min(bounds.min, vec3(p[0], p[1], p[2]));
+            bounds.max = glm::max(bounds.max, vec3(p[0], p[1], p[2]));
+        }
+        bounds.center = (bounds.min + bounds.max) * 0.5f;
+        for (size_t i = 0; i < count; i++) {
+            const float* p = positions + i * stride;
+            bounds.radius = glm::max(bounds.radius, length(vec3(p[0], p[1], p[2]) - bounds.center));
+        }
+
+        // one density for the whole mesh: the square root of uv area over surface area
+        double uvArea = 0.0, area = 0.0;
+        for (size_t i = 0; uvOffset >= 0 && i + 2 < count; i += 3) {
+            const float *p0 = positions + i * stride, *p1 = p0 + stride, *p2 = p1 + stride;
+            vec3 e1 = vec3(p1[0], p1[1], p1[2]) - vec3(p0[0], p0[1], p0[2]), e2 = vec3(p2[0], p2[1], p2[2]) - vec3(p0[0], p0[1], p0[2]);
+            vec2 t1 = vec2(p1[uvOffset], p1[uvOffset + 1]) - vec2(p0[uvOffset], p0[uvOffset + 1]), t2 = vec2(p2[uvOffset], p2[uvOffset + 1]) - vec2(p0[uvOffset], p0[uvOffset + 1]);
+            area += length(cross(e1, e2));
+            uvArea += std::fabs(t1.x * t2.y - t1.y * t2.x);
+        }
+        if (area > 0.0) bounds.uvDensity = (float)std::sqrt(uvArea / area);
+
+        return bounds;
+    }
+
+    inline void calcBounds(Mesh& mesh) {
+        if (mesh.vertices.empty()) {
+            return;
+        }
+        mesh.bounds = calcBounds(&mesh.vertices[0].position.x, mesh.vertices.size(), sizeof(Vertex) / sizeof(float), (int)(offsetof(Vertex, texcoord) / sizeof(float)));
+    }
+
     inline void triangulate(Mesh& mesh, const std::vector<vec3>& verts, size_t npolys) {
         // @TODO
     }
@@ -776,6 +830,7 @@ namespace obj_parser {
         scene.base_dir = pair.first;
         std::string filename = pair.second;
         std::string line_buf;
+        size_t first_mesh = scene.meshes.size();
 
         // preventing a empty file
         while (ifs.peek() != -1) {
@@ -959,6 +1014,11 @@ namespace obj_parser {
             scene.meshes.emplace_back(current_mesh);
         }
 
+        // bounds are computed once here so culling never has to touch vertex data
+        for (size_t i = first_mesh; i < scene.meshes.size(); i++) {
+            calcBounds(scene.meshes[i]);
+        }
+
         return true;
     }
 }  // namespace obj_parser
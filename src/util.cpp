@@ -1,7 +1,12 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "util.h"
 
+#include <algorithm>
 #include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "GlCapture.h"
 
 namespace utils {
     const float planeVertices[48] = {
@@ -19,6 +24,10 @@ namespace utils {
 int drawCallCount = 0;
 int vertexCount = 0;
 int triangleCount = 0;
+int stateChangeCount = 0;
+int textureBindCount = 0;
+int uniformUploadCount = 0;
+long long bufferUploadBytes = 0;
 
 bool loadFile(const std::string& filepath, std::string& out_source) {
     FILE* fp = NULL;
@@ -36,167 +45,60 @@ bool loadFile(const std::string& filepath, std::string& out_source) {
     return true;
 }
 
-unsigned int loadShaderFromFile(const std::string& vs_name, const std::string& fs_name) {
-    std::string vertexSource, fragmentSource;
-    bool result = loadFile(vs_name, vertexSource);
-    if (!result) return 0;
-    result = loadFile(fs_name, fragmentSource);
-    if (!result) return 0;
-
-    // vertex shader
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    const char* vertexShaderSource = vertexSource.c_str();
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    int success;
-    char infoLog[512];
-    // check for shader compile errors
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cout << "shader compile error in " << vs_name << std::endl << infoLog << std::endl;
-        return 0;
-    }
-
-    // fragment shader
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    const char* fragmentShaderSource = fragmentSource.c_str();
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    // check for shader compile errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cout << "shader compile error in " << fs_name << std::endl << infoLog << std::endl;
-        return 0;
-    }
-
-    // link program
-    unsigned int shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    // check for linking errors
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cout << "program linking error with " << vs_name << " and " << fs_name << std::endl << infoLog << std::endl;
-        return 0;
-    }
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    return shaderProgram;
-}
-
-unsigned int loadShaderFromFile(const std::string& vs_name, const std::string& gs_name, const std::string& fs_name) {
-    std::string vertexSource, geometrySource, fragmentSource;
-    bool result = loadFile(vs_name, vertexSource);
-    if (!result) return 0;
-    result = loadFile(gs_name, geometrySource);
-    if (!result) return 0;
-    result = loadFile(fs_name, fragmentSource);
-    if (!result) return 0;
-
-    // vertex shader
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    const char* vertexShaderSource = vertexSource.c_str();
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    int success;
-    char infoLog[512];
-    // check for shader compile errors
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cout << "shader compile error in " << vs_name << std::endl << infoLog << std::endl;
-        return 0;
-    }
-
-    // geometry shader
-    unsigned int geometryShader = glCreateShader(GL_GEOMETRY_SHADER);
-    const char* geometryShaderSource = geometrySource.c_str();
-    glShaderSource(geometryShader, 1, &geometryShaderSource, NULL);
-    glCompileShader(geometryShader);
-    // check for shader compile errors
-    glGetShaderiv(geometryShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(geometryShader, 512, NULL, infoLog);
-        std::cout << "shader compile error in " << gs_name << std::endl << infoLog << std::endl;
-        return 0;
-    }
-
-    // fragment shader
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    const char* fragmentShaderSource = fragmentSource.c_str();
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    // check for shader compile errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cout << "shader compile error in " << fs_name << std::endl << infoLog << std::endl;
-        return 0;
+static bool resolveIncludes(const std::string& path, std::string& out_source, std::vector<std::string>& included) {
+    std::string source;
+    if (!loadFile(path, source)) {
+        std::cout << "shader source " << path << " not found" << std::endl;
+        return false;
     }
-
-    // link program
-    unsigned int shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, geometryShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    // check for linking errors
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cout << "program linking error with " << vs_name << " and " << gs_name << " and " << fs_name << std::endl << infoLog << std::endl;
-        return 0;
-    }
-    glDeleteShader(vertexShader);
-    glDeleteShader(geometryShader);
-    glDeleteShader(fragmentShader);
-
-    return shaderProgram;
-}
-
-unsigned int loadTexture(char const* path, bool useSRGB) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    GLenum internalFormat;
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, useSRGB ? GL_SRGB : format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    } else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    std::istringstream in(source);
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+        number++;
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+            out_source += line;
+            out_source += '\n';
+            continue;
+        }
+        size_t open = line.find('"', start);
+        size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos) {
+            std::cout << path << ":" << number << ": expected #include \"file\"" << std::endl;
+            return false;
+        }
+        std::string file = directory + line.substr(open + 1, close - open - 1);
+        // every file once, like #pragma once
+        if (std::find(included.begin(), included.end(), file) == included.end()) {
+            included.push_back(file);
+            out_source += "#line 1\n";
+            if (!resolveIncludes(file, out_source, included)) return false;
+        }
+        // keeps compile errors pointing at the right line of this file
+        out_source += "#line " + std::to_string(number + 1) + "\n";
     }
+    return true;
+}
 
-    return textureID;
+bool loadShaderSource(const std::string& path, const std::string& defines, std::string& out_source, std::vector<std::string>* out_files) {
+    out_source.clear();
+    std::vector<std::string> included = {path};
+    bool resolved = resolveIncludes(path, out_source, included);
+    if (out_files) out_files->insert(out_files->end(), included.begin(), included.end());
+    if (!resolved) return false;
+    if (defines.empty()) return true;
+    // #version has to stay first
+    size_t version = out_source.find("#version");
+    size_t insert = version == std::string::npos ? 0 : out_source.find('\n', version) + 1;
+    out_source.insert(insert, defines + "#line 2\n");
+    return true;
 }
 
 void glDrawArrays_profile(GLenum mode, GLint first, GLsizei count) {
     glDrawArrays(mode, first, count);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::DrawArrays, mode, first, count);
     drawCallCount++;
     vertexCount += count;
     switch (mode) {
@@ -210,10 +112,168 @@ void glDrawArrays_profile(GLenum mode, GLint first, GLsizei count) {
     }
 }
 
+void glUseProgram_profile(GLuint program) {
+    glUseProgram(program);
+    stateChangeCount++;
+}
+
+void glBindVertexArray_profile(GLuint array) {
+    glBindVertexArray(array);
+    stateChangeCount++;
+}
+
+void glBindFramebuffer_profile(GLenum target, GLuint framebuffer) {
+    glBindFramebuffer(target, framebuffer);
+    stateChangeCount++;
+}
+
+void glBindTexture_profile(GLenum target, GLuint texture) {
+    glBindTexture(target, texture);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::BindTexture, target, texture);
+    textureBindCount++;
+}
+
+void glUniform1i_profile(GLint location, GLint v0) {
+    glUniform1i(location, v0);
+    uniformUploadCount++;
+}
+
+void glUniform1f_profile(GLint location, GLfloat v0) {
+    glUniform1f(location, v0);
+    uniformUploadCount++;
+}
+
+void glUniform2f_profile(GLint location, GLfloat v0, GLfloat v1) {
+    glUniform2f(location, v0, v1);
+    uniformUploadCount++;
+}
+
+void glUniform3f_profile(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) {
+    glUniform3f(location, v0, v1, v2);
+    uniformUploadCount++;
+}
+
+void glUniform3fv_profile(GLint location, GLsizei count, const GLfloat* value) {
+    glUniform3fv(location, count, value);
+    uniformUploadCount++;
+}
+
+void glUniform4fv_profile(GLint location, GLsizei count, const GLfloat* value) {
+    glUniform4fv(location, count, value);
+    uniformUploadCount++;
+}
+
+void glUniformMatrix4fv_profile(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    glUniformMatrix4fv(location, count, transpose, value);
+    uniformUploadCount++;
+}
+
+void glBufferData_profile(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    glBufferData(target, size, data, usage);
+    if (data) bufferUploadBytes += size;
+}
+
+void glBufferSubData_profile(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    glBufferSubData(target, offset, size, data);
+    bufferUploadBytes += size;
+}
+
+void glGenTextures_profile(GLsizei n, GLuint* textures) {
+    glGenTextures(n, textures);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().RecordNames(GlOp::GenTextures, n, textures);
+}
+
+void glDeleteTextures_profile(GLsizei n, const GLuint* textures) {
+    glDeleteTextures(n, textures);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().RecordNames(GlOp::DeleteTextures, n, textures);
+}
+
+void glTexImage2D_profile(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels) {
+    glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().RecordTexImage(GlOp::TexImage2D, target, level, internalFormat, width, height, 1, border, format, type, pixels);
+}
+
+void glTexParameteri_profile(GLenum target, GLenum pname, GLint param) {
+    glTexParameteri(target, pname, param);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::TexParameteri, target, pname, param);
+}
+
+void glTexParameterfv_profile(GLenum target, GLenum pname, const GLfloat* params) {
+    glTexParameterfv(target, pname, params);
+    // only ever the border color, always four values
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::TexParameterfv, target, pname, params[0], params[1], params[2], params[3]);
+}
+
+void glPixelStorei_profile(GLenum pname, GLint param) {
+    glPixelStorei(pname, param);
+    if (!GlCapture::Get().IsActive()) return;
+    GlCapture::Get().Record(GlOp::PixelStorei, pname, param);
+    if (pname == GL_UNPACK_ALIGNMENT) GlCapture::Get().SetUnpackAlignment(param);
+}
+
+void glEnable_profile(GLenum cap) {
+    glEnable(cap);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::Enable, cap);
+}
+
+void glDisable_profile(GLenum cap) {
+    glDisable(cap);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::Disable, cap);
+}
+
+void glViewport_profile(GLint x, GLint y, GLsizei width, GLsizei height) {
+    glViewport(x, y, width, height);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::Viewport, x, y, width, height);
+}
+
+void glClear_profile(GLbitfield mask) {
+    glClear(mask);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::Clear, mask);
+}
+
+void glClearColor_profile(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) {
+    glClearColor(red, green, blue, alpha);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::ClearColor, red, green, blue, alpha);
+}
+
+void glDepthMask_profile(GLboolean flag) {
+    glDepthMask(flag);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::DepthMask, flag);
+}
+
+void glColorMask_profile(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha) {
+    glColorMask(red, green, blue, alpha);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::ColorMask, red, green, blue, alpha);
+}
+
+void glCullFace_profile(GLenum mode) {
+    glCullFace(mode);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::CullFace, mode);
+}
+
+void glBlendFunc_profile(GLenum sfactor, GLenum dfactor) {
+    glBlendFunc(sfactor, dfactor);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::BlendFunc, sfactor, dfactor);
+}
+
+void glDrawBuffer_profile(GLenum buf) {
+    glDrawBuffer(buf);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::DrawBuffer, buf);
+}
+
+void glReadBuffer_profile(GLenum src) {
+    glReadBuffer(src);
+    if (GlCapture::Get().IsActive()) GlCapture::Get().Record(GlOp::ReadBuffer, src);
+}
+
 void resetProfile() {
     drawCallCount = 0;
     vertexCount = 0;
     triangleCount = 0;
+    stateChangeCount = 0;
+    textureBindCount = 0;
+    uniformUploadCount = 0;
+    bufferUploadBytes = 0;
 }
 
 GLenum glCheckError_(const char* file, int line) {
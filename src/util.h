@@ -6,6 +6,7 @@
 
 #include <glm/glm.hpp>
 #include <string>
+#include <vector>
 
 namespace utils {
     const extern float planeVertices[48];
@@ -16,12 +17,48 @@ namespace utils {
 extern int drawCallCount;
 extern int vertexCount;
 extern int triangleCount;
+extern int stateChangeCount;  // program, vao and framebuffer binds
+extern int textureBindCount;
+extern int uniformUploadCount;
+extern long long bufferUploadBytes;
 
 bool loadFile(const std::string& filepath, std::string& out_source);
-unsigned int loadShaderFromFile(const std::string& vs_name, const std::string& fs_name);
-unsigned int loadShaderFromFile(const std::string& vs_name, const std::string& gs_name, const std::string& fs_name);
-unsigned int loadTexture(char const* path, bool useSRGB);
+// resolves #include "file" relative to the including file, each file once, and puts defines (whole "#define X 1\n"
+// lines) right after #version. out_files gets every file read, path first. programs are built by ShaderCompiler
+bool loadShaderSource(const std::string& path, const std::string& defines, std::string& out_source, std::vector<std::string>* out_files = nullptr);
+// the *_profile wrappers count into the stats above; the gl 1.1 ones also feed GlCapture, whose hooks can only
+// reach the entry points glew loads
 void glDrawArrays_profile(GLenum mode, GLint first, GLsizei count);
+void glUseProgram_profile(GLuint program);
+void glBindVertexArray_profile(GLuint array);
+void glBindFramebuffer_profile(GLenum target, GLuint framebuffer);
+void glBindTexture_profile(GLenum target, GLuint texture);
+void glUniform1i_profile(GLint location, GLint v0);
+void glUniform1f_profile(GLint location, GLfloat v0);
+void glUniform2f_profile(GLint location, GLfloat v0, GLfloat v1);
+void glUniform3f_profile(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+void glUniform3fv_profile(GLint location, GLsizei count, const GLfloat* value);
+void glUniform4fv_profile(GLint location, GLsizei count, const GLfloat* value);
+void glUniformMatrix4fv_profile(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+void glBufferData_profile(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+void glBufferSubData_profile(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+void glGenTextures_profile(GLsizei n, GLuint* textures);
+void glDeleteTextures_profile(GLsizei n, const GLuint* textures);
+void glTexImage2D_profile(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels);
+void glTexParameteri_profile(GLenum target, GLenum pname, GLint param);
+void glTexParameterfv_profile(GLenum target, GLenum pname, const GLfloat* params);
+void glPixelStorei_profile(GLenum pname, GLint param);
+void glEnable_profile(GLenum cap);
+void glDisable_profile(GLenum cap);
+void glViewport_profile(GLint x, GLint y, GLsizei width, GLsizei height);
+void glClear_profile(GLbitfield mask);
+void glClearColor_profile(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+void glDepthMask_profile(GLboolean flag);
+void glColorMask_profile(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+void glCullFace_profile(GLenum mode);
+void glBlendFunc_profile(GLenum sfactor, GLenum dfactor);
+void glDrawBuffer_profile(GLenum buf);
+void glReadBuffer_profile(GLenum src);
 void resetProfile();
 
 template <typename T>
@@ -0,0 +1,96 @@
+// texture_cooker::validate against a cooked file and damaged copies of it: every one of those would have the loader
+// read past the mapping or have gl read past a level
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "TextureCooker.h"
+
+static int failures = 0;
+
+static void Expect(const char* name, const std::vector<unsigned char>& file, bool valid) {
+    const TextureFileHeader* header;
+    const TextureFileLevel* levels;
+    bool result = texture_cooker::validate(file.data(), file.size(), header, levels);
+    printf("%-28s %s\n", name, result == valid ? "ok" : "FAILED");
+    if (result != valid) failures++;
+}
+
+static TextureFileHeader& Header(std::vector<unsigned char>& file) { return *reinterpret_cast<TextureFileHeader*>(file.data()); }
+
+static TextureFileLevel& Level(std::vector<unsigned char>& file, int i) { return reinterpret_cast<TextureFileLevel*>(file.data() + sizeof(TextureFileHeader))[i]; }
+
+static bool Cook(TextureFormat format, std::vector<unsigned char>& file) {
+    const int size = 32;
+    std::vector<unsigned char> texels((size_t)size * size * 4);
+    for (size_t i = 0; i < texels.size(); i++) texels[i] = (unsigned char)(i * 7);
+    std::vector<CookedLevel> levels;
+    texture_cooker::buildMips(texels.data(), size, size, 4, TextureUsage::Color, texture_cooker::MipFilter::Box, levels);
+    if (texture_cooker::isCompressed(format)) {
+        for (CookedLevel& level : levels) {
+            CookedLevel blocks;
+            texture_cooker::compress(level, format, blocks);
+            level = std::move(blocks);
+        }
+    }
+    const char* path = "texture_cooker_test.dtex";
+    if (!texture_cooker::write(path, format, TextureUsage::Color, levels)) return false;
+    FILE* in = fopen(path, "rb");
+    if (!in) return false;
+    fseek(in, 0, SEEK_END);
+    file.resize((size_t)ftell(in));
+    fseek(in, 0, SEEK_SET);
+    bool ok = fread(file.data(), 1, file.size(), in) == file.size();
+    fclose(in);
+    remove(path);
+    return ok;
+}
+
+int main() {
+    for (TextureFormat format : {TextureFormat::RGBA8, TextureFormat::BC1}) {
+        std::vector<unsigned char> cooked;
+        if (!Cook(format, cooked)) {
+            printf("cooking failed\n");
+            return 1;
+        }
+        printf("%s, %d levels\n", format == TextureFormat::BC1 ? "bc1" : "rgba8", (int)Header(cooked).levels);
+        Expect("cooked", cooked, true);
+
+        std::vector<unsigned char> file(cooked.begin(), cooked.end() - 1);
+        Expect("last byte cut", file, false);
+        file.assign(cooked.begin(), cooked.begin() + sizeof(TextureFileHeader) + sizeof(TextureFileLevel));
+        Expect("level table cut", file, false);
+        file.assign(cooked.begin(), cooked.begin() + 8);
+        Expect("header cut", file, false);
+
+        file = cooked;
+        std::swap(Level(file, 1).offset, Level(file, 2).offset);
+        Expect("levels reordered", file, false);
+        file = cooked;
+        Level(file, 1).offset = Level(file, 0).offset;
+        Expect("levels overlapping", file, false);
+        file = cooked;
+        Level(file, 0).offset = 0;
+        Expect("level over the header", file, false);
+        file = cooked;
+        Level(file, 1).size -= 4;
+        Expect("level short", file, false);
+        file = cooked;
+        Level(file, 2).width *= 2;
+        Level(file, 2).height *= 2;
+        Expect("level not halved", file, false);
+        file = cooked;
+        Header(file).width *= 2;
+        Expect("header size mismatch", file, false);
+        file = cooked;
+        Header(file).format = (TextureFormat)7;
+        Expect("format out of range", file, false);
+        file = cooked;
+        Header(file).usage = (TextureUsage)5;
+        Expect("usage out of range", file, false);
+        file = cooked;
+        Header(file).levels = 40;
+        Expect("too many levels", file, false);
+    }
+    return failures ? 1 : 0;
+}
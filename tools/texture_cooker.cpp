@@ -0,0 +1,90 @@
+// cooks images into .dtex files next to them: the full mip chain lanczos filtered and optionally block compressed,
+// laid out so TextureLoader maps the file and uploads the levels without decoding anything.
+//
+//   texture_cooker [--normal] [--srgb] [--compress] [--box] image...
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "TextureCooker.h"
+
+static bool hasAlpha(const CookedLevel& level) {
+    for (size_t i = 3; i < level.data.size(); i += 4) {
+        if (level.data[i] != 255) return true;
+    }
+    return false;
+}
+
+static bool cook(const std::string& path, TextureUsage usage, bool compressed, texture_cooker::MipFilter filter) {
+    auto start = std::chrono::steady_clock::now();
+    int width, height, channels;
+    unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+    if (!data) {
+        fprintf(stderr, "%s: %s\n", path.c_str(), stbi_failure_reason());
+        return false;
+    }
+    std::vector<unsigned char> texels;
+    int stride = texture_cooker::expand(data, width, height, channels, texels);
+    stbi_image_free(data);
+    std::vector<CookedLevel> levels;
+    texture_cooker::buildMips(texels.data(), width, height, stride, usage, filter, levels);
+
+    TextureFormat format = stride == 1 ? TextureFormat::R8 : TextureFormat::RGBA8;
+    // single channel images are small enough as they are
+    if (compressed && stride == 4) {
+        format = usage == TextureUsage::Normal ? TextureFormat::BC5 : hasAlpha(levels[0]) ? TextureFormat::BC3 : TextureFormat::BC1;
+        for (CookedLevel& level : levels) {
+            CookedLevel blocks;
+            texture_cooker::compress(level, format, blocks);
+            level = std::move(blocks);
+        }
+    }
+    const std::string out = texture_cooker::cookedPath(path);
+    if (!texture_cooker::write(out, format, usage, levels)) return false;
+
+    size_t size = 0, rgba = 0;
+    for (const CookedLevel& level : levels) {
+        size += level.data.size();
+        rgba += (size_t)level.width * level.height * 4;
+    }
+    const char* names[] = {"r8", "rgba8", "bc1", "bc3", "bc5"};
+    printf("%s: %dx%d, %d levels %s, %.1f KiB (rgba8 %.1f KiB) in %.0f ms\n", out.c_str(), width, height, (int)levels.size(), names[(int)format], size / 1024.0, rgba / 1024.0,
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    TextureUsage usage = TextureUsage::Color;
+    bool compressed = false;
+    texture_cooker::MipFilter filter = texture_cooker::MipFilter::Lanczos;
+    std::vector<std::string> images;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--normal") == 0) {
+            usage = TextureUsage::Normal;
+        } else if (strcmp(argv[i], "--srgb") == 0) {
+            usage = TextureUsage::Srgb;
+        } else if (strcmp(argv[i], "--compress") == 0) {
+            compressed = true;
+        } else if (strcmp(argv[i], "--box") == 0) {
+            filter = texture_cooker::MipFilter::Box;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        } else {
+            images.push_back(argv[i]);
+        }
+    }
+    if (images.empty()) {
+        fprintf(stderr, "usage: %s [--normal] [--srgb] [--compress] [--box] image...\n", argv[0]);
+        return 2;
+    }
+    int failed = 0;
+    for (const std::string& image : images) failed += cook(image, usage, compressed, filter) ? 0 : 1;
+    return failed ? 1 : 0;
+}